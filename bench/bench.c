@@ -0,0 +1,506 @@
+/**
+ * @file bench.c
+ * @brief Headless microbenchmarks for the drawing primitives
+ *
+ * Everything renders into an off-screen surface, so no framebuffer device
+ * is needed. Results are printed to stdout as JSON:
+ *
+ *   ./framebuffer_bench > bench.json
+ *   ./framebuffer_bench floodFill     (only benchmarks whose name contains "floodFill")
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sched.h>
+#include "framebuffer.h"
+#include "geometry.h"
+#include "filling.h"
+#include "clipping.h"
+#include "transform.h"
+#include "mapfile.h"
+#include "palette.h"
+#include "cmdbuffer.h"
+#include "tiles.h"
+#include "text.h"
+#include "blit.h"
+#include "image.h"
+#include "capture.h"
+
+#define CANVAS_WIDTH 1024
+#define CANVAS_HEIGHT 768
+// each benchmark runs for at least this long
+#define MIN_BENCH_NS 200000000L
+
+// game globals referenced by the engine objects
+int planeloc = 0;
+int endSign = 0;
+
+/*
+Allocation accounting: the bench binary is linked with
+-Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc so every allocation made
+by the engine lands here first.
+*/
+unsigned long allocationCount = 0;
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t n, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+
+void *__wrap_malloc(size_t size) {
+    allocationCount++;
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t n, size_t size) {
+    allocationCount++;
+    return __real_calloc(n, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size) {
+    allocationCount++;
+    return __real_realloc(ptr, size);
+}
+
+typedef struct {
+    const char *name;
+    void (*setup)(void);
+    void (*run)(long iteration);
+    int drawsPixels;
+} Benchmark;
+
+Surface *canvas;
+Color black, white, red, green;
+volatile long sink;
+
+long nowNs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000L + ts.tv_nsec;
+}
+
+void clearCanvas(void) {
+    clearSurface(canvas, packColor(black));
+}
+
+/*
+Pixels one operation changes after setup, used for Mpixels/s
+*/
+long countChangedPixels(Benchmark *b) {
+    long changed = 0;
+    long size = (long)canvas->pitch * canvas->height;
+    uint32_t *before = malloc(size * sizeof(uint32_t));
+    if (!before) {
+        return 0;
+    }
+    b->setup();
+    memcpy(before, canvas->pixels, size * sizeof(uint32_t));
+    b->run(0);
+    for (long i = 0; i < size; i++) {
+        if (canvas->pixels[i] != before[i]) changed++;
+    }
+    free(before);
+    return changed;
+}
+
+/* ---- primitives ---- */
+
+void runSetXY(long it) {
+    setXY(1, (it * 7) % (CANVAS_WIDTH - 2), (it * 13) % (CANVAS_HEIGHT - 2), white);
+}
+
+void runPrintBackground(long it) {
+    printBackground((it & 1) ? black : white);
+}
+
+void runLineHorizontal(long it) {
+    drawBresenhamLine(make_point(10, 300), make_point(1010, 300), white, 1);
+}
+
+void runLineVertical(long it) {
+    drawBresenhamLine(make_point(500, 10), make_point(500, 750), white, 1);
+}
+
+void runLineShallow(long it) {
+    drawBresenhamLine(make_point(10, 100), make_point(1010, 400), white, 1);
+}
+
+void runLineSteep(long it) {
+    drawBresenhamLine(make_point(100, 10), make_point(400, 750), white, 1);
+}
+
+void runLineNegative(long it) {
+    drawBresenhamLine(make_point(10, 700), make_point(1010, 50), white, 1);
+}
+
+void runLineWide3(long it) {
+    drawBresenhamLine(make_point(10, 100), make_point(1010, 400), white, 3);
+}
+
+void runLineWide8(long it) {
+    drawBresenhamLine(make_point(10, 100), make_point(1010, 400), white, 8);
+}
+
+void runCircle(long it) {
+    drawCircle(300, make_point(512, 384), 1, white);
+}
+
+void runCircleWide(long it) {
+    drawCircle(300, make_point(512, 384), 3, white);
+}
+
+void setupSmallFill(void) {
+    Point box[4] = {make_point(100, 100), make_point(132, 100), make_point(132, 132), make_point(100, 132)};
+    clearCanvas();
+    drawPolygon(4, box, white, 1);
+}
+
+void setupLargeFill(void) {
+    Point box[4] = {make_point(10, 10), make_point(1000, 10), make_point(1000, 740), make_point(10, 740)};
+    clearCanvas();
+    drawPolygon(4, box, white, 1);
+}
+
+void setupBoxes(void) {
+    clearCanvas();
+    for (int j = 0; j < 8; j++) {
+        for (int i = 0; i < 12; i++) {
+            Point box[4] = {make_point(20 + i * 82, 20 + j * 92), make_point(80 + i * 82, 20 + j * 92),
+                            make_point(80 + i * 82, 90 + j * 92), make_point(20 + i * 82, 90 + j * 92)};
+            drawPolygon(4, box, white, 1);
+        }
+    }
+}
+
+void runRasterFill(long it) {
+    rasterFill(0, 0, CANVAS_WIDTH, CANVAS_HEIGHT, white, (it & 1) ? green : red);
+}
+
+void runSmallFill(long it) {
+    floodFill(116, 116, (it & 1) ? green : red, getXY(116, 116));
+}
+
+void runLargeFill(long it) {
+    floodFill(500, 400, (it & 1) ? green : red, getXY(500, 400));
+}
+
+/* same fill split across four workers */
+void runLargeFillParallel(long it) {
+    setFillThreads(4);
+    floodFill(500, 400, (it & 1) ? green : red, getXY(500, 400));
+    setFillThreads(0);
+}
+
+void runBoundaryFill(long it) {
+    boundaryFill(500, 400, (it & 1) ? green : red, white);
+}
+
+void runToleranceFill8(long it) {
+    fillRegion(500, 400, (it & 1) ? green : red, getXY(500, 400), 8, FILL_CONNECT8);
+}
+
+ClippingWindow benchWindow;
+
+void runClipLine(long it) {
+    Point out[2];
+    // alternate inside, crossing and outside lines
+    int k = it % 3;
+    Point a = make_point(k == 0 ? 200 : (k == 1 ? 50 : 10), 300);
+    Point b = make_point(k == 0 ? 600 : 900, k == 2 ? 20 : 500);
+    clipLine(analyzeLine(a, b, benchWindow), benchWindow, out);
+    sink += out[0].x + out[1].y;
+}
+
+void setupClip(void) {
+    benchWindow = setClippingWindow(100, 800, 600, 100);
+    clearCanvas();
+}
+
+void runRotatePoint(long it) {
+    Point p = rotatePoint(make_point(100, 50), make_point(20, 20), (float)(it % 360));
+    sink += p.x + p.y;
+}
+
+uint16_t row16[CANVAS_WIDTH];
+uint8_t row8[CANVAS_WIDTH];
+
+/* whole-canvas conversions, as presentScreen does on 16bpp and 8bpp screens */
+void runConvert16(long it) {
+    for (int j = 0; j < CANVAS_HEIGHT; j++) {
+        convertRow16(row16, canvas->pixels + (long)j * canvas->pitch, CANVAS_WIDTH, j);
+    }
+    sink += row16[it % CANVAS_WIDTH];
+}
+
+void runConvert8(long it) {
+    for (int j = 0; j < CANVAS_HEIGHT; j++) {
+        convertRow8(row8, canvas->pixels + (long)j * canvas->pitch, CANVAS_WIDTH, j);
+    }
+    sink += row8[it % CANVAS_WIDTH];
+}
+
+void loadMap(const char *path) {
+    PolygonMap *map = loadPolygonMap(path);
+    if (map) {
+        sink += map->count;
+        freePolygonMap(map);
+    }
+}
+
+void runLoadBuilding(long it) { loadMap("examples/building.txt"); }
+void runLoadJalan(long it) { loadMap("examples/jalan.txt"); }
+void runLoadPohon(long it) { loadMap("examples/pohon.txt"); }
+
+void loadAsset(const char *path) {
+    Surface *s = loadImage(path);
+    if (s) {
+        sink += surfaceRow(s, 0)[0];
+        destroySurface(s);
+    }
+}
+
+void runLoadPNG(long it) { loadAsset("examples/sky.png"); }
+void runLoadBMP(long it) { loadAsset("examples/sky.bmp"); }
+void runLoadPPM(long it) { loadAsset("examples/sky.ppm"); }
+
+PolygonMap *buildingMap, *pohonMap;
+CommandList benchList;
+
+void setupMaps(void) {
+    if (!buildingMap) buildingMap = loadPolygonMap("examples/building.txt");
+    if (!pohonMap) pohonMap = loadPolygonMap("examples/pohon.txt");
+    clearCanvas();
+}
+
+/* the map viewer frame: both maps, tiled 2x2 across the canvas */
+void runDrawMaps(long it) {
+    printBackground(black);
+    for (int k = 0; k < 4; k++) {
+        Point offset = make_point((k & 1) * 500, (k >> 1) * 380);
+        if (buildingMap) drawPolygonMap(buildingMap, offset, 1.0, white, 1);
+        if (pohonMap) drawPolygonMap(pohonMap, offset, 1.0, green, 1);
+    }
+}
+
+void runDrawMapsTiled(long it) {
+    recordBackground(&benchList, black);
+    for (int k = 0; k < 4; k++) {
+        Point offset = make_point((k & 1) * 500, (k >> 1) * 380);
+        if (buildingMap) recordPolygonMap(&benchList, buildingMap, offset, 1.0, white, 1);
+        if (pohonMap) recordPolygonMap(&benchList, pohonMap, offset, 1.0, green, 1);
+    }
+    executeCommandsTiled(&benchList);
+}
+
+/* submission cost alone: both maps as two batches, no drawing */
+void runRecordMaps(long it) {
+    if (buildingMap) recordPolygonMap(&benchList, buildingMap, make_point(0, 0), 1.0, white, 1);
+    if (pohonMap) recordPolygonMap(&benchList, pohonMap, make_point(0, 0), 1.0, green, 1);
+    sink += benchList.count;
+    resetCommandList(&benchList);
+}
+
+/* a screenshot of the map viewer frame */
+void setupScreenshot(void) {
+    setupMaps();
+    runDrawMaps(0);
+}
+
+void runEncodePNG(long it) {
+    size_t size;
+    uint8_t *png = encodePNG(canvas, &size);
+    if (png) {
+        sink += size;
+        free(png);
+    }
+}
+
+/* what presenting costs the render loop while recording: the copy into a
+   pooled slot. The writer appends it to /dev/null while the loop yields,
+   as a paced frame loop would sleep. */
+void setupRecording(void) {
+    if (!isRecording()) {
+        initCapture();
+        startRecording("/dev/null");
+    }
+    clearCanvas();
+}
+
+void runCaptureFrame(long it) {
+    captureFrame(canvas);
+    sched_yield();
+}
+
+/* a 256x192 image: color gradients, alpha rising left to right, a keyed border */
+Surface *benchImage, *benchUnpacked;
+uint16_t image16[256 * 192];
+
+void setupImage(void) {
+    if (!benchImage) {
+        benchImage = createSurface(256, 192);
+        for (int j = 0; j < 192; j++) {
+            uint32_t *row = surfaceRow(benchImage, j);
+            for (int i = 0; i < 256; i++) {
+                int border = i < 8 || i >= 248 || j < 8 || j >= 184;
+                row[i] = border ? SURFACE_COLORKEY : (uint32_t)i << 24 | i << 16 | (j + 32) << 8 | (255 - i);
+            }
+        }
+        benchUnpacked = createSurface(256, 192);
+        surfaceToRGB565(benchImage, image16, 256);
+    }
+    clearCanvas();
+}
+
+void runBlitAlpha(long it) {
+    for (int k = 0; k < 4; k++) {
+        blitSurface(benchImage, 100 + k * 200, 100 + (it & 7), BLIT_ALPHA);
+    }
+}
+
+void runBlitColorkey(long it) {
+    for (int k = 0; k < 4; k++) {
+        blitSurface(benchImage, 100 + k * 200, 100 + (it & 7), BLIT_COLORKEY);
+    }
+}
+
+/* a background image stretched over the whole canvas */
+void runBlitNearest(long it) {
+    blitScaled(benchImage, 0, 0, 256, 192, 0, 0, CANVAS_WIDTH, CANVAS_HEIGHT, 0);
+}
+
+void runBlitBilinear(long it) {
+    blitScaled(benchImage, 0, 0, 256, 192, 0, 0, CANVAS_WIDTH, CANVAS_HEIGHT, BLIT_BILINEAR);
+}
+
+void runPack565(long it) {
+    surfaceToRGB565(benchImage, image16, 256);
+    sink += image16[it & 255];
+}
+
+void runUnpack565(long it) {
+    surfaceFromRGB565(benchUnpacked, image16, 256);
+    sink += benchUnpacked->pixels[it & 255];
+}
+
+/* a HUD line and its width, as the game draws them every frame */
+const char *hudText = "ENTER shoot   LEFT/RIGHT move   P profiler";
+
+void runDrawText(long it) {
+    drawText(builtinFont(), 10, 10, hudText, white);
+}
+
+void runMeasureText(long it) {
+    int w, h;
+    measureText(builtinFont(), hudText, &w, &h);
+    sink += w;
+}
+
+Benchmark benchmarks[] = {
+    {"setXY", clearCanvas, runSetXY, 1},
+    {"printBackground", clearCanvas, runPrintBackground, 1},
+    {"drawBresenhamLine/horizontal", clearCanvas, runLineHorizontal, 1},
+    {"drawBresenhamLine/vertical", clearCanvas, runLineVertical, 1},
+    {"drawBresenhamLine/shallow", clearCanvas, runLineShallow, 1},
+    {"drawBresenhamLine/steep", clearCanvas, runLineSteep, 1},
+    {"drawBresenhamLine/negative", clearCanvas, runLineNegative, 1},
+    {"drawBresenhamLine/width3", clearCanvas, runLineWide3, 1},
+    {"drawBresenhamLine/width8", clearCanvas, runLineWide8, 1},
+    {"drawCircle/r300", clearCanvas, runCircle, 1},
+    {"drawCircle/r300_width3", clearCanvas, runCircleWide, 1},
+    {"floodFill/small", setupSmallFill, runSmallFill, 1},
+    {"floodFill/large", setupLargeFill, runLargeFill, 1},
+    {"floodFill/large_4threads", setupLargeFill, runLargeFillParallel, 1},
+    {"boundaryFill/large", setupLargeFill, runBoundaryFill, 1},
+    {"fillRegion/tolerance8_connect8", setupLargeFill, runToleranceFill8, 1},
+    {"rasterFill/boxes", setupBoxes, runRasterFill, 1},
+    {"clipLine", setupClip, runClipLine, 0},
+    {"rotatePoint", clearCanvas, runRotatePoint, 0},
+    {"convertRow16", setupLargeFill, runConvert16, 0},
+    {"convertRow8", setupLargeFill, runConvert8, 0},
+    {"loadPolygonMap/building", clearCanvas, runLoadBuilding, 0},
+    {"loadPolygonMap/jalan", clearCanvas, runLoadJalan, 0},
+    {"loadPolygonMap/pohon", clearCanvas, runLoadPohon, 0},
+    {"loadImage/png", clearCanvas, runLoadPNG, 0},
+    {"loadImage/bmp_in_place", clearCanvas, runLoadBMP, 0},
+    {"loadImage/ppm", clearCanvas, runLoadPPM, 0},
+    {"drawPolygonMap/maps", setupMaps, runDrawMaps, 1},
+    {"executeCommandsTiled/maps", setupMaps, runDrawMapsTiled, 1},
+    {"recordPolygonMap/maps", setupMaps, runRecordMaps, 0},
+    {"drawText/hud", clearCanvas, runDrawText, 1},
+    {"measureText/hud", clearCanvas, runMeasureText, 0},
+    {"blitSurface/alpha", setupImage, runBlitAlpha, 1},
+    {"blitSurface/colorkey", setupImage, runBlitColorkey, 1},
+    {"blitScaled/nearest_4x", setupImage, runBlitNearest, 1},
+    {"blitScaled/bilinear_4x", setupImage, runBlitBilinear, 1},
+    {"packRow565/image", setupImage, runPack565, 0},
+    {"encodePNG/maps", setupScreenshot, runEncodePNG, 0},
+    {"captureFrame/recording", setupRecording, runCaptureFrame, 0},
+    {"unpackRow565/image", setupImage, runUnpack565, 0},
+};
+
+/*
+Run b until MIN_BENCH_NS has elapsed, doubling the iteration count
+*/
+void runBenchmark(Benchmark *b, int first) {
+    long pixels = b->drawsPixels ? countChangedPixels(b) : 0;
+    long iterations = 1;
+    long elapsed;
+    unsigned long allocations;
+
+    while (1) {
+        b->setup();
+        allocations = allocationCount;
+        long start = nowNs();
+        for (long i = 0; i < iterations; i++) {
+            b->run(i);
+        }
+        elapsed = nowNs() - start;
+        allocations = allocationCount - allocations;
+        if (elapsed >= MIN_BENCH_NS) break;
+        iterations *= 2;
+    }
+
+    double nsPerOp = (double)elapsed / iterations;
+    printf("%s    {\"name\": \"%s\", \"iterations\": %ld, \"ns_per_op\": %.2f, "
+           "\"pixels_per_op\": %ld, \"mpixels_per_s\": %.3f, \"allocs_per_op\": %.3f}",
+           first ? "" : ",\n", b->name, iterations, nsPerOp, pixels,
+           pixels ? pixels * 1000.0 / nsPerOp : 0.0,
+           (double)allocations / iterations);
+    fflush(stdout);
+}
+
+int main(int argc, char **argv) {
+    const char *filter = argc > 1 ? argv[1] : 0;
+    int first = 1;
+
+    black = setColor(0, 0, 0);
+    white = setColor(255, 255, 255);
+    red = setColor(255, 0, 0);
+    green = setColor(0, 255, 0);
+
+    buildPalette(&screenPalette);
+
+    canvas = createSurface(CANVAS_WIDTH, CANVAS_HEIGHT);
+    if (!canvas) {
+        fprintf(stderr, "Error: cannot allocate benchmark canvas\n");
+        return 1;
+    }
+    setRenderTarget(canvas);
+
+    printf("{\n  \"canvas\": [%d, %d],\n  \"benchmarks\": [\n", CANVAS_WIDTH, CANVAS_HEIGHT);
+    for (unsigned i = 0; i < sizeof(benchmarks) / sizeof(benchmarks[0]); i++) {
+        if (filter && !strstr(benchmarks[i].name, filter)) continue;
+        runBenchmark(&benchmarks[i], first);
+        first = 0;
+    }
+    printf("\n  ]\n}\n");
+
+    setRenderTarget(0);
+    destroySurface(canvas);
+    freeCommandList(&benchList);
+    freePolygonMap(buildingMap);
+    freePolygonMap(pohonMap);
+    terminateCapture();
+    return 0;
+}
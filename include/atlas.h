@@ -0,0 +1,30 @@
+#ifndef ATLAS_H
+#define ATLAS_H
+
+#include "point.h"
+#include "color.h"
+#include "surface.h"
+#include "sprite.h"
+
+// default number of pre-rendered rotation steps (10 degrees apart)
+#define ROTATION_ATLAS_STEPS 36
+
+/*
+N rotation steps of one shape packed row-major into a single surface,
+one shape-sized cell per step
+*/
+typedef struct {
+    Surface *surface;
+    int steps;
+    int columns;
+    int cellWidth;
+    int cellHeight;
+    int anchorX;
+    int anchorY;
+} RotationAtlas;
+
+RotationAtlas* createRotationAtlas(const SpriteShape *shape, int steps, Color c);
+void destroyRotationAtlas(RotationAtlas *atlas);
+void drawRotated(RotationAtlas *atlas, Point p, int angle);
+
+#endif
@@ -0,0 +1,19 @@
+#ifndef BLIT_H
+#define BLIT_H
+
+#include <stdint.h>
+#include "surface.h"
+
+// Destination pixels sampled per pass of blitScaled and flipped blits
+#define BLIT_CHUNK 256
+
+void blitRow(uint32_t *dst, const uint32_t *src, int n, int flags);
+void blitRowXY(int x, int y, const uint32_t *src, int n, int flags);
+void blitScaled(Surface *src, int sx, int sy, int sw, int sh, int x, int y, int w, int h, int flags);
+
+void packRow565(uint16_t *dst, const uint32_t *src, int n);
+void unpackRow565(uint32_t *dst, const uint16_t *src, int n);
+void surfaceToRGB565(const Surface *s, uint16_t *dst, int pitch);
+void surfaceFromRGB565(Surface *s, const uint16_t *src, int pitch);
+
+#endif
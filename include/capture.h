@@ -0,0 +1,34 @@
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include "surface.h"
+
+// screenshot formats
+#define CAPTURE_PPM 0
+#define CAPTURE_PNG 1
+
+// Frame buffers in the pool; a frame presented while every one of them is
+// still waiting for the writer is dropped, never waited for
+#define CAPTURE_SLOTS 4
+#define CAPTURE_PATH_MAX 256
+
+extern volatile int captureArmed;
+
+int initCapture(void);
+void terminateCapture(void);
+int captureScreenshot(const char *path, int format);
+int startRecording(const char *path);
+void stopRecording(void);
+int isRecording(void);
+unsigned long droppedCaptures(void);
+void captureSurface(const Surface *s);
+
+/*
+Called by presentScreen with every presented frame: a single branch
+unless a screenshot is pending or a recording is running
+*/
+static inline void captureFrame(const Surface *s) {
+    if (captureArmed) captureSurface(s);
+}
+
+#endif
@@ -0,0 +1,73 @@
+#ifndef CMDBUFFER_H
+#define CMDBUFFER_H
+
+#include "point.h"
+#include "color.h"
+#include "surface.h"
+#include "geometry.h"
+
+#define CMD_BACKGROUND 1
+#define CMD_LINE 2
+#define CMD_POLYGON 3
+#define CMD_FILL 4
+#define CMD_RECT 5
+#define CMD_BLIT 6
+#define CMD_PRESENT 7
+
+/*
+One recorded draw call. Polygon vertices live in the owning list's
+vertex array starting at vertexOffset.
+*/
+typedef struct {
+    unsigned char type;
+    unsigned char width;
+    unsigned short flags;
+    Color color;
+    union {
+        struct { Point p1, p2; } line;
+        struct { int vertexOffset, count; } polygon;
+        struct { int x, y; } fill;
+        struct { int x, y, w, h; } rect;
+        struct { Surface *surface; int x, y; } blit;
+        struct { Surface *surface; } present;
+    };
+} RenderCommand;
+
+typedef struct {
+    RenderCommand *commands;
+    int count;
+    int capacity;
+    Point *vertices;
+    int vertexCount;
+    int vertexCapacity;
+} CommandList;
+
+int initRenderThread(void);
+void terminateRenderThread(void);
+
+// recording, from a single producer thread
+void cmdBackground(Color C);
+void cmdLine(Point P1, Point P2, Color C, int W);
+void cmdPolygon(int n, Point *P, Color C, int W);
+void cmdPolygonBatch(const PolygonBatch *batch);
+void cmdFill(int x, int y, Color C);
+void cmdRect(int x, int y, int w, int h, Color C);
+void cmdBlit(Surface *src, int x, int y, int flags);
+void cmdPresent(Surface *back);
+int submitCommands(void);
+unsigned long droppedCommandLists(void);
+
+// lists of your own, recorded and executed on the calling thread
+int reserveCommands(CommandList *l, int n);
+RenderCommand* newCommand(CommandList *l, int type);
+Point* reserveVertices(CommandList *l, int n);
+int pushVertices(CommandList *l, int n, const Point *P);
+void recordBackground(CommandList *l, Color C);
+void recordPolygon(CommandList *l, int n, const Point *P, Color C, int W);
+void recordPolygonBatch(CommandList *l, const PolygonBatch *batch);
+void executeCommand(CommandList *l, RenderCommand *cmd);
+void executeCommands(CommandList *l);
+void resetCommandList(CommandList *l);
+void freeCommandList(CommandList *l);
+
+#endif
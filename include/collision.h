@@ -0,0 +1,34 @@
+#ifndef COLLISION_H
+#define COLLISION_H
+
+#include "point.h"
+
+typedef struct {
+    int xMin, yMin;
+    int xMax, yMax;
+} AABB;
+
+/*
+Broad phase entry. id is the caller's index for the object; a pair is
+only reported when one side's layer is in the other side's mask.
+*/
+typedef struct {
+    AABB box;
+    int id;
+    unsigned int layer;
+    unsigned int mask;
+} Collider;
+
+typedef struct {
+    int a, b;       // Collider ids
+} CollisionPair;
+
+AABB polygonBounds(int n, const Point *P);
+int aabbOverlap(AABB a, AABB b);
+int pointInPolygon(Point p, int n, const Point *P);
+int segmentsIntersect(Point a, Point b, Point c, Point d);
+int polygonsIntersect(int n1, const Point *P1, int n2, const Point *P2);
+void transformPolygon(int n, const Point *local, Point origin, int direction, Point *out);
+int sweepAndPrune(Collider *colliders, int n, CollisionPair *pairs, int maxPairs);
+
+#endif
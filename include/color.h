@@ -32,4 +32,8 @@ static inline struct color_rgba make_color(uint8_t r, uint8_t g, uint8_t b, uint
     return c;
 }
 
+// Legacy color helpers (src/core/color.c)
+struct color_rgba setColor(int r, int g, int b);
+int isColorSame(struct color_rgba C1, struct color_rgba C2);
+
 #endif // COLOR_H
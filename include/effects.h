@@ -0,0 +1,61 @@
+#ifndef EFFECTS_H
+#define EFFECTS_H
+
+#include <stdint.h>
+#include "point.h"
+#include "color.h"
+#include "surface.h"
+#include "particles.h"
+
+#define MAX_EMITTERS 32
+#define COLOR_RAMP_SIZE 256
+#define DEFAULT_EFFECT_PARTICLES 65536
+
+/*
+Color over a particle's life, index 0 = just born. Entries are packed
+0x00RRGGBB; black adds nothing, so ramps fade out by ending in black.
+*/
+typedef struct {
+    uint32_t colors[COLOR_RAMP_SIZE];
+} ColorRamp;
+
+typedef struct {
+    Point pos;
+    int burst;              // particles emitted on the first step
+    int rate;               // particles per step afterwards
+    int steps;              // steps left to emit, 0 = done
+    float speedMin, speedMax;
+    float angle, spread;    // degrees; 0 = right, 90 = down
+    float life;             // steps a particle lives (+-25%)
+    int size;               // square side in pixels
+    const ColorRamp *ramp;
+} Emitter;
+
+/*
+Emitters feed one particle pool; the particle tag is the emitter slot so
+each particle finds its ramp and lifetime after the emitter is done. A
+slot is not reused until the last particle it emitted has expired.
+density (0..1) scales every emission: the quality knob for slow
+hardware.
+*/
+typedef struct {
+    ParticleSystem particles;
+    Emitter emitters[MAX_EMITTERS];
+    int lingering[MAX_EMITTERS];    // steps until a finished emitter's
+                                    // particles have all expired
+    int nextEmitter;                // slots are handed out round-robin
+    float density;
+    uint32_t seed;
+} EffectSystem;
+
+void buildColorRamp(ColorRamp *ramp, int n, const Color *stops);
+int initEffects(EffectSystem *fx, int maxParticles);
+void freeEffects(EffectSystem *fx);
+void setEffectDensity(EffectSystem *fx, float density);
+Emitter* addEmitter(EffectSystem *fx, const Emitter *e);
+void spawnExplosion(EffectSystem *fx, Point p, int size);
+void updateEffects(EffectSystem *fx);
+void drawEffects(EffectSystem *fx);
+uint32_t addPixelsSaturated(uint32_t a, uint32_t b);
+
+#endif
@@ -0,0 +1,62 @@
+#ifndef ENTITY_H
+#define ENTITY_H
+
+#include "point.h"
+#include "color.h"
+#include "particles.h"
+
+#define MAX_PROJECTILES 32
+#define MAX_PLANES 8
+#define MAX_DEBRIS 64
+
+// distance per 33ms step (the old blocking loop moved 4px every 5ms)
+#define PROJECTILE_STEP 26
+#define PLANE_STEP 8
+
+typedef enum {
+    DEBRIS_PARACHUTE,
+    DEBRIS_COCKPIT,
+    DEBRIS_BODY,
+    DEBRIS_WINGS,
+    DEBRIS_PROPELLER
+} DebrisKind;
+
+typedef struct {
+    Point pos;          // tip
+    Point prev;         // position one step earlier, for interpolation
+} Projectile;
+
+typedef struct {
+    Point pos;
+    Point prev;
+    int dx, dy;         // -1 or 1 per axis
+} Plane;
+
+/*
+Every live game object, one fixed-capacity array per type so each update
+and draw pass walks contiguous memory. Removing an entity moves the last
+one of its type into the hole. Debris live in a particle system whose tag
+is the DebrisKind.
+*/
+typedef struct {
+    Projectile projectiles[MAX_PROJECTILES];
+    int projectileCount;
+    Plane planes[MAX_PLANES];
+    int planeCount;
+    ParticleSystem debris;
+
+    int planesDestroyed;
+    Plane lastDestroyed;
+    int lastWings;      // debris index of its wings, -1 until a crash
+} World;
+
+int initWorld(World *w);
+void freeWorld(World *w);
+int spawnProjectile(World *w, Point tip);
+int spawnPlane(World *w, Point p, int dx, int dy);
+int spawnDebris(World *w, DebrisKind kind, Point p, int vx, int vy);
+int planeDirection(const Plane *plane);
+void updateWorld(World *w);
+void drawWorld(World *w, float alpha, Color planeColor);
+
+#endif
@@ -6,8 +6,24 @@
 #include "framebuffer.h"
 #include "pointqueue.h"
 
+// fillRegion flags
+#define FILL_BOUNDARY 1     // fill up to the ref color instead of over it
+#define FILL_CONNECT8 2     // spread across diagonals too
+
+void fillRegion(int x, int y, Color C, Color ref, int tolerance, int flags);
 void floodFill(int fp_x, int fp_y, Color C, Color fc);
+void boundaryFill(int x, int y, Color C, Color boundary);
+void toleranceFill(int x, int y, Color C, int tolerance);
+void setFillThreads(int n);
 void flood(int x, int y, Color newColor, Color oldColor);
+// Parallel fills run bands of at least FILL_MIN_ROWS rows on up to
+// FILL_MAX_THREADS threads; fillRegion only goes parallel once a fill
+// has written FILL_PARALLEL_PIXELS pixels
+#define FILL_MAX_THREADS 8
+#define FILL_MIN_ROWS 32
+#define FILL_PARALLEL_PIXELS (256 * 1024)
+
+void rasterFill(int x_min, int y_min, int x_max, int y_max, Color boundary, Color C);
 void raster_fill(int y_min, int y_max, int x_min, int x_max);
 
 #endif
@@ -0,0 +1,36 @@
+#ifndef FRAME_H
+#define FRAME_H
+
+#include <time.h>
+
+#define DEFAULT_TARGET_FPS 60
+// game logic is tuned for 33ms ticks
+#define SIMULATION_HZ 30
+// simulation steps run per frame before the backlog is dropped
+#define MAX_STEPS_PER_FRAME 5
+// a frame this late still keeps the schedule instead of waiting for the
+// next frame boundary
+#define FRAME_LATE_SLACK_NS 2000000L
+
+/*
+Fixed-step simulation with variable-rate rendering, paced against
+absolute CLOCK_MONOTONIC deadlines
+*/
+typedef struct {
+    int targetFps;
+    long frameNs;
+    long stepNs;
+    long accumulator;           // simulation time not yet stepped
+    struct timespec last;       // time of the previous frameBegin
+    struct timespec deadline;   // absolute end of the current frame
+    unsigned long frames;
+    unsigned long droppedFrames;
+} FrameScheduler;
+
+void initFrameScheduler(FrameScheduler *fs, int targetFps, int simulationHz);
+void setTargetFps(FrameScheduler *fs, int targetFps);
+int frameBegin(FrameScheduler *fs);
+float frameAlpha(FrameScheduler *fs);
+void frameEnd(FrameScheduler *fs);
+
+#endif
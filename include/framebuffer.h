@@ -1,12 +1,14 @@
 #ifndef FRAMEBUFFER_H
 #define FRAMEBUFFER_H
 
+#include <linux/fb.h>
 #include "graphics.h"
+#include "surface.h"
 
 // Screen and framebuffer variables
 extern char *fbp;
 extern int fbfd;
-extern int screensize;
+extern long int screensize;
 extern int displayWidth;
 extern int displayHeight;
 extern int displayDepth;
@@ -14,5 +16,30 @@ extern int finfo_line_length;
 extern int vinfo_xres;
 extern int vinfo_yres;
 extern int vinfo_bits_per_pixel;
+extern struct fb_var_screeninfo vinfo;
+extern struct fb_fix_screeninfo finfo;
+
+// Render target redirection: setXY/getXY/printBackground draw into the
+// given surface instead of the screen while a target is set (0 = screen)
+void setRenderTarget(Surface *target);
+Surface* getRenderTarget(void);
+Surface* getScreenSurface(void);
+int renderWidth(void);
+int renderHeight(void);
+void presentScreen(const Surface *back);
+
+/*
+Tile redirection of the calling thread, used by the tile renderer: while
+set, setXY, getXY and printBackground of this thread work on surface,
+which holds the render target pixels starting at (x, y). setXY still
+clips against the whole render target, then against the tile.
+*/
+typedef struct {
+    Surface *surface;
+    int x, y;
+    long pixels;        // pixels written, added to the stats by the caller
+} TileTarget;
+
+void setTileTarget(TileTarget *tile);
 
 #endif // FRAMEBUFFER_H
@@ -12,6 +12,9 @@ extern int planeloc;
 extern int endSign;
 void buildCannon(int x, int y, Color c);
 void shootCannon();
+int takeFireRequest(Point *muzzle);
+int projectileHitsPlane(int x, int y, Point p, int direction);
+void drawProjectile(Point p);
 void drawBaling(int x, int y, int rotation);
 void drawTire(Point P, int rot);
 void drawPlane(Point p, int direction, Color planeColor);
@@ -21,5 +24,7 @@ void drawBrokenPlaneWings(Point lastPoint);
 void drawParachute(Point anc);
 void drawTank(Point anc);
 void drawRect(int x, int y, int w, int h, Color c);
+void initGameSprites(int rotationSteps);
+void freeGameSprites(void);
 
 #endif
@@ -5,10 +5,36 @@
 #include "color.h"
 #include "framebuffer.h"
 
+/*
+Style of one polygon of a batch
+*/
+typedef struct {
+    Color color;
+    int width;
+} PolygonStyle;
+
+/*
+Polygons sharing one vertex buffer: polygon i is
+vertices[offsets[i]] .. vertices[offsets[i+1] - 1], outlined with
+styles[i], or with styles[0] for all of them when styleCount is 1.
+*/
+typedef struct {
+    const Point *vertices;
+    const int *offsets;         // count + 1 entries
+    const PolygonStyle *styles;
+    int styleCount;             // count, or 1 for one shared style
+    int count;
+} PolygonBatch;
+
+static inline const PolygonStyle* batchStyle(const PolygonBatch *batch, int i) {
+    return &batch->styles[batch->styleCount == 1 ? 0 : i];
+}
+
 void drawBresenhamLine (Point P1, Point P2, Color C, int W);
 void drawPolyline (int n, Point *P, Color C, int W);
 void drawPolygon (int n, Point *P, Color C, int W);
-void drawExplosion (Point initialPoint, int n, Point *P, int scaleFactor);
+void drawPolygonBatch (const PolygonBatch *batch);
+void drawExplosion (Point initialPoint, int n, const Point *P, int scaleFactor);
 void drawCircle (int radius, Point P, int W, Color C);
 void drawCircleHalf (int radius, Point P, int W, Color C);
 void drawRect(int x, int y, int w, int h, Color c);
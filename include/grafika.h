@@ -12,4 +12,13 @@
 #include <sys/mman.h>
 #include <sys/time.h>
 
+#include "framebuffer.h"
+#include "game.h"
+#include "atlas.h"
+#include "physics.h"
+#include "particles.h"
+#include "entity.h"
+#include "effects.h"
+#include "keypress.h"
+
 #endif
@@ -9,7 +9,7 @@
 struct coordinate_point_queue;
 
 // Core framebuffer functions  
-int initScreen(void);
+void initScreen(void);
 void terminate(void);
 int initialize_framebuffer_system(void);
 void terminate_framebuffer_system(void);
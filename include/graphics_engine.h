@@ -33,6 +33,7 @@
 #define SCALE_DOWN_KEY 107
 #define SCALE_UP_KEY 108
 #define SAVE_DRAWING_KEY 115
+#define RECORD_VIDEO_KEY 118
 #define SPACE_KEY_CODE 32
 
 #endif
@@ -0,0 +1,22 @@
+#ifndef IMAGE_H
+#define IMAGE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "surface.h"
+
+// Largest width or height a loader accepts
+#define IMAGE_MAX_SIZE 16384
+
+/*
+Load a PPM/PGM (binary P6/P5), BMP or PNG file, picked by its first
+bytes, into a surface. Images without alpha load opaque. Returns 0 (with
+a message on stderr) when the file cannot be read or decoded; free the
+surface with destroySurface.
+*/
+Surface* loadImage(const char *path);
+
+Surface* decodePNG(const uint8_t *data, size_t size);
+uint8_t* encodePNG(const Surface *s, size_t *size);
+
+#endif
@@ -0,0 +1,26 @@
+#ifndef INPUT_H
+#define INPUT_H
+
+#include <stdint.h>
+#include "keypress.h"
+
+// capacity of the event queue, must be a power of two
+#define INPUT_QUEUE_SIZE 256
+
+#define ESCAPE_KEYPRESS 27
+
+/*
+One key press. Arrow keys are decoded from their escape sequences into
+LEFT_KEYPRESS, RIGHT_KEYPRESS, UP_KEYPRESS and DOWN_KEYPRESS.
+*/
+typedef struct {
+    int key;
+    uint64_t timestamp;     // CLOCK_MONOTONIC, nanoseconds
+} InputEvent;
+
+int initInput(void);
+void terminateInput(void);
+int pollInputEvent(InputEvent *ev);
+unsigned long droppedInputEvents(void);
+
+#endif
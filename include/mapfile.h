@@ -0,0 +1,24 @@
+#ifndef MAPFILE_H
+#define MAPFILE_H
+
+#include "point.h"
+#include "color.h"
+#include "cmdbuffer.h"
+
+/*
+Polygons loaded from a map file (see examples/): a vertex count followed
+by that many "x y" lines, repeated. Polygon i is
+vertices[offsets[i]] .. vertices[offsets[i+1] - 1].
+*/
+typedef struct {
+    Point *vertices;
+    int *offsets;       // count + 1 entries
+    int count;
+} PolygonMap;
+
+PolygonMap* loadPolygonMap(const char *path);
+void freePolygonMap(PolygonMap *map);
+void drawPolygonMap(const PolygonMap *map, Point offset, double scale, Color C, int W);
+void recordPolygonMap(CommandList *l, const PolygonMap *map, Point offset, double scale, Color C, int W);
+
+#endif
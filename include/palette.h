@@ -0,0 +1,81 @@
+#ifndef PALETTE_H
+#define PALETTE_H
+
+#include <stdint.h>
+#include "color.h"
+
+#define PALETTE_SIZE 256
+// RGB -> palette index lookup, 5 bits per channel
+#define PALETTE_LUT_BITS 5
+#define PALETTE_LUT_SIZE (1 << PALETTE_LUT_BITS)
+
+/*
+Palette of an 8bpp (pseudocolor) framebuffer: a 6x6x6 color cube followed
+by a gray ramp, and a 32x32x32 table mapping quantized RGB to the nearest
+entry so no search happens per pixel.
+*/
+typedef struct {
+    uint16_t red[PALETTE_SIZE];      // 16 bit per channel, as FBIOPUTCMAP wants it
+    uint16_t green[PALETTE_SIZE];
+    uint16_t blue[PALETTE_SIZE];
+    uint32_t colors[PALETTE_SIZE];   // the same entries as packed 0xAARRGGBB
+    uint8_t lut[PALETTE_LUT_SIZE * PALETTE_LUT_SIZE * PALETTE_LUT_SIZE];
+} Palette;
+
+extern Palette screenPalette;
+extern int ditherEnabled;
+// 4x4 Bayer threshold offsets, one table per quantization step
+extern const int8_t ditherOffset565[2][16];
+extern const int8_t ditherOffsetCube[16];
+
+void buildPalette(Palette *pal);
+int loadPalette(int fd, const Palette *pal);
+void setDithering(int on);
+
+static inline uint8_t paletteIndex(const Palette *pal, int r, int g, int b) {
+    return pal->lut[((r >> 3) << 10) | ((g >> 3) << 5) | (b >> 3)];
+}
+
+static inline int clampChannel(int c) {
+    return c < 0 ? 0 : (c > 255 ? 255 : c);
+}
+
+/*
+RGB565 packing: channels are scaled down to 5, 6 and 5 bits
+*/
+static inline uint16_t packRGB565(int r, int g, int b) {
+    return (uint16_t)((r >> 3) << 11 | (g >> 2) << 5 | (b >> 3));
+}
+
+static inline Color unpackRGB565(uint16_t t) {
+    int r = t >> 11, g = (t >> 5) & 63, b = t & 31;
+    return make_color(r << 3 | r >> 2, g << 2 | g >> 4, b << 3 | b >> 2, 255);
+}
+
+/*
+Ordered-dithered conversions of one 0xAARRGGBB pixel at screen (x, y)
+*/
+static inline uint16_t ditherRGB565(uint32_t pixel, int x, int y) {
+    int k = (y & 3) << 2 | (x & 3);
+    int rb = ditherOffset565[0][k], g = ditherOffset565[1][k];
+    return packRGB565(clampChannel((int)(pixel >> 16 & 255) + rb),
+                      clampChannel((int)(pixel >> 8 & 255) + g),
+                      clampChannel((int)(pixel & 255) + rb));
+}
+
+static inline uint8_t ditherIndex(const Palette *pal, uint32_t pixel, int x, int y) {
+    // exact palette colors (black, white, the cube primaries) stay flat
+    uint8_t exact = paletteIndex(pal, pixel >> 16 & 255, pixel >> 8 & 255, pixel & 255);
+    if (((pal->colors[exact] ^ pixel) & 0xFFFFFF) == 0) {
+        return exact;
+    }
+    int d = ditherOffsetCube[(y & 3) << 2 | (x & 3)];
+    return paletteIndex(pal, clampChannel((int)(pixel >> 16 & 255) + d),
+                        clampChannel((int)(pixel >> 8 & 255) + d),
+                        clampChannel((int)(pixel & 255) + d));
+}
+
+void convertRow16(uint16_t *dst, const uint32_t *src, int n, int y);
+void convertRow8(uint8_t *dst, const uint32_t *src, int n, int y);
+
+#endif
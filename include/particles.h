@@ -0,0 +1,45 @@
+#ifndef PARTICLES_H
+#define PARTICLES_H
+
+#include "point.h"
+
+// floats per SIMD vector (SSE width); capacities are rounded up to a
+// multiple of this
+#define PARTICLE_LANES 4
+// life value of particles that never expire
+#define PARTICLE_IMMORTAL -1
+
+typedef float v4sf __attribute__((vector_size(PARTICLE_LANES * sizeof(float))));
+typedef int v4si __attribute__((vector_size(PARTICLE_LANES * sizeof(int))));
+
+/*
+Particles stored as structure-of-arrays so one update touches whole
+vectors. Same units as PhysicsPoint: position in pixels, velocity in
+tenths of a pixel per simulation step. Live particles are 0..count-1;
+killing one moves the last particle into its slot, so indices are only
+stable while nothing is killed.
+*/
+typedef struct {
+    int capacity;
+    int count;
+    float *x, *y;
+    float *vx, *vy;
+    float *life;            // steps left, or PARTICLE_IMMORTAL
+    int *bounces;           // ground contacts so far
+    int *tag;               // caller data, moves with the particle
+
+    float gravity;          // added to vy every step
+    float drag;             // taken off |vx| every step
+    float groundY;          // particles bounce off y = groundY
+    float restitution;      // vy kept (and reversed) on a bounce
+    float groundFriction;   // vx kept on a bounce
+} ParticleSystem;
+
+int initParticleSystem(ParticleSystem *ps, int capacity);
+void freeParticleSystem(ParticleSystem *ps);
+int spawnParticle(ParticleSystem *ps, float x, float y, float vx, float vy, float life);
+void killParticle(ParticleSystem *ps, int i);
+void updateParticles(ParticleSystem *ps);
+Point particlePosition(const ParticleSystem *ps, int i);
+
+#endif
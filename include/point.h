@@ -3,13 +3,29 @@
 
 // Unified point structure with both naming conventions
 struct point_2d {
-    int x_coordinate;
-    int y_coordinate;
+    union {
+        struct {
+            int x_coordinate;
+            int y_coordinate;
+        };
+        struct {
+            int x;
+            int y;
+        };
+    };
 };
 
 struct coordinate_point {
-    int x_coordinate;
-    int y_coordinate;
+    union {
+        struct {
+            int x_coordinate;
+            int y_coordinate;
+        };
+        struct {
+            int x;
+            int y;
+        };
+    };
 };
 
 // Provide compatibility typedefs
@@ -24,4 +40,7 @@ static inline struct point_2d make_point(int x, int y) {
     return p;
 }
 
+// Legacy point constructor (src/utils/point.c)
+struct point_2d makePoint(int x, int y);
+
 #endif // POINT_H
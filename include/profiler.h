@@ -0,0 +1,64 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <time.h>
+
+typedef enum {
+    PROFILE_CLEAR,
+    PROFILE_GEOMETRY,
+    PROFILE_FILL,
+    PROFILE_CLIP,
+    PROFILE_TRANSFORM,
+    PROFILE_BLIT,
+    PROFILE_PHYSICS,
+    PROFILE_PRESENT,
+    PROFILE_SECTIONS
+} ProfileSection;
+
+// frames kept for the overlay and the CSV dump
+#define PROFILE_HISTORY 240
+
+typedef struct {
+    unsigned long frame;
+    long frameNs;                       // wall time since the previous sample
+    long sectionNs[PROFILE_SECTIONS];
+} ProfileSample;
+
+extern volatile int profilerEnabled;
+extern __thread int profileDepth[PROFILE_SECTIONS];
+extern __thread long profileStart[PROFILE_SECTIONS];
+extern long profileCurrent[PROFILE_SECTIONS];
+
+static inline long profileNow(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000L + ts.tv_nsec;
+}
+
+/*
+Scoped section timer. Nested begins of the same section (drawPolygon
+calling drawBresenhamLine) are timed once, by the outermost pair.
+When profiling is off this is a load and a branch.
+*/
+static inline void profileBegin(ProfileSection s) {
+    if (!profilerEnabled) return;
+    if (profileDepth[s]++ == 0) {
+        profileStart[s] = profileNow();
+    }
+}
+
+static inline void profileEnd(ProfileSection s) {
+    // checks depth rather than the flag so a toggle mid-section stays balanced
+    if (profileDepth[s] == 0) return;
+    if (--profileDepth[s] == 0) {
+        __atomic_fetch_add(&profileCurrent[s], profileNow() - profileStart[s], __ATOMIC_RELAXED);
+    }
+}
+
+void setProfilerEnabled(int enabled);
+void profileFrame(void);
+const ProfileSample* getProfileSample(int age);
+void drawProfilerOverlay(int x, int y);
+int dumpProfileCSV(const char *path);
+
+#endif
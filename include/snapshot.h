@@ -0,0 +1,13 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <stdint.h>
+#include "surface.h"
+
+int writeSurfacePPM(const Surface *s, const char *path);
+int writeSurfacePNG(const Surface *s, const char *path);
+Surface* readSurfacePPM(const char *path);
+uint64_t hashSurface(const Surface *s);
+long compareSurfaces(const Surface *expected, const Surface *actual, int tolerance, Surface *diff);
+
+#endif
@@ -0,0 +1,36 @@
+#ifndef SPRITE_H
+#define SPRITE_H
+
+#include "point.h"
+#include "color.h"
+#include "surface.h"
+
+#define SPRITE_ROTATION_BUCKETS 16
+#define MAX_SPRITE_SHAPES 16
+
+/*
+Description of a shape that can be rasterized once into a sprite.
+draw renders the shape with its anchor at anc; the surface is
+width x height with the anchor at (anchorX, anchorY).
+*/
+typedef struct {
+    int id;             // cache slot, 0 .. MAX_SPRITE_SHAPES-1
+    int width;
+    int height;
+    int anchorX;
+    int anchorY;
+    void (*draw)(Point anc, Color c, int angle);
+} SpriteShape;
+
+typedef struct {
+    Surface *surface;
+    int anchorX;
+    int anchorY;
+    Color color;
+} Sprite;
+
+Sprite* getSprite(const SpriteShape *shape, int angle, Color c);
+void drawSprite(const SpriteShape *shape, Point p, int direction, int angle, Color c);
+void freeSpriteCache(void);
+
+#endif
@@ -0,0 +1,43 @@
+#ifndef STATS_H
+#define STATS_H
+
+typedef enum {
+    STAT_PIXELS_WRITTEN,
+    STAT_PIXELS_READ,           // getXY read-backs
+    STAT_SPANS,                 // horizontal runs written in one pass
+    STAT_FILLS,
+    STAT_QUEUE_ALLOCS,
+    STAT_BYTES_PRESENTED,
+    STAT_FRAMES_DROPPED,
+    ENGINE_STATS
+} EngineStat;
+
+typedef struct {
+    unsigned long counters[ENGINE_STATS];
+} EngineStats;
+
+/*
+Counters of one thread. Only the owner writes them (relaxed stores, no
+read-modify-write), readers sum every block.
+*/
+typedef struct StatsBlock {
+    unsigned long counters[ENGINE_STATS];
+    struct StatsBlock *next;
+} StatsBlock;
+
+extern __thread StatsBlock *threadStats;
+StatsBlock* registerThreadStats(void);
+
+static inline void countStat(EngineStat s, unsigned long n) {
+    StatsBlock *b = threadStats;
+    if (!b && !(b = registerThreadStats())) return;
+    __atomic_store_n(&b->counters[s], b->counters[s] + n, __ATOMIC_RELAXED);
+}
+
+EngineStats getEngineStats(void);
+const char* engineStatName(EngineStat s);
+void dumpEngineStats(int fd);
+int installStatsSignalHandler(void);
+EngineStats get_engine_stats(void);
+
+#endif
@@ -0,0 +1,76 @@
+#ifndef SURFACE_H
+#define SURFACE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "color.h"
+
+// Pixel value treated as transparent by BLIT_COLORKEY (alpha 0 magenta,
+// never produced by packColor)
+#define SURFACE_COLORKEY 0x00FF00FF
+
+// What getXY reads outside the drawable area: alpha 0 black, which
+// packColor never produces
+#define PIXEL_NONE 0x00000000
+
+// Packed color matching compares the RGB bytes only
+#define PIXEL_RGB_MASK 0x00FFFFFF
+// Per-channel tolerance of isColorSame
+#define COLOR_TOLERANCE 1
+
+// blit flags
+#define BLIT_COLORKEY 1
+#define BLIT_FLIP_X 2
+#define BLIT_ALPHA 4        // blend by the source alpha byte
+#define BLIT_BILINEAR 8     // blitScaled: filter instead of nearest
+
+/*
+Off-screen 32bpp surface, pixels stored as 0xAARRGGBB. Images loaded in
+place keep the file mapped: pixels then point into mapping, and pitch is
+negative for rows stored bottom-up.
+*/
+typedef struct {
+    int width;
+    int height;
+    int pitch;          // pixels per row
+    uint32_t *pixels;
+    void *mapping;      // file mapping that owns pixels, 0 when malloc does
+    size_t mappingSize;
+} Surface;
+
+Surface* createSurface(int width, int height);
+Surface* allocSurface(int width, int height);
+void destroySurface(Surface *s);
+void clearSurface(Surface *s, uint32_t pixel);
+
+uint32_t packColor(Color C);
+Color unpackColor(uint32_t pixel);
+
+static inline uint32_t* surfaceRow(const Surface *s, int y) {
+    return s->pixels + (long)y * s->pitch;
+}
+
+static inline int pixelsEqual(uint32_t a, uint32_t b) {
+    return ((a ^ b) & PIXEL_RGB_MASK) == 0;
+}
+
+/*
+Every RGB channel of a and b differs by at most tolerance
+*/
+static inline int pixelsSimilar(uint32_t a, uint32_t b, int tolerance) {
+    if (pixelsEqual(a, b)) {
+        return 1;
+    }
+    for (int shift = 0; shift < 24; shift += 8) {
+        int d = (int)(a >> shift & 255) - (int)(b >> shift & 255);
+        if (d > tolerance || d < -tolerance) return 0;
+    }
+    return 1;
+}
+
+int matchRun(const uint32_t *row, int n, uint32_t ref, int tolerance, int want);
+
+void blitSurface(Surface *src, int x, int y, int flags);
+void blitSurfaceRect(Surface *src, int sx, int sy, int w, int h, int x, int y, int flags);
+
+#endif
@@ -0,0 +1,46 @@
+#ifndef TEXT_H
+#define TEXT_H
+
+#include <stdint.h>
+#include "color.h"
+
+// Widest glyph a Font can hold: one glyph row is one 32 bit mask
+#define FONT_MAX_WIDTH 32
+// Codepoints below this are looked up directly, the rest by binary search
+#define FONT_DIRECT_MAP 256
+// Strings remembered by measureText, per thread, and the longest one
+// (in bytes) it remembers; longer strings are measured every time
+#define TEXT_CACHE_SIZE 64
+#define TEXT_CACHE_LENGTH 48
+
+typedef struct {
+    uint32_t codepoint;
+    uint16_t glyph;
+} FontMapping;
+
+/*
+Monospace bitmap font. Every glyph is a width x height 1-bit mask and
+the masks sit back to back in one atlas, row r of glyph g at
+masks[g * height + r] with bit i set for column i.
+*/
+typedef struct {
+    int width;
+    int height;
+    int glyphCount;
+    uint32_t *masks;
+    uint16_t direct[FONT_DIRECT_MAP];   // codepoint -> glyph
+    FontMapping *mappings;              // the other codepoints, sorted
+    int mappingCount;
+    uint16_t fallback;                  // glyph drawn for unmapped codepoints
+    int builtin;
+} Font;
+
+Font* builtinFont(void);
+Font* loadFont(const char *path);
+void freeFont(Font *font);
+
+int fontGlyph(const Font *font, uint32_t codepoint);
+void drawText(const Font *font, int x, int y, const char *text, Color C);
+void measureText(const Font *font, const char *text, int *width, int *height);
+
+#endif
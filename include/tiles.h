@@ -0,0 +1,18 @@
+#ifndef TILES_H
+#define TILES_H
+
+#include "cmdbuffer.h"
+
+// Screen tiles of the binning renderer, TILE_SIZE x TILE_SIZE pixels
+#define TILE_SHIFT 6
+#define TILE_SIZE (1 << TILE_SHIFT)
+// Tiles are rendered on up to TILE_MAX_THREADS threads, each taking at
+// least TILE_MIN_TILES busy tiles
+#define TILE_MAX_THREADS 8
+#define TILE_MIN_TILES 4
+
+void executeCommandsTiled(CommandList *l);
+void setTileThreads(int n);
+void terminateTileThreads(void);
+
+#endif
@@ -0,0 +1,46 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+// events kept per thread; later events are dropped and counted
+#define TRACE_BUFFER_EVENTS 65536
+
+typedef struct {
+    const char *name;       // must outlive the trace (string literals)
+    long timestamp;         // CLOCK_MONOTONIC ns
+    char phase;             // 'B' begin, 'E' end, 'i' instant
+} TraceEvent;
+
+/*
+One per thread. Only the owning thread appends; count is published with
+release ordering so writeTrace can read a consistent prefix without locks.
+*/
+typedef struct TraceBuffer {
+    int tid;
+    const char *threadName;
+    unsigned int count;
+    unsigned long dropped;
+    struct TraceBuffer *next;
+    TraceEvent events[TRACE_BUFFER_EVENTS];
+} TraceBuffer;
+
+extern volatile int tracingEnabled;
+
+void traceEvent(const char *name, char phase);
+
+static inline void traceBegin(const char *name) {
+    if (tracingEnabled) traceEvent(name, 'B');
+}
+
+static inline void traceEnd(const char *name) {
+    if (tracingEnabled) traceEvent(name, 'E');
+}
+
+static inline void traceInstant(const char *name) {
+    if (tracingEnabled) traceEvent(name, 'i');
+}
+
+int initTracing(const char *path);
+void traceThreadName(const char *name);
+int writeTrace(void);
+
+#endif
@@ -1,126 +1,202 @@
 #include "grafika.h"
+#include "frame.h"
+#include "input.h"
+#include "profiler.h"
+#include "trace.h"
+#include "stats.h"
+#include "text.h"
+#include "blit.h"
+#include "image.h"
 
 int endSign = 0;
 int left= 100;
 int planeloc = 0;
 
-uint64_t getTimeStamp() {
-    struct timeval tv;
-    gettimeofday(&tv,NULL);
-    return tv.tv_sec*(uint64_t)1000000+tv.tv_usec;
+FrameScheduler frameScheduler;
+Surface *backBuffer;
+Surface *background;
+
+/* PAINT_BACKGROUND names an image to draw instead of the flat sky; it is
+   scaled to the screen once here so each frame only copies it */
+Surface* loadBackground(const char *path) {
+  Surface *image = loadImage(path);
+  if (!image) {
+    return 0;
+  }
+  Surface *scaled = createSurface(displayWidth, displayHeight);
+  if (scaled) {
+    Surface *target = getRenderTarget();
+    setRenderTarget(scaled);
+    blitScaled(image, 0, 0, image->width, image->height, 0, 0, displayWidth, displayHeight, BLIT_BILINEAR);
+    setRenderTarget(target);
+  }
+  destroySurface(image);
+  return scaled;
+}
+
+void drawBackground(Color bgColor) {
+  if (background) {
+    blitSurface(background, 0, 0, 0);
+  } else {
+    printBackground(bgColor);
+  }
+}
+
+Point lerpPoint(Point a, Point b, float t) {
+  return makePoint(a.x + (int)((b.x - a.x) * t), a.y + (int)((b.y - a.y) * t));
 }
 
 
-/* this function is run by the second thread */
-void *keypressListen(void *x_void_ptr) {
-	 int cmd = ' ';
-	 while (1) {
-	 	cmd = getch();
-	 	if (cmd == ENTER_KEYPRESS) { shootCannon();}  
-    else if (cmd == LEFT_KEYPRESS) { left -= 50;} 
-    else if (cmd == RIGHT_KEYPRESS) {	left+= 50;	}
+/* controls line, the profiler graph if enabled, then show the back buffer */
+void presentFrame() {
+  Font *font = builtinFont();
+  drawText(font, 10, renderHeight() - font->height - 10,
+           "ENTER shoot   LEFT/RIGHT move   P profiler", setColor(255, 255, 255));
+  if (profilerEnabled) {
+    drawProfilerOverlay(10, 10);
+  }
+  if (backBuffer) {
+    presentScreen(backBuffer);
+  }
+  profileFrame();
+}
+
+
+/* drain pending key presses; called from the render loop */
+void handleInput() {
+	InputEvent ev;
+	while (pollInputEvent(&ev)) {
+		if (ev.key == ENTER_KEYPRESS) { shootCannon();}  
+		else if (ev.key == LEFT_KEYPRESS) { left -= 50;} 
+		else if (ev.key == RIGHT_KEYPRESS) {	left+= 50;	}
+		else if (ev.key == P_KEYPRESS) { setProfilerEnabled(!profilerEnabled); }
 	}
-	return NULL;
 }
 
 int main()
 {
   int x = 0, y = 0;
   int i, j;
-  int sign;
   long int location = 0;
   Color X = setColor(0,0,0);
   Color C = setColor(255,255,10);
   Color bgColor = setColor(66,134,244);
 
+  initTracing(getenv("PAINT_TRACE"));
+  traceThreadName("main");
+  installStatsSignalHandler();
   initScreen();
- 	printBackground(bgColor);
+  initGameSprites(ROTATION_ATLAS_STEPS);
+  // draw every frame off-screen and present it whole
+  backBuffer = createSurface(displayWidth, displayHeight);
+  if (backBuffer) {
+    setRenderTarget(backBuffer);
+  }
+  if (getenv("PAINT_BACKGROUND")) {
+    background = loadBackground(getenv("PAINT_BACKGROUND"));
+  }
+ 	drawBackground(bgColor);
 
 
   //keypress
- 	pthread_t keypressListener;
-	if(pthread_create(&keypressListener, NULL, keypressListen, &x)) {
-		fprintf(stderr, "Error creating thread\n");
+	if (initInput()) {
 		return 1;
 	}
 
-	int counter = 0;
-	i = 120;
-	j = 150;
-	sign = 1;
-  int ysign = 1;
-
-	while (!endSign){
-    uint64_t start = getTimeStamp();
-
-    i += 8 * sign;
-    j += 8 * ysign;
+  World world;
+  if (initWorld(&world)) {
+    return 1;
+  }
+  spawnPlane(&world, makePoint(120, 150), 1, 1);
 
-    if (i > displayWidth-200) { sign = -1; } 
-    else if (i < 100) { sign = 1;  }
+  EffectSystem effects;
+  if (initEffects(&effects, DEFAULT_EFFECT_PARTICLES)) {
+    return 1;
+  }
+  // 0..1, lower it on slow hardware
+  if (getenv("PAINT_EFFECT_DENSITY")) {
+    setEffectDensity(&effects, atof(getenv("PAINT_EFFECT_DENSITY")));
+  }
 
-    if (j > 200) { sign = -1; } 
-    else if (j < 100) { ysign = 1; } 
+  initFrameScheduler(&frameScheduler, DEFAULT_TARGET_FPS, SIMULATION_HZ);
 
-    printBackground(bgColor);
-  	drawPlane(makePoint(i, j), -sign, X);
-		planeloc = i;
-	    buildCannon(left, displayHeight-100, C);
-
-    uint64_t end = getTimeStamp();
-    if (end-start < 33000) usleep(33000-(end-start));
-	}
-
-
-	int sf = 1;
-  PhysicsPoint parachute = makePhysicsPoint(i, j-200, -100*sign, -100);
-  PhysicsPoint brokenPlaneCockpit = makePhysicsPoint(i, j, 100*sign, -50);
-  PhysicsPoint brokenPlaneBody = makePhysicsPoint(i, j, 100*sign, 0);
-  PhysicsPoint brokenPlaneWings = makePhysicsPoint(i, j, 0, -50);
-  PhysicsPoint baling = makePhysicsPoint(i-40, j+10, -100*sign, 0);
-
-  char hasBounced = 0;
-
-  int bb_x = i - 60;
-  int bb_y = j + 100;
-  int bb_w = 200;
-  int bb_h = 200;
-
-	while (brokenPlaneWings.pos.y < displayHeight - 100 || !hasBounced) {
-    	printBackground(bgColor);
-    	if (sf < 5) {
-    	    //drawExplosion(makePoint(i, 240), 11, explosionPoint, sf);
-    	    sf++;
-    	}
-      updatePhysicsPoint(&parachute);
-      updatePhysicsPoint(&brokenPlaneCockpit);
-      updatePhysicsPoint(&brokenPlaneBody);
-      updatePhysicsPoint(&brokenPlaneWings);
-      updatePhysicsPoint(&baling);
-
-      if (brokenPlaneWings.pos.y > displayHeight - 100 && !hasBounced) {
-        hasBounced = 1;
-        brokenPlaneWings.pos.y = displayHeight - 150;
-        brokenPlaneWings.vel.x = 0;
-        brokenPlaneWings.vel.y = -200;
+	while (!endSign){
+    int steps = frameBegin(&frameScheduler);
+    traceBegin("frame");
+    handleInput();
+    while (steps-- > 0 && !endSign) {
+      updateWorld(&world);
+      if (world.planeCount > 0) {
+        planeloc = world.planes[0].pos.x;
       }
+      endSign = world.planesDestroyed > 0;
+    }
 
-	    //drawBrokenPlaneCockpit(brokenPlaneCockpit.pos);
-	    //drawBrokenPlaneBody(brokenPlaneBody.pos);
-	    drawBrokenPlaneWings(brokenPlaneWings.pos);
-	    //drawParachute(parachute.pos);
-      //drawBaling(baling.pos.x, baling.pos.y, baling.pos.y);
-
-      drawRect(0, 0, displayWidth, bb_y, X);
-      drawRect(0, bb_y, bb_x, bb_h, X);
-      drawRect(bb_x + bb_w, bb_y, displayWidth - bb_x - bb_w, bb_h, X);
-      drawRect(0, bb_y + bb_h, displayWidth, displayHeight - bb_y - bb_h, X);
+    drawBackground(bgColor);
+    if (!endSign) {
+      drawWorld(&world, frameAlpha(&frameScheduler), X);
+    }
+	    buildCannon(left, displayHeight-100, C);
 
-	    usleep(33000);
+    presentFrame();
+    traceEnd("frame");
+    frameEnd(&frameScheduler);
 	}
 
 
-
+  // quitting before a hit, or a full debris pool, leaves no wreck to follow
+  if (world.lastWings >= 0) {
+    i = world.lastDestroyed.pos.x;
+    j = world.lastDestroyed.pos.y;
+    spawnExplosion(&effects, world.lastDestroyed.pos, 2);
+    // the wreck bounces once off the ground and the scene ends when it lands again
+    int brokenPlaneWings = world.lastWings;
+    ParticleSystem *debris = &world.debris;
+    Point prevWings = particlePosition(debris, brokenPlaneWings);
+
+    int bb_x = i - 60;
+    int bb_y = j + 100;
+    int bb_w = 200;
+    int bb_h = 200;
+
+    while (debris->bounces[brokenPlaneWings] < 2) {
+        int steps = frameBegin(&frameScheduler);
+        traceBegin("frame");
+        while (steps-- > 0 && debris->bounces[brokenPlaneWings] < 2) {
+          prevWings = particlePosition(debris, brokenPlaneWings);
+          updateWorld(&world);
+          updateEffects(&effects);
+        }
+
+      drawBackground(bgColor);
+
+      drawBrokenPlaneWings(lerpPoint(prevWings, particlePosition(debris, brokenPlaneWings), frameAlpha(&frameScheduler)));
+
+        drawRect(0, 0, displayWidth, bb_y, X);
+        drawRect(0, bb_y, bb_x, bb_h, X);
+        drawRect(bb_x + bb_w, bb_y, displayWidth - bb_x - bb_w, bb_h, X);
+        drawRect(0, bb_y + bb_h, displayWidth, displayHeight - bb_y - bb_h, X);
+        // the fireball glows over the letterbox
+        drawEffects(&effects);
+
+        presentFrame();
+        traceEnd("frame");
+        frameEnd(&frameScheduler);
+    }
+  }
+
+
+
+  freeEffects(&effects);
+  freeWorld(&world);
+  terminateInput();
+  if (profilerEnabled) {
+    dumpProfileCSV("profile.csv");
+  }
+  setRenderTarget(0);
+  destroySurface(backBuffer);
+  destroySurface(background);
+  freeGameSprites();
   terminate();
 	   
 }
@@ -0,0 +1,313 @@
+#include "capture.h"
+#include "snapshot.h"
+#include "trace.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+
+/*
+Presented frames are copied into a pool of CAPTURE_SLOTS buffers with one
+memcpy and handed to a writer thread, which encodes and writes them, so
+the presenting thread never waits on the disk. A slot goes free ->
+filling (copied into without the lock) -> queued -> writing -> free.
+*/
+#define SLOT_FREE 0
+#define SLOT_FILLING 1
+#define SLOT_QUEUED 2
+#define SLOT_WRITING 3
+
+typedef struct {
+    uint32_t *pixels;           // width * height, rows packed
+    size_t capacity;            // pixels allocated, kept across frames
+    int width, height;
+    int state;
+    unsigned long sequence;     // slots are written in the order captured
+    int shotFormat;             // screenshot to write, -1 for none
+    char shotPath[CAPTURE_PATH_MAX];
+    unsigned long recording;    // recording the frame belongs to, 0 for none
+    char recordPath[CAPTURE_PATH_MAX];
+} CaptureSlot;
+
+volatile int captureArmed = 0;
+CaptureSlot captureSlots[CAPTURE_SLOTS];
+unsigned long captureSequence = 0;
+unsigned long captureDropped = 0;
+int captureRunning = 0;
+
+// screenshot taken from the next presented frame
+int shotPending = 0;
+int shotFormat;
+char shotPath[CAPTURE_PATH_MAX];
+
+// raw recording: every presented frame is appended to recordPath
+unsigned long recordingId = 0;
+int recordingActive = 0;
+char recordPath[CAPTURE_PATH_MAX];
+
+pthread_t captureThread;
+pthread_mutex_t captureLock = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t captureWake = PTHREAD_COND_INITIALIZER;
+
+/*
+The queued slot captured first, or 0. Called with the lock held.
+*/
+CaptureSlot* nextQueuedSlot(void) {
+    CaptureSlot *next = 0;
+    for (int i = 0; i < CAPTURE_SLOTS; i++) {
+        CaptureSlot *slot = &captureSlots[i];
+        if (slot->state == SLOT_QUEUED && (!next || slot->sequence < next->sequence)) {
+            next = slot;
+        }
+    }
+    return next;
+}
+
+/*
+Append the frame to the recording, opening its file on the first frame
+*/
+void writeRecordedFrame(CaptureSlot *slot, FILE **video, unsigned long *videoId) {
+    if (!*video || *videoId != slot->recording) {
+        if (*video) fclose(*video);
+        *videoId = slot->recording;
+        *video = fopen(slot->recordPath, "wb");
+        if (!*video) {
+            perror("Error: cannot write recording");
+            return;
+        }
+    }
+    fwrite(slot->pixels, sizeof(uint32_t), (size_t)slot->width * slot->height, *video);
+}
+
+void *captureLoop(void *arg) {
+    traceThreadName("capture");
+    // encoding yields to the render loop on a busy machine
+    setpriority(PRIO_PROCESS, syscall(SYS_gettid), 10);
+
+    FILE *video = 0;
+    unsigned long videoId = 0;
+    pthread_mutex_lock(&captureLock);
+    while (1) {
+        CaptureSlot *slot = nextQueuedSlot();
+        if (!slot) {
+            if (video && (!recordingActive || recordingId != videoId)) {
+                pthread_mutex_unlock(&captureLock);
+                fclose(video);
+                video = 0;
+                pthread_mutex_lock(&captureLock);
+                continue;
+            }
+            if (!captureRunning) {
+                break;
+            }
+            pthread_cond_wait(&captureWake, &captureLock);
+            continue;
+        }
+        slot->state = SLOT_WRITING;
+        pthread_mutex_unlock(&captureLock);
+
+        traceBegin("writeCapture");
+        Surface frame = {.width = slot->width, .height = slot->height, .pitch = slot->width, .pixels = slot->pixels};
+        if (slot->recording) {
+            writeRecordedFrame(slot, &video, &videoId);
+        }
+        if (slot->shotFormat == CAPTURE_PNG) {
+            writeSurfacePNG(&frame, slot->shotPath);
+        } else if (slot->shotFormat == CAPTURE_PPM) {
+            writeSurfacePPM(&frame, slot->shotPath);
+        }
+        traceEnd("writeCapture");
+
+        pthread_mutex_lock(&captureLock);
+        slot->state = SLOT_FREE;
+    }
+    pthread_mutex_unlock(&captureLock);
+    return NULL;
+}
+
+int initCapture(void) {
+    pthread_mutex_lock(&captureLock);
+    captureRunning = 1;
+    if (pthread_create(&captureThread, NULL, captureLoop, NULL)) {
+        fprintf(stderr, "Error creating capture thread\n");
+        captureRunning = 0;
+        pthread_mutex_unlock(&captureLock);
+        return -1;
+    }
+    pthread_mutex_unlock(&captureLock);
+    return 0;
+}
+
+/*
+Write every frame already captured, then stop the writer. A screenshot
+still waiting for a frame is dropped.
+*/
+void terminateCapture(void) {
+    pthread_mutex_lock(&captureLock);
+    if (!captureRunning) {
+        pthread_mutex_unlock(&captureLock);
+        return;
+    }
+    captureRunning = 0;
+    shotPending = 0;
+    recordingActive = 0;
+    captureArmed = 0;
+    pthread_cond_signal(&captureWake);
+    pthread_mutex_unlock(&captureLock);
+    pthread_join(captureThread, NULL);
+
+    for (int i = 0; i < CAPTURE_SLOTS; i++) {
+        free(captureSlots[i].pixels);
+        captureSlots[i].pixels = 0;
+        captureSlots[i].capacity = 0;
+    }
+}
+
+/*
+Save the next presented frame to path as CAPTURE_PPM or CAPTURE_PNG.
+Replaces a screenshot that has not been taken yet.
+*/
+int captureScreenshot(const char *path, int format) {
+    if (strlen(path) >= CAPTURE_PATH_MAX) {
+        return -1;
+    }
+    pthread_mutex_lock(&captureLock);
+    if (!captureRunning) {
+        pthread_mutex_unlock(&captureLock);
+        return -1;
+    }
+    strcpy(shotPath, path);
+    shotFormat = format;
+    shotPending = 1;
+    captureArmed = 1;
+    pthread_mutex_unlock(&captureLock);
+    return 0;
+}
+
+/*
+Append every presented frame to path as raw 0xAARRGGBB pixels (BGRA
+bytes), for example for
+ffmpeg -f rawvideo -pixel_format bgra -video_size WxH -framerate 60 -i path
+Frames dropped because the writer fell behind are counted in
+droppedCaptures().
+*/
+int startRecording(const char *path) {
+    if (strlen(path) >= CAPTURE_PATH_MAX) {
+        return -1;
+    }
+    pthread_mutex_lock(&captureLock);
+    if (!captureRunning) {
+        pthread_mutex_unlock(&captureLock);
+        return -1;
+    }
+    strcpy(recordPath, path);
+    recordingId++;
+    recordingActive = 1;
+    captureArmed = 1;
+    pthread_mutex_unlock(&captureLock);
+    return 0;
+}
+
+/*
+Frames already captured are still written; the file is closed after them
+*/
+void stopRecording(void) {
+    pthread_mutex_lock(&captureLock);
+    recordingActive = 0;
+    captureArmed = shotPending;
+    pthread_cond_signal(&captureWake);
+    pthread_mutex_unlock(&captureLock);
+}
+
+int isRecording(void) {
+    return recordingActive;
+}
+
+unsigned long droppedCaptures(void) {
+    return captureDropped;
+}
+
+/*
+Claim a free slot and note what the frame is for: the recording, the
+pending screenshot, or both. Called with the lock held; returns 0 when
+every slot is busy.
+*/
+CaptureSlot* claimSlot(void) {
+    for (int i = 0; i < CAPTURE_SLOTS; i++) {
+        CaptureSlot *slot = &captureSlots[i];
+        if (slot->state != SLOT_FREE) {
+            continue;
+        }
+        slot->state = SLOT_FILLING;
+        slot->sequence = captureSequence++;
+        slot->shotFormat = -1;
+        slot->recording = 0;
+        if (recordingActive) {
+            slot->recording = recordingId;
+            strcpy(slot->recordPath, recordPath);
+        }
+        if (shotPending) {
+            slot->shotFormat = shotFormat;
+            strcpy(slot->shotPath, shotPath);
+            shotPending = 0;
+        }
+        return slot;
+    }
+    return 0;
+}
+
+/*
+Copy s into a pooled slot and queue it for the writer
+*/
+void captureSurface(const Surface *s) {
+    size_t n = (size_t)s->width * s->height;
+
+    pthread_mutex_lock(&captureLock);
+    CaptureSlot *slot = 0;
+    int dropped = 0;
+    if (captureRunning && (recordingActive || shotPending)) {
+        slot = claimSlot();
+        dropped = !slot;
+        captureDropped += dropped;
+    }
+    captureArmed = recordingActive || shotPending;
+    pthread_mutex_unlock(&captureLock);
+    if (dropped) {
+        traceInstant("droppedCapture");
+    }
+    if (!slot) {
+        return;
+    }
+
+    traceBegin("captureFrame");
+    if (slot->capacity < n) {
+        free(slot->pixels);
+        slot->pixels = malloc(n * sizeof(uint32_t));
+        slot->capacity = slot->pixels ? n : 0;
+    }
+    if (slot->pixels) {
+        slot->width = s->width;
+        slot->height = s->height;
+        if (s->pitch == s->width) {
+            memcpy(slot->pixels, s->pixels, n * sizeof(uint32_t));
+        } else {
+            for (int j = 0; j < s->height; j++) {
+                memcpy(slot->pixels + (size_t)j * s->width, surfaceRow(s, j), s->width * sizeof(uint32_t));
+            }
+        }
+    }
+    traceEnd("captureFrame");
+
+    pthread_mutex_lock(&captureLock);
+    if (slot->pixels) {
+        slot->state = SLOT_QUEUED;
+        pthread_cond_signal(&captureWake);
+    } else {
+        slot->state = SLOT_FREE;
+        captureDropped++;
+    }
+    pthread_mutex_unlock(&captureLock);
+}
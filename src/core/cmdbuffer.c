@@ -0,0 +1,330 @@
+#include "framebuffer.h"
+#include "cmdbuffer.h"
+#include "geometry.h"
+#include "filling.h"
+#include "tiles.h"
+#include "trace.h"
+#include "stats.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+/*
+Two command lists: the producer records into commandLists[recordingList]
+while the render thread executes the other one. Recording never touches
+pixels.
+*/
+CommandList commandLists[2];
+int recordingList = 0;
+int renderPending = 0;
+int renderBusy = 0;
+int renderRunning = 0;
+unsigned long droppedLists = 0;
+
+pthread_t renderThread;
+pthread_mutex_t renderLock = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t renderWake = PTHREAD_COND_INITIALIZER;
+
+/*
+Room for n more commands in l. Returns 0 when out of memory.
+*/
+int reserveCommands(CommandList *l, int n) {
+    if (l->count + n > l->capacity) {
+        int capacity = l->capacity ? l->capacity : 64;
+        while (capacity < l->count + n) capacity *= 2;
+        RenderCommand *grown = realloc(l->commands, capacity * sizeof(RenderCommand));
+        if (!grown) {
+            return 0;
+        }
+        l->commands = grown;
+        l->capacity = capacity;
+    }
+    return 1;
+}
+
+RenderCommand* newCommand(CommandList *l, int type) {
+    if (!reserveCommands(l, 1)) {
+        return 0;
+    }
+    RenderCommand *cmd = &l->commands[l->count++];
+    cmd->type = type;
+    cmd->width = 1;
+    cmd->flags = 0;
+    return cmd;
+}
+
+/*
+Room for n more vertices in l. Returns where they go (vertexCount is not
+advanced, so the caller can write them in place), or 0 when out of memory.
+*/
+Point* reserveVertices(CommandList *l, int n) {
+    if (l->vertexCount + n > l->vertexCapacity) {
+        int capacity = l->vertexCapacity ? l->vertexCapacity : 256;
+        while (capacity < l->vertexCount + n) capacity *= 2;
+        Point *grown = realloc(l->vertices, capacity * sizeof(Point));
+        if (!grown) {
+            return 0;
+        }
+        l->vertices = grown;
+        l->vertexCapacity = capacity;
+    }
+    return l->vertices + l->vertexCount;
+}
+
+int pushVertices(CommandList *l, int n, const Point *P) {
+    Point *dst = reserveVertices(l, n);
+    if (!dst) {
+        return -1;
+    }
+    for (int i = 0; i < n; i++) {
+        dst[i] = P[i];
+    }
+    l->vertexCount += n;
+    return dst - l->vertices;
+}
+
+void recordBackground(CommandList *l, Color C) {
+    RenderCommand *cmd = newCommand(l, CMD_BACKGROUND);
+    if (cmd) cmd->color = C;
+}
+
+void recordPolygon(CommandList *l, int n, const Point *P, Color C, int W) {
+    int offset = pushVertices(l, n, P);
+    if (offset < 0) return;
+    RenderCommand *cmd = newCommand(l, CMD_POLYGON);
+    if (!cmd) return;
+    cmd->color = C;
+    cmd->width = W;
+    cmd->polygon.vertexOffset = offset;
+    cmd->polygon.count = n;
+}
+
+/*
+Record every polygon of batch with one copy of its vertex buffer and one
+reservation, so a map of thousands of polygons costs no per-polygon
+allocation. batch->vertices may already point at reserveVertices(l, ...),
+then nothing is copied.
+*/
+void recordPolygonBatch(CommandList *l, const PolygonBatch *batch) {
+    int first = batch->offsets[0];
+    int total = batch->offsets[batch->count] - first;
+    Point *dst = reserveVertices(l, total);
+    if (!dst || !reserveCommands(l, batch->count)) {
+        return;
+    }
+    if (dst != batch->vertices + first) {
+        memcpy(dst, batch->vertices + first, total * sizeof(Point));
+    }
+    int base = l->vertexCount - first;
+    l->vertexCount += total;
+    for (int i = 0; i < batch->count; i++) {
+        const PolygonStyle *style = batchStyle(batch, i);
+        RenderCommand *cmd = &l->commands[l->count++];
+        cmd->type = CMD_POLYGON;
+        cmd->width = style->width;
+        cmd->flags = 0;
+        cmd->color = style->color;
+        cmd->polygon.vertexOffset = base + batch->offsets[i];
+        cmd->polygon.count = batch->offsets[i + 1] - batch->offsets[i];
+    }
+}
+
+void cmdBackground(Color C) {
+    recordBackground(&commandLists[recordingList], C);
+}
+
+void cmdLine(Point P1, Point P2, Color C, int W) {
+    RenderCommand *cmd = newCommand(&commandLists[recordingList], CMD_LINE);
+    if (!cmd) return;
+    cmd->color = C;
+    cmd->width = W;
+    cmd->line.p1 = P1;
+    cmd->line.p2 = P2;
+}
+
+void cmdPolygon(int n, Point *P, Color C, int W) {
+    recordPolygon(&commandLists[recordingList], n, P, C, W);
+}
+
+void cmdPolygonBatch(const PolygonBatch *batch) {
+    recordPolygonBatch(&commandLists[recordingList], batch);
+}
+
+/*
+Flood fill from (x, y); the color being replaced is read when the
+command executes
+*/
+void cmdFill(int x, int y, Color C) {
+    RenderCommand *cmd = newCommand(&commandLists[recordingList], CMD_FILL);
+    if (!cmd) return;
+    cmd->color = C;
+    cmd->fill.x = x;
+    cmd->fill.y = y;
+}
+
+void cmdRect(int x, int y, int w, int h, Color C) {
+    RenderCommand *cmd = newCommand(&commandLists[recordingList], CMD_RECT);
+    if (!cmd) return;
+    cmd->color = C;
+    cmd->rect.x = x;
+    cmd->rect.y = y;
+    cmd->rect.w = w;
+    cmd->rect.h = h;
+}
+
+/*
+src must stay alive until the list has been executed
+*/
+void cmdBlit(Surface *src, int x, int y, int flags) {
+    RenderCommand *cmd = newCommand(&commandLists[recordingList], CMD_BLIT);
+    if (!cmd) return;
+    cmd->flags = flags;
+    cmd->blit.surface = src;
+    cmd->blit.x = x;
+    cmd->blit.y = y;
+}
+
+/*
+Show back on the screen with presentScreen, after the commands before it
+have drawn into it
+*/
+void cmdPresent(Surface *back) {
+    RenderCommand *cmd = newCommand(&commandLists[recordingList], CMD_PRESENT);
+    if (!cmd) return;
+    cmd->present.surface = back;
+}
+
+void executeCommand(CommandList *l, RenderCommand *cmd) {
+    switch (cmd->type) {
+        case CMD_BACKGROUND:
+            printBackground(cmd->color);
+            break;
+        case CMD_LINE:
+            drawBresenhamLine(cmd->line.p1, cmd->line.p2, cmd->color, cmd->width);
+            break;
+        case CMD_POLYGON:
+            drawPolygon(cmd->polygon.count, l->vertices + cmd->polygon.vertexOffset, cmd->color, cmd->width);
+            break;
+        case CMD_FILL:
+            floodFill(cmd->fill.x, cmd->fill.y, cmd->color, getXY(cmd->fill.x, cmd->fill.y));
+            break;
+        case CMD_RECT:
+            drawRect(cmd->rect.x, cmd->rect.y, cmd->rect.w, cmd->rect.h, cmd->color);
+            break;
+        case CMD_BLIT:
+            blitSurface(cmd->blit.surface, cmd->blit.x, cmd->blit.y, cmd->flags);
+            break;
+        case CMD_PRESENT:
+            presentScreen(cmd->present.surface);
+            break;
+    }
+}
+
+/*
+Run every command of l in order, then empty it
+*/
+void executeCommands(CommandList *l) {
+    for (int i = 0; i < l->count; i++) {
+        executeCommand(l, &l->commands[i]);
+    }
+    resetCommandList(l);
+}
+
+void resetCommandList(CommandList *l) {
+    l->count = 0;
+    l->vertexCount = 0;
+}
+
+void freeCommandList(CommandList *l) {
+    free(l->commands);
+    free(l->vertices);
+    l->commands = 0;
+    l->vertices = 0;
+    l->count = l->capacity = 0;
+    l->vertexCount = l->vertexCapacity = 0;
+}
+
+void *renderLoop(void *arg) {
+    traceThreadName("render");
+    pthread_mutex_lock(&renderLock);
+    while (1) {
+        while (!renderPending && renderRunning) {
+            pthread_cond_wait(&renderWake, &renderLock);
+        }
+        if (!renderPending) {
+            break;
+        }
+        CommandList *l = &commandLists[!recordingList];
+        renderPending = 0;
+        renderBusy = 1;
+        pthread_mutex_unlock(&renderLock);
+
+        traceBegin("executeCommands");
+        executeCommandsTiled(l);
+        traceEnd("executeCommands");
+
+        pthread_mutex_lock(&renderLock);
+        renderBusy = 0;
+    }
+    pthread_mutex_unlock(&renderLock);
+    return NULL;
+}
+
+/*
+Hand the recorded list to the render thread and start recording into
+the other one. Never waits for rasterization: if the render thread is
+still busy with the previous list, the new one is discarded and 0 is
+returned so the caller can record the frame again later.
+*/
+int submitCommands(void) {
+    pthread_mutex_lock(&renderLock);
+    if (renderPending || renderBusy) {
+        pthread_mutex_unlock(&renderLock);
+        resetCommandList(&commandLists[recordingList]);
+        droppedLists++;
+        countStat(STAT_FRAMES_DROPPED, 1);
+        traceInstant("droppedCommandList");
+        return 0;
+    }
+    recordingList = !recordingList;
+    renderPending = 1;
+    pthread_cond_signal(&renderWake);
+    pthread_mutex_unlock(&renderLock);
+    return 1;
+}
+
+unsigned long droppedCommandLists(void) {
+    return droppedLists;
+}
+
+int initRenderThread(void) {
+    renderRunning = 1;
+    if (pthread_create(&renderThread, NULL, renderLoop, NULL)) {
+        fprintf(stderr, "Error creating render thread\n");
+        renderRunning = 0;
+        return -1;
+    }
+    return 0;
+}
+
+/*
+Finish the pending list, if any, and stop the render thread and the
+tile workers it used
+*/
+void terminateRenderThread(void) {
+    pthread_mutex_lock(&renderLock);
+    if (!renderRunning) {
+        pthread_mutex_unlock(&renderLock);
+        return;
+    }
+    renderRunning = 0;
+    pthread_cond_signal(&renderWake);
+    pthread_mutex_unlock(&renderLock);
+    pthread_join(renderThread, NULL);
+    terminateTileThreads();
+
+    for (int i = 0; i < 2; i++) {
+        freeCommandList(&commandLists[i]);
+    }
+}
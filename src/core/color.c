@@ -15,14 +15,11 @@ struct color_rgba setColor(int r, int g, int b) {
     return create_rgba_color(r, g, b);
 }
 
+/*
+RGB channels within COLOR_TOLERANCE of each other, alpha ignored
+*/
 int are_colors_similar(struct color_rgba first_color, struct color_rgba second_color) {
-    int offset = 1;
-    if ((abs(first_color.red_component - second_color.red_component) <= offset) && 
-        (abs(first_color.green_component - second_color.green_component) <= offset) && 
-        (abs(first_color.blue_component - second_color.blue_component) <= offset)) {
-        return 1;
-    }
-    return 0;
+    return pixelsSimilar(packColor(first_color), packColor(second_color), COLOR_TOLERANCE);
 }
 
 // Legacy function name compatibility
@@ -0,0 +1,93 @@
+#include "frame.h"
+#include "stats.h"
+#include <errno.h>
+
+#define NSEC_PER_SEC 1000000000L
+
+static long diffNs(struct timespec a, struct timespec b) {
+    return (a.tv_sec - b.tv_sec) * NSEC_PER_SEC + (a.tv_nsec - b.tv_nsec);
+}
+
+static void addNs(struct timespec *t, long ns) {
+    t->tv_sec += ns / NSEC_PER_SEC;
+    t->tv_nsec += ns % NSEC_PER_SEC;
+    if (t->tv_nsec >= NSEC_PER_SEC) {
+        t->tv_nsec -= NSEC_PER_SEC;
+        t->tv_sec++;
+    }
+}
+
+void initFrameScheduler(FrameScheduler *fs, int targetFps, int simulationHz) {
+    fs->stepNs = NSEC_PER_SEC / simulationHz;
+    fs->accumulator = 0;
+    fs->frames = 0;
+    fs->droppedFrames = 0;
+    setTargetFps(fs, targetFps);
+    clock_gettime(CLOCK_MONOTONIC, &fs->last);
+    fs->deadline = fs->last;
+    addNs(&fs->deadline, fs->frameNs);
+}
+
+void setTargetFps(FrameScheduler *fs, int targetFps) {
+    if (targetFps < 1) targetFps = 1;
+    fs->targetFps = targetFps;
+    fs->frameNs = NSEC_PER_SEC / targetFps;
+}
+
+/*
+Start a frame. Returns how many fixed simulation steps to run before
+rendering it.
+*/
+int frameBegin(FrameScheduler *fs) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    fs->accumulator += diffNs(now, fs->last);
+    fs->last = now;
+
+    int steps = fs->accumulator / fs->stepNs;
+    if (steps > MAX_STEPS_PER_FRAME) {
+        // too far behind (stall, debugger): drop the backlog instead of
+        // spiralling
+        steps = MAX_STEPS_PER_FRAME;
+        fs->accumulator = fs->stepNs * steps;
+    }
+    fs->accumulator -= fs->stepNs * steps;
+    return steps;
+}
+
+/*
+How far the render time is between the last two simulation steps (0..1),
+for interpolating positions
+*/
+float frameAlpha(FrameScheduler *fs) {
+    return (float)fs->accumulator / fs->stepNs;
+}
+
+/*
+Finish a frame: sleep until its absolute deadline. A frame late by up to
+FRAME_LATE_SLACK_NS (at most half a frame) keeps the schedule and the
+next one starts at once; later than that, the deadlines passed count as
+dropped frames and the schedule skips ahead to the next frame boundary.
+*/
+void frameEnd(FrameScheduler *fs) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    fs->frames++;
+
+    long late = diffNs(now, fs->deadline);
+    long slack = FRAME_LATE_SLACK_NS < fs->frameNs / 2 ? FRAME_LATE_SLACK_NS : fs->frameNs / 2;
+    if (late > 0 && late <= slack) {
+        addNs(&fs->deadline, fs->frameNs);
+        return;
+    }
+    if (late > 0) {
+        long missed = late / fs->frameNs + 1;
+        fs->droppedFrames += missed;
+        countStat(STAT_FRAMES_DROPPED, missed);
+        addNs(&fs->deadline, missed * fs->frameNs);
+    }
+
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &fs->deadline, 0) == EINTR) {
+    }
+    addNs(&fs->deadline, fs->frameNs);
+}
@@ -10,6 +10,12 @@
 
 // Include our unified headers
 #include "framebuffer.h"
+#include "profiler.h"
+#include "trace.h"
+#include "stats.h"
+#include "palette.h"
+#include "capture.h"
+#include <string.h>
 
 
 int fbfd = 0;
@@ -18,26 +24,15 @@ struct fb_fix_screeninfo finfo;
 long int screensize = 0;
 char *fbp = 0;
 int displayWidth, displayHeight;
+Surface screenSurface;
+Surface *renderTarget = 0;
+__thread TileTarget *tileTarget = 0;
 
 
-// global variable
-
-char available[3840][2160];
-
-void init_avail() {
-    for (int i = 0; i < 1000; ++i) {
-        for (int j = 0; j < 700; ++j) {
-            available[i][j] = 0;
-            // printf("%d\n", available[i][j]);
-        }
-    }
-}
-
 /*
 Initiate connection to framebuffer
 */
 void initScreen() {
-    init_avail();
     // Open the file for reading and writing
     fbfd = open("/dev/fb0", O_RDWR);
     if (fbfd == -1) {
@@ -59,6 +54,15 @@ void initScreen() {
 
     printf("%dx%d, %dbpp\n", vinfo.xres, vinfo.yres, vinfo.bits_per_pixel);
 
+    // 8bpp is pseudocolor: install our palette before drawing anything
+    if (vinfo.bits_per_pixel == 8) {
+        buildPalette(&screenPalette);
+        loadPalette(fbfd, &screenPalette);
+    }
+    if (getenv("PAINT_DITHER")) {
+        setDithering(atoi(getenv("PAINT_DITHER")));
+    }
+
     // Figure out the size of the screen in bytes
     if (vinfo.yres < 700) {
         screensize = vinfo.xres * finfo.line_length * vinfo.bits_per_pixel / 8;
@@ -76,6 +80,71 @@ void initScreen() {
     printf("The framebuffer device was mapped to memory successfully.\n");
     displayWidth = vinfo.xres;
     displayHeight = vinfo.yres;
+
+    screenSurface.width = vinfo.xres;
+    screenSurface.height = vinfo.yres;
+    screenSurface.pitch = finfo.line_length / 4;
+    screenSurface.pixels = (uint32_t *)(fbp + vinfo.yoffset * finfo.line_length) + vinfo.xoffset;
+}
+
+/*
+Redirect setXY, getXY and printBackground into an off-screen surface.
+Pass 0 to draw to the screen again.
+*/
+void setRenderTarget(Surface *target) {
+    renderTarget = target;
+}
+
+Surface* getRenderTarget(void) {
+    return renderTarget;
+}
+
+/*
+The mapped screen as a surface, or 0 when it is not 32bpp
+*/
+Surface* getScreenSurface(void) {
+    if (!fbp || vinfo.bits_per_pixel != 32) {
+        return 0;
+    }
+    return &screenSurface;
+}
+
+/*
+Redirect this thread's drawing into one tile, 0 to stop
+*/
+void setTileTarget(TileTarget *tile) {
+    tileTarget = tile;
+}
+
+/*
+The part of a squareSize square at (x, y) that lies in the tile
+*/
+static void setTileXY(TileTarget *t, int squareSize, int x, int y, Color C) {
+    int x0 = x - t->x, y0 = y - t->y;
+    int x1 = x0 + squareSize, y1 = y0 + squareSize;
+    if (x0 < 0) x0 = 0;
+    if (y0 < 0) y0 = 0;
+    if (x1 > t->surface->width) x1 = t->surface->width;
+    if (y1 > t->surface->height) y1 = t->surface->height;
+    if (x0 >= x1 || y0 >= y1) {
+        return;
+    }
+    uint32_t pixel = packColor(C);
+    t->pixels += (long)(x1 - x0) * (y1 - y0);
+    for (int j = y0; j < y1; j++) {
+        uint32_t *row = surfaceRow(t->surface, j);
+        for (int i = x0; i < x1; i++) {
+            row[i] = pixel;
+        }
+    }
+}
+
+int renderWidth(void) {
+    return renderTarget ? renderTarget->width : vinfo.xres;
+}
+
+int renderHeight(void) {
+    return renderTarget ? renderTarget->height : vinfo.yres;
 }
 
 /*Color struct consists of Red, Green, and Blue */
@@ -90,7 +159,27 @@ C       : Color struct (Red, Green, Blue)
 void setXY (int squareSize, int x, int y, struct color_rgba C) {
     long int location;
     int i,j;
+    if (tileTarget) {
+        if ((x>=0) && ((x + squareSize)<renderWidth()) && (y>=0) && ((y + squareSize)<renderHeight())) {
+            setTileXY(tileTarget, squareSize, x, y, C);
+        }
+        return;
+    }
+    if (renderTarget) {
+        if ((x>=0) && ((x + squareSize)<renderTarget->width) && (y>=0) && ((y + squareSize)<renderTarget->height)) {
+            uint32_t pixel = packColor(C);
+            countStat(STAT_PIXELS_WRITTEN, squareSize * squareSize);
+            for (j = y; j < (y+squareSize); j++) {
+                uint32_t *row = renderTarget->pixels + (long)j * renderTarget->pitch;
+                for (i = x; i < (x+squareSize); i++) {
+                    row[i] = pixel;
+                }
+            }
+        }
+        return;
+    }
     if (((x)>=0) && ((x + squareSize)<vinfo.xres) && ((y)>=0) && ((y + squareSize)<vinfo.yres)) {
+        countStat(STAT_PIXELS_WRITTEN, squareSize * squareSize);
         for (i = x; i < (x+squareSize); i++) {
             for (j = y; j < (y+squareSize); j++) {
                 location = (i+vinfo.xoffset) * (vinfo.bits_per_pixel/8) + (j+vinfo.yoffset) * finfo.line_length;
@@ -101,15 +190,11 @@ void setXY (int squareSize, int x, int y, struct color_rgba C) {
                         *(fbp + location + 1) = C.G;        //Green
                         *(fbp + location + 2) = C.R;        //Red
                         *(fbp + location + 3) = 0;          //Transparancy
+                    } else if (vinfo.bits_per_pixel == 8) {
+                        *(uint8_t*)(fbp + location) = paletteIndex(&screenPalette, C.R, C.G, C.B);
                     } else  { //assume 16bpp
-                        int r = C.R;     //Red
-                        int g = C.G;     //Green
-                        int b = C.B;     //Blue
-
-                        unsigned short int t = r<<11 | g << 5 | b;
-                        *((unsigned short int*)(fbp + location)) = t;
+                        *((unsigned short int*)(fbp + location)) = packRGB565(C.R, C.G, C.B);
                     }
-                    available[x][y] = 1;
                 } else {
                     return;
                 }
@@ -129,6 +214,33 @@ void printBackground(struct color_rgba C) {
     int height = displayHeight - 6;
     int i,j;
 
+    profileBegin(PROFILE_CLEAR);
+    traceBegin("printBackground");
+    if (tileTarget) {
+        // not clearSurface: tile workers leave the stats to their caller
+        Surface *tile = tileTarget->surface;
+        uint32_t pixel = packColor(C);
+        for (j = 0; j < tile->height; j++) {
+            uint32_t *row = surfaceRow(tile, j);
+            for (i = 0; i < tile->width; i++) {
+                row[i] = pixel;
+            }
+        }
+        tileTarget->pixels += (long)tile->width * tile->height;
+        traceEnd("printBackground");
+        profileEnd(PROFILE_CLEAR);
+        return;
+    }
+    if (renderTarget) {
+        clearSurface(renderTarget, packColor(C));
+        traceEnd("printBackground");
+        profileEnd(PROFILE_CLEAR);
+        return;
+    }
+
+    unsigned short int t = packRGB565(C.R, C.G, C.B);
+    uint8_t index = vinfo.bits_per_pixel == 8 ? paletteIndex(&screenPalette, C.R, C.G, C.B) : 0;
+    countStat(STAT_PIXELS_WRITTEN, (long)width * height);
     for (i = 0; i < width; i++) {
         for (j = 0; j < height; j++) {
             location = (i+vinfo.xoffset) * (vinfo.bits_per_pixel/8) + (j+vinfo.yoffset) * finfo.line_length;
@@ -137,27 +249,75 @@ void printBackground(struct color_rgba C) {
                 *(fbp + location + 1) = C.G;     //Green
                 *(fbp + location + 2) = C.R;     //Red
                 *(fbp + location + 3) = 0;       //No transparency
+            } else if (vinfo.bits_per_pixel == 8) {
+                *(uint8_t*)(fbp + location) = index;
             } else  { //assume 16bpp
-                int r = C.R;     //Red
-                int g = C.G;     //Green
-                int b = C.B;     //Blue
-
-                unsigned short int t = r<<11 | g << 5 | b;
                 *((unsigned short int*)(fbp + location)) = t;
             }
         }
     }
+    traceEnd("printBackground");
+    profileEnd(PROFILE_CLEAR);
+}
+
+/*
+Copy a back buffer to the framebuffer in one pass. Draw a whole frame
+into a screen-sized surface (setRenderTarget) and present it at the end,
+so the screen never shows a half-drawn frame.
+*/
+void presentScreen(const Surface *back) {
+    int width = back->width < (int)vinfo.xres ? back->width : (int)vinfo.xres;
+    int height = back->height < (int)vinfo.yres ? back->height : (int)vinfo.yres;
+    Surface *screen = getScreenSurface();
+
+    profileBegin(PROFILE_PRESENT);
+    traceBegin("presentScreen");
+    countStat(STAT_SPANS, height);
+    countStat(STAT_BYTES_PRESENTED, (long)width * height * (vinfo.bits_per_pixel / 8));
+    if (screen) {
+        for (int j = 0; j < height; j++) {
+            memcpy(screen->pixels + (long)j * screen->pitch,
+                   back->pixels + (long)j * back->pitch, width * sizeof(uint32_t));
+        }
+    } else if (fbp && vinfo.bits_per_pixel == 8) {
+        for (int j = 0; j < height; j++) {
+            uint8_t *dst = (uint8_t*)(fbp + (j+vinfo.yoffset) * finfo.line_length) + vinfo.xoffset;
+            convertRow8(dst, back->pixels + (long)j * back->pitch, width, j);
+        }
+    } else if (fbp) { //assume 16bpp
+        for (int j = 0; j < height; j++) {
+            unsigned short int *dst = (unsigned short int*)(fbp + (j+vinfo.yoffset) * finfo.line_length) + vinfo.xoffset;
+            convertRow16(dst, back->pixels + (long)j * back->pitch, width, j);
+        }
+    }
+    traceEnd("presentScreen");
+    profileEnd(PROFILE_PRESENT);
+    captureFrame(back);
 }
 
 
 
 /*
 Function untuk mendapatkan warna dari suatu pixel pada posisi x dan y
+Outside the drawable area the result is unpackColor(PIXEL_NONE).
 */
 struct color_rgba getXY(int x, int y) {
     long int location;
-    Color out;
-    out.R = -999; out.G = -999; out.B = -999;
+    Color out = unpackColor(PIXEL_NONE);
+    if (tileTarget) {
+        int i = x - tileTarget->x, j = y - tileTarget->y;
+        if (i >= 0 && i < tileTarget->surface->width && j >= 0 && j < tileTarget->surface->height) {
+            return unpackColor(surfaceRow(tileTarget->surface, j)[i]);
+        }
+        return out;
+    }
+    countStat(STAT_PIXELS_READ, 1);
+    if (renderTarget) {
+        if ((x>=0) && (x<renderTarget->width) && (y>=0) && (y<renderTarget->height)) {
+            out = unpackColor(renderTarget->pixels[(long)y * renderTarget->pitch + x]);
+        }
+        return out;
+    }
     if (((x)>=0) && (x<vinfo.xres) && ((y)>=0) && (y<vinfo.yres)) {
 
         location = (x+vinfo.xoffset) * (vinfo.bits_per_pixel/8) + (y+vinfo.yoffset) * finfo.line_length;
@@ -171,14 +331,13 @@ struct color_rgba getXY(int x, int y) {
                 if (out.R < 0) out.R += 256;
                 if (out.G < 0) out.G += 256;
                 if (out.B < 0) out.B += 256;
+                out.A = 255;
 
                 *(fbp + location + 3) = 0;          //Transparancy
+            } else if (vinfo.bits_per_pixel == 8) {
+                out = unpackColor(screenPalette.colors[*(uint8_t*)(fbp + location)]);
             } else  { //assume 16bpp
-                int t = *((unsigned short int*)(fbp + location));
-                out.R = (t & 63488) >> 11;     //Red
-                out.G = (t & 2016) >> 5;     //Green
-                out.B = t & 31;     //Blue
-
+                out = unpackRGB565(*((unsigned short int*)(fbp + location)));
             }
         }
     } else {
@@ -191,6 +350,7 @@ struct color_rgba getXY(int x, int y) {
 Closing the framebuffer connection
 */
 void terminate(){
+    writeTrace();
     munmap(fbp, screensize);
     close(fbfd);
 }
@@ -216,52 +376,3 @@ struct color_rgba get_pixel_color_at_position(int x_coordinate, int y_coordinate
 void terminate_framebuffer_system(void) {
     terminate();
 }
-
-// Additional function implementations
-int initialize_framebuffer_system(void) {
-    return initScreen();
-}
-
-void terminate_framebuffer_system(void) {
-    terminate();
-}
-
-struct color_rgba create_rgba_color(int red, int green, int blue) {
-    struct color_rgba color;
-    color.R = (uint8_t)red;
-    color.G = (uint8_t)green;
-    color.B = (uint8_t)blue;
-    color.A = 255;
-    return color;
-}
-
-int are_colors_similar(struct color_rgba first_color, struct color_rgba second_color) {
-    return (first_color.R == second_color.R && 
-            first_color.G == second_color.G && 
-            first_color.B == second_color.B);
-}
-
-// Additional missing function implementations
-struct coordinate_point create_coordinate_point(int x, int y) {
-    struct coordinate_point point;
-    point.x_coordinate = x;
-    point.y_coordinate = y;
-    return point;
-}
-
-void draw_filled_polygon(int vertex_count, struct coordinate_point *vertex_array, 
-                        struct color_rgba fill_color, int outline_thickness) {
-    // Simple polygon fill - just draw lines between vertices
-    for (int i = 0; i < vertex_count; i++) {
-        int next = (i + 1) % vertex_count;
-        draw_line_between_points(vertex_array[i], vertex_array[next], fill_color, outline_thickness);
-    }
-}
-
-void draw_connected_polyline(int point_count, struct coordinate_point* coordinate_array, 
-                           struct color_rgba line_color, int line_thickness) {
-    // Draw connected lines
-    for (int i = 0; i < point_count - 1; i++) {
-        draw_line_between_points(coordinate_array[i], coordinate_array[i+1], line_color, line_thickness);
-    }
-}
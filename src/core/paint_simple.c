@@ -7,15 +7,15 @@
 #include "../../include/graphics_engine.h"
 #include <stdio.h>
 #include <stdlib.h>
-#include <pthread.h>
-
-// Forward declarations for existing functions
-extern void initScreen(void);
-extern void terminate(void);
-extern Color setColor(int r, int g, int b);
-extern void printBackground(Color c);
-extern Point makePoint(int x, int y);
-extern int getch(void);
+#include "frame.h"
+#include "input.h"
+#include "cmdbuffer.h"
+#include "trace.h"
+#include "stats.h"
+#include "capture.h"
+#include "graphics.h"
+#include "color.h"
+#include "point.h"
 
 // Global variables
 typedef struct {
@@ -34,12 +34,15 @@ unsigned char fill = 0;
 unsigned char drawT = 0;
 unsigned char drawR = 0;
 
-pthread_t keypressListener;
 int polyCount = 0;
 Point* points;
 Polygon polygonsP[10];
 Color colors[4];
 int currentColor = 0;
+int running = 1;
+Surface *backBuffer;
+int screenshotCount = 0;
+int recordingCount = 0;
 Point pointsColor[10];
 Color pointsColorChoice[10];
 
@@ -47,8 +50,12 @@ Color pointsColorChoice[10];
 int planeloc = 0;
 int endSign = 0;
 
-void refreshScreen(void) {
-    printBackground(setColor(0, 0, 0));
+/*
+Record the scene for the render thread. Returns 0 when the render thread
+was still busy and the frame has to be recorded again.
+*/
+int refreshScreen(void) {
+    cmdBackground(setColor(0, 0, 0));
     
     // Simple rendering - just draw some basic shapes
     Point window[4];
@@ -69,34 +76,62 @@ void refreshScreen(void) {
     rectIndicator[1] = makePoint(180, 110);
     rectIndicator[2] = makePoint(230, 110);
     rectIndicator[3] = makePoint(230, 60);
+
+    cmdPolygon(4, window, colors[0], 1);
+    cmdPolygon(4, triangleIndicator, colors[0], 1);
+    cmdPolygon(4, rectIndicator, colors[0], 1);
+    if (backBuffer) {
+        cmdPresent(backBuffer);
+    }
+    return submitCommands();
 }
 
-void *keypressListen(void *x_void_ptr) {
-    int cmd = ' ';
-    while (1) {
-        cmd = getch();
-        if (cmd == 68) { left -= 20; refreshScreen(); }      // Left arrow
-        else if (cmd == 67) { left += 20; refreshScreen(); }  // Right arrow  
-        else if (cmd == 66) { up += 20; refreshScreen(); }    // Up arrow
-        else if (cmd == 65) { up -= 20; refreshScreen(); }    // Down arrow
-        else if (cmd == 61) { scaleFactor -= 0.1; refreshScreen(); } // +
-        else if (cmd == 45) { scaleFactor += 0.1; refreshScreen(); } // -
-        else if (cmd == 122) { fill = !fill; refreshScreen(); }      // z
-        else if (cmd == 120) { drawT = !drawT; refreshScreen(); }    // x  
-        else if (cmd == 99) { drawR = !drawR; refreshScreen(); }     // c
-        else if (cmd == 44) {  // < key
-            currentColor = (currentColor == 0) ? 3 : currentColor - 1;
-            refreshScreen();
-        }
-        else if (cmd == 46) {  // > key
-            currentColor = (currentColor == 3) ? 0 : currentColor + 1;
-            refreshScreen();
+/*
+Apply one key press. Returns 1 when the screen needs to be redrawn.
+*/
+int handleKey(int cmd) {
+    if (cmd == 68) { left -= 20; return 1; }      // Left arrow
+    else if (cmd == 67) { left += 20; return 1; }  // Right arrow  
+    else if (cmd == 66) { up += 20; return 1; }    // Up arrow
+    else if (cmd == 65) { up -= 20; return 1; }    // Down arrow
+    else if (cmd == 61) { scaleFactor -= 0.1; return 1; } // +
+    else if (cmd == 45) { scaleFactor += 0.1; return 1; } // -
+    else if (cmd == 122) { fill = !fill; return 1; }      // z
+    else if (cmd == 120) { drawT = !drawT; return 1; }    // x  
+    else if (cmd == 99) { drawR = !drawR; return 1; }     // c
+    else if (cmd == 44) {  // < key
+        currentColor = (currentColor == 0) ? 3 : currentColor - 1;
+        return 1;
+    }
+    else if (cmd == 46) {  // > key
+        currentColor = (currentColor == 3) ? 0 : currentColor + 1;
+        return 1;
+    }
+    else if (cmd == 113) {  // q key - quit
+        running = 0;
+    }
+    else if (cmd == SAVE_DRAWING_KEY) {  // s key - screenshot of the next frame
+        char path[64];
+        snprintf(path, sizeof(path), "paint-%03d.png", screenshotCount++);
+        if (captureScreenshot(path, CAPTURE_PNG) == 0) {
+            printf("Saving %s\n", path);
         }
-        else if (cmd == 115) {  // s key - save
-            printf("Save functionality placeholder\n");
+        return 1;
+    }
+    else if (cmd == RECORD_VIDEO_KEY) {  // v key - start/stop recording
+        if (isRecording()) {
+            stopRecording();
+            printf("Recording stopped, %lu frames dropped\n", droppedCaptures());
+        } else {
+            char path[64];
+            snprintf(path, sizeof(path), "paint-%03d.raw", recordingCount++);
+            if (startRecording(path) == 0) {
+                printf("Recording %dx%d BGRA frames to %s\n", displayWidth, displayHeight, path);
+            }
         }
+        return 1;
     }
-    return NULL;
+    return 0;
 }
 
 void initColors(void) {
@@ -106,8 +141,28 @@ void initColors(void) {
     colors[3] = setColor(0, 0, 255);     // Blue
 }
 
-void programBarrier(void) {
-    while(1) {}
+/*
+Main loop: drain input events and redraw when something changed, paced
+by the frame scheduler instead of spinning
+*/
+void eventLoop(void) {
+    FrameScheduler frameScheduler;
+    initFrameScheduler(&frameScheduler, DEFAULT_TARGET_FPS, SIMULATION_HZ);
+    int dirty = 1;
+    while (running) {
+        InputEvent ev;
+        frameBegin(&frameScheduler);
+        traceBegin("frame");
+        while (pollInputEvent(&ev)) {
+            dirty |= handleKey(ev.key);
+        }
+        // a recording gets every frame, not only the changed ones
+        if (dirty || isRecording()) {
+            dirty = !refreshScreen();
+        }
+        traceEnd("frame");
+        frameEnd(&frameScheduler);
+    }
 }
 
 int main(void) {
@@ -117,14 +172,39 @@ int main(void) {
         return 1;
     }
     
+    initTracing(getenv("PAINT_TRACE"));
+    traceThreadName("main");
+    installStatsSignalHandler();
     initScreen();
     initColors();
-    printBackground(setColor(0, 0, 0));
-    refreshScreen();
+    // the render thread draws off-screen and presents each frame whole, so
+    // captures copy the back buffer instead of reading the screen back
+    backBuffer = createSurface(displayWidth, displayHeight);
+    if (backBuffer) {
+        setRenderTarget(backBuffer);
+    }
+    initCapture();
+    if (initRenderThread()) {
+        terminateCapture();
+        terminate();
+        free(points);
+        return 1;
+    }
     
-    pthread_create(&keypressListener, NULL, keypressListen, NULL);
-    programBarrier();
+    if (initInput()) {
+        terminateRenderThread();
+        terminateCapture();
+        terminate();
+        free(points);
+        return 1;
+    }
+    eventLoop();
     
+    terminateInput();
+    terminateRenderThread();
+    terminateCapture();
+    setRenderTarget(0);
+    destroySurface(backBuffer);
     terminate();
     free(points);
     return 0;
@@ -0,0 +1,139 @@
+#include <stdio.h>
+#include <sys/ioctl.h>
+#include <linux/fb.h>
+#include "palette.h"
+#include "surface.h"
+#include "blit.h"
+
+#define CUBE_LEVELS 6
+#define CUBE_STEP 51
+#define CUBE_SIZE (CUBE_LEVELS * CUBE_LEVELS * CUBE_LEVELS)
+#define GRAY_STEPS (PALETTE_SIZE - CUBE_SIZE)
+
+Palette screenPalette;
+int ditherEnabled = 1;
+
+/*
+4x4 Bayer matrix scaled to each quantization step. RGB565 truncates, so
+its offsets run from 0 to step-1; the color cube rounds to the nearest
+level, so its offsets are centered on zero.
+*/
+const int8_t ditherOffset565[2][16] = {
+    {0, 4, 1, 5, 6, 2, 7, 3, 1, 5, 0, 4, 7, 3, 6, 2},
+    {0, 2, 0, 2, 3, 1, 3, 1, 0, 2, 0, 2, 3, 1, 3, 1},
+};
+
+const int8_t ditherOffsetCube[16] = {
+    -24, 2, -18, 8, 14, -11, 21, -5, -14, 11, -21, 5, 24, -2, 18, -8,
+};
+
+static void setEntry(Palette *pal, int i, int r, int g, int b) {
+    pal->red[i] = r << 8 | r;
+    pal->green[i] = g << 8 | g;
+    pal->blue[i] = b << 8 | b;
+    pal->colors[i] = packColor(make_color(r, g, b, 255));
+}
+
+static int distance2(uint32_t pixel, int r, int g, int b) {
+    int dr = (int)(pixel >> 16 & 255) - r;
+    int dg = (int)(pixel >> 8 & 255) - g;
+    int db = (int)(pixel & 255) - b;
+    return dr * dr + dg * dg + db * db;
+}
+
+/*
+Fill pal with the 6x6x6 cube and a gray ramp between its levels, then
+build the lookup table. The nearest cube entry is found per channel and
+the nearest gray from the channel mean, so every cell compares just four
+candidates.
+*/
+void buildPalette(Palette *pal) {
+    for (int r = 0; r < CUBE_LEVELS; r++) {
+        for (int g = 0; g < CUBE_LEVELS; g++) {
+            for (int b = 0; b < CUBE_LEVELS; b++) {
+                setEntry(pal, (r * CUBE_LEVELS + g) * CUBE_LEVELS + b,
+                         r * CUBE_STEP, g * CUBE_STEP, b * CUBE_STEP);
+            }
+        }
+    }
+    for (int i = 0; i < GRAY_STEPS; i++) {
+        int v = (i + 1) * 255 / (GRAY_STEPS + 1);
+        setEntry(pal, CUBE_SIZE + i, v, v, v);
+    }
+
+    for (int i = 0; i < PALETTE_LUT_SIZE * PALETTE_LUT_SIZE * PALETTE_LUT_SIZE; i++) {
+        // cell value expanded to 8 bits, so 0 and 31 map to exactly 0 and 255
+        int r = (i >> 10) << 3 | (i >> 10) >> 2;
+        int g = (i >> 5 & 31) << 3 | (i >> 5 & 31) >> 2;
+        int b = (i & 31) << 3 | (i & 31) >> 2;
+        int cube = (((r + CUBE_STEP / 2) / CUBE_STEP) * CUBE_LEVELS + (g + CUBE_STEP / 2) / CUBE_STEP) * CUBE_LEVELS
+                   + (b + CUBE_STEP / 2) / CUBE_STEP;
+        int best = cube;
+        int bestDistance = distance2(pal->colors[cube], r, g, b);
+        // ramp values are truncated, so the neighbours of the estimate compete too
+        int gray = (r + g + b) * (GRAY_STEPS + 1) / (3 * 255) - 1;
+        for (int k = gray - 1; k <= gray + 1; k++) {
+            if (k < 0 || k >= GRAY_STEPS) continue;
+            int d = distance2(pal->colors[CUBE_SIZE + k], r, g, b);
+            if (d < bestDistance) {
+                best = CUBE_SIZE + k;
+                bestDistance = d;
+            }
+        }
+        pal->lut[i] = best;
+    }
+}
+
+/*
+Load pal into the hardware color map of framebuffer fd.
+Returns 0 on success, -1 when the driver refuses it.
+*/
+int loadPalette(int fd, const Palette *pal) {
+    struct fb_cmap cmap;
+    cmap.start = 0;
+    cmap.len = PALETTE_SIZE;
+    cmap.red = (uint16_t *)pal->red;
+    cmap.green = (uint16_t *)pal->green;
+    cmap.blue = (uint16_t *)pal->blue;
+    cmap.transp = 0;
+    if (ioctl(fd, FBIOPUTCMAP, &cmap) == -1) {
+        perror("Error: cannot set framebuffer color map");
+        return -1;
+    }
+    return 0;
+}
+
+/*
+Ordered dithering for presentScreen on 16bpp and 8bpp screens (default
+on). setXY and printBackground never dither, so a flat area drawn
+straight to the screen reads back as one color and floodFill still works.
+*/
+void setDithering(int on) {
+    ditherEnabled = on;
+}
+
+/*
+Convert one row of 0xAARRGGBB pixels starting at screen column 0 of row y
+*/
+void convertRow16(uint16_t *dst, const uint32_t *src, int n, int y) {
+    if (!ditherEnabled) {
+        packRow565(dst, src, n);
+        return;
+    }
+    for (int i = 0; i < n; i++) {
+        dst[i] = ditherRGB565(src[i], i, y);
+    }
+}
+
+void convertRow8(uint8_t *dst, const uint32_t *src, int n, int y) {
+    if (!ditherEnabled) {
+        for (int i = 0; i < n; i++) {
+            uint32_t p = src[i];
+            dst[i] = paletteIndex(&screenPalette, p >> 16 & 255, p >> 8 & 255, p & 255);
+        }
+        return;
+    }
+    for (int i = 0; i < n; i++) {
+        dst[i] = ditherIndex(&screenPalette, src[i], i, y);
+    }
+}
@@ -0,0 +1,146 @@
+#include "profiler.h"
+#include "geometry.h"
+#include "text.h"
+#include <stdio.h>
+#include <string.h>
+
+// overlay scale: one frame sample is a BAR_WIDTH wide stacked bar
+#define BAR_WIDTH 2
+#define PX_PER_MS 6
+#define OVERLAY_MS 33
+// legend to the right of the graph: one line per section
+#define LEGEND_WIDTH 144
+#define LEGEND_LINE 10
+
+volatile int profilerEnabled = 0;
+__thread int profileDepth[PROFILE_SECTIONS];
+__thread long profileStart[PROFILE_SECTIONS];
+long profileCurrent[PROFILE_SECTIONS];
+
+ProfileSample profileSamples[PROFILE_HISTORY];
+unsigned long profileFrames = 0;
+long profileLastFrame = 0;
+
+const char *profileSectionNames[PROFILE_SECTIONS] = {
+    "clear", "geometry", "fill", "clip", "transform", "blit", "physics", "present"
+};
+
+const unsigned char profileSectionColors[PROFILE_SECTIONS][3] = {
+    {120, 120, 120}, {66, 134, 244}, {244, 180, 0}, {160, 80, 220},
+    {0, 200, 200}, {80, 220, 80}, {240, 110, 40}, {230, 40, 60}
+};
+
+void setProfilerEnabled(int enabled) {
+    if (enabled && !profilerEnabled) {
+        memset(profileCurrent, 0, sizeof(profileCurrent));
+        profileLastFrame = profileNow();
+    }
+    profilerEnabled = enabled;
+}
+
+/*
+Close the current frame: move the section totals into the history ring.
+Call once per rendered frame, after presenting.
+*/
+void profileFrame(void) {
+    if (!profilerEnabled) return;
+
+    long now = profileNow();
+    ProfileSample *sample = &profileSamples[profileFrames % PROFILE_HISTORY];
+    sample->frame = profileFrames++;
+    sample->frameNs = now - profileLastFrame;
+    profileLastFrame = now;
+    for (int s = 0; s < PROFILE_SECTIONS; s++) {
+        sample->sectionNs[s] = __atomic_exchange_n(&profileCurrent[s], 0, __ATOMIC_RELAXED);
+    }
+}
+
+/*
+The sample recorded age frames ago (0 = latest), or 0 if there is none
+*/
+const ProfileSample* getProfileSample(int age) {
+    if (age < 0 || age >= PROFILE_HISTORY || (unsigned long)age >= profileFrames) {
+        return 0;
+    }
+    return &profileSamples[(profileFrames - 1 - age) % PROFILE_HISTORY];
+}
+
+/*
+Stacked bar per frame, newest on the right, with a line at the 60 FPS
+budget and a legend giving each section's time in the latest frame.
+x, y is the top left of the graph.
+*/
+void drawProfilerOverlay(int x, int y) {
+    int height = OVERLAY_MS * PX_PER_MS;
+    int width = PROFILE_HISTORY * BAR_WIDTH;
+    Color budget = setColor(255, 255, 255);
+
+    // the overlay itself must not show up as geometry time
+    int enabled = profilerEnabled;
+    profilerEnabled = 0;
+
+    drawRect(x, y, width, height, setColor(0, 0, 0));
+    for (int age = 0; age < PROFILE_HISTORY; age++) {
+        const ProfileSample *sample = getProfileSample(age);
+        if (!sample) break;
+
+        int barX = x + width - (age + 1) * BAR_WIDTH;
+        int barY = y + height;
+        for (int s = 0; s < PROFILE_SECTIONS && barY > y; s++) {
+            int h = sample->sectionNs[s] * PX_PER_MS / 1000000;
+            if (h > barY - y) h = barY - y;
+            barY -= h;
+            drawRect(barX, barY, BAR_WIDTH, h,
+                     setColor(profileSectionColors[s][0], profileSectionColors[s][1], profileSectionColors[s][2]));
+        }
+    }
+    drawRect(x, y + height - 1000 * PX_PER_MS / 60, width, 1, budget);
+    drawText(builtinFont(), x + 2, y + height - 1000 * PX_PER_MS / 60 - 9, "16.7 ms", budget);
+
+    const ProfileSample *latest = getProfileSample(0);
+    int legendX = x + width;
+    char line[32];
+    drawRect(legendX, y, LEGEND_WIDTH, height, setColor(0, 0, 0));
+    for (int s = 0; s < PROFILE_SECTIONS; s++) {
+        int lineY = y + 4 + s * LEGEND_LINE;
+        drawRect(legendX + 4, lineY, 8, 8,
+                 setColor(profileSectionColors[s][0], profileSectionColors[s][1], profileSectionColors[s][2]));
+        snprintf(line, sizeof(line), "%-10s%5.2f", profileSectionNames[s],
+                 latest ? latest->sectionNs[s] / 1e6 : 0.0);
+        drawText(builtinFont(), legendX + 16, lineY, line, budget);
+    }
+    if (latest) {
+        snprintf(line, sizeof(line), "frame     %5.2f", latest->frameNs / 1e6);
+        drawText(builtinFont(), legendX + 16, y + 4 + PROFILE_SECTIONS * LEGEND_LINE + 4, line, budget);
+    }
+
+    profilerEnabled = enabled;
+}
+
+/*
+Write the history, oldest frame first, times in milliseconds
+*/
+int dumpProfileCSV(const char *path) {
+    FILE *f = fopen(path, "w");
+    if (!f) {
+        perror("Error: cannot write profile");
+        return -1;
+    }
+
+    fprintf(f, "frame,frame_ms");
+    for (int s = 0; s < PROFILE_SECTIONS; s++) {
+        fprintf(f, ",%s_ms", profileSectionNames[s]);
+    }
+    fprintf(f, "\n");
+
+    for (int age = PROFILE_HISTORY - 1; age >= 0; age--) {
+        const ProfileSample *sample = getProfileSample(age);
+        if (!sample) continue;
+        fprintf(f, "%lu,%.3f", sample->frame, sample->frameNs / 1e6);
+        for (int s = 0; s < PROFILE_SECTIONS; s++) {
+            fprintf(f, ",%.3f", sample->sectionNs[s] / 1e6);
+        }
+        fprintf(f, "\n");
+    }
+    return fclose(f);
+}
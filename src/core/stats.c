@@ -0,0 +1,101 @@
+#include "stats.h"
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <errno.h>
+
+__thread StatsBlock *threadStats = 0;
+// every thread's block, pushed with compare-and-swap and never freed so
+// totals survive thread exit
+StatsBlock *statsBlocks = 0;
+
+const char *engineStatNames[ENGINE_STATS] = {
+    "pixels_written", "pixels_read", "spans", "fills",
+    "queue_allocs", "bytes_presented", "frames_dropped"
+};
+
+StatsBlock* registerThreadStats(void) {
+    StatsBlock *b = calloc(1, sizeof(StatsBlock));
+    if (!b) {
+        return 0;
+    }
+    b->next = __atomic_load_n(&statsBlocks, __ATOMIC_RELAXED);
+    while (!__atomic_compare_exchange_n(&statsBlocks, &b->next, b, 1,
+                                        __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+    }
+    threadStats = b;
+    return b;
+}
+
+/*
+Sum of every thread's counters. Lock-free, so it may be called from a
+signal handler.
+*/
+EngineStats getEngineStats(void) {
+    EngineStats total;
+    memset(&total, 0, sizeof(total));
+    for (StatsBlock *b = __atomic_load_n(&statsBlocks, __ATOMIC_ACQUIRE); b; b = b->next) {
+        for (int s = 0; s < ENGINE_STATS; s++) {
+            total.counters[s] += __atomic_load_n(&b->counters[s], __ATOMIC_RELAXED);
+        }
+    }
+    return total;
+}
+
+const char* engineStatName(EngineStat s) {
+    return s >= 0 && s < ENGINE_STATS ? engineStatNames[s] : "unknown";
+}
+
+/*
+Append the decimal digits of v; no stdio so it is async-signal-safe
+*/
+int formatUnsigned(char *out, unsigned long v) {
+    char digits[24];
+    int n = 0, len = 0;
+    do {
+        digits[n++] = '0' + v % 10;
+        v /= 10;
+    } while (v);
+    while (n) out[len++] = digits[--n];
+    return len;
+}
+
+/*
+Write "name value" lines to fd using only write(2)
+*/
+void dumpEngineStats(int fd) {
+    EngineStats stats = getEngineStats();
+    char line[64];
+    for (int s = 0; s < ENGINE_STATS; s++) {
+        int len = strlen(engineStatNames[s]);
+        memcpy(line, engineStatNames[s], len);
+        line[len++] = ' ';
+        len += formatUnsigned(line + len, stats.counters[s]);
+        line[len++] = '\n';
+        if (write(fd, line, len) < 0) return;
+    }
+}
+
+void statsSignalHandler(int sig) {
+    int saved = errno;
+    dumpEngineStats(STDERR_FILENO);
+    errno = saved;
+}
+
+/*
+Dump the counters to stderr on SIGUSR1 (kill -USR1 <pid>)
+*/
+int installStatsSignalHandler(void) {
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = statsSignalHandler;
+    sa.sa_flags = SA_RESTART;
+    sigemptyset(&sa.sa_mask);
+    return sigaction(SIGUSR1, &sa, 0);
+}
+
+// Bridge function for new interface compatibility
+EngineStats get_engine_stats(void) {
+    return getEngineStats();
+}
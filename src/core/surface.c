@@ -0,0 +1,230 @@
+#include "framebuffer.h"
+#include "surface.h"
+#include "blit.h"
+#include "profiler.h"
+#include "trace.h"
+#include "stats.h"
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+/*
+Allocate an off-screen surface without touching its pixels, for callers
+that write every one of them
+*/
+Surface* allocSurface(int width, int height) {
+    Surface *s = malloc(sizeof(Surface));
+    if (!s) {
+        return 0;
+    }
+    s->width = width;
+    s->height = height;
+    s->pitch = width;
+    s->mapping = 0;
+    s->mappingSize = 0;
+    s->pixels = malloc((size_t)width * height * sizeof(uint32_t));
+    if (!s->pixels) {
+        free(s);
+        return 0;
+    }
+    return s;
+}
+
+/*
+Allocate an off-screen surface, cleared to SURFACE_COLORKEY
+*/
+Surface* createSurface(int width, int height) {
+    Surface *s = allocSurface(width, height);
+    if (s) {
+        clearSurface(s, SURFACE_COLORKEY);
+    }
+    return s;
+}
+
+void destroySurface(Surface *s) {
+    if (s) {
+        if (s->mapping) {
+            munmap(s->mapping, s->mappingSize);
+        } else {
+            free(s->pixels);
+        }
+        free(s);
+    }
+}
+
+void clearSurface(Surface *s, uint32_t pixel) {
+    int i, j;
+    countStat(STAT_PIXELS_WRITTEN, (long)s->width * s->height);
+    countStat(STAT_SPANS, s->height);
+    for (j = 0; j < s->height; j++) {
+        uint32_t *row = s->pixels + (long)j * s->pitch;
+        for (i = 0; i < s->width; i++) {
+            row[i] = pixel;
+        }
+    }
+}
+
+uint32_t packColor(Color C) {
+    return 0xFF000000u | ((uint32_t)C.R << 16) | ((uint32_t)C.G << 8) | C.B;
+}
+
+Color unpackColor(uint32_t pixel) {
+    Color C;
+    C.R = (pixel >> 16) & 0xFF;
+    C.G = (pixel >> 8) & 0xFF;
+    C.B = pixel & 0xFF;
+    C.A = pixel >> 24;
+    return C;
+}
+
+typedef uint8_t v16qu __attribute__((vector_size(16)));
+typedef int v4si __attribute__((vector_size(16)));
+
+// pixels compared per block
+#define MATCH_BLOCK 16
+
+/*
+Lane mask of the four pixels at px whose channels are all within tol of
+ref (tol holds 255 in the alpha bytes, so alpha never decides)
+*/
+static inline v4si matchLanes(const uint32_t *px, v16qu ref, v16qu tol) {
+    v16qu p;
+    memcpy(&p, px, sizeof(p));
+    v16qu above = (v16qu)(p > ref);
+    v16qu diff = (above & (p - ref)) | (~above & (ref - p));
+    return (v4si)(diff <= tol) == -1;
+}
+
+static inline v4si equalLanes(const uint32_t *px, v4si ref) {
+    v4si p;
+    memcpy(&p, px, sizeof(p));
+    return ((p ^ ref) & PIXEL_RGB_MASK) == 0;
+}
+
+static inline int allLanes(v4si m) {
+    uint64_t q[2];
+    memcpy(q, &m, sizeof(q));
+    return (q[0] & q[1]) == ~(uint64_t)0;
+}
+
+/*
+Length of the leading run of row[0..n) whose pixelsSimilar(row[i], ref,
+tolerance) equals want. Checks MATCH_BLOCK pixels per step and finishes
+the first block that breaks the run one pixel at a time.
+*/
+int matchRun(const uint32_t *row, int n, uint32_t ref, int tolerance, int want) {
+    v4si flip = (v4si){0} + (want ? 0 : -1);
+    int i = 0;
+
+    if (tolerance == 0) {
+        v4si r = (v4si){0} + (int)ref;
+        for (; i + MATCH_BLOCK <= n; i += MATCH_BLOCK) {
+            v4si m0 = equalLanes(row + i, r) ^ flip;
+            v4si m1 = equalLanes(row + i + 4, r) ^ flip;
+            v4si m2 = equalLanes(row + i + 8, r) ^ flip;
+            v4si m3 = equalLanes(row + i + 12, r) ^ flip;
+            if (!allLanes(m0 & m1 & m2 & m3)) break;
+        }
+    } else {
+        uint8_t t = tolerance > 255 ? 255 : tolerance;
+        uint32_t lane = 0xFF000000u | t << 16 | t << 8 | t;
+        v16qu r, tol;
+        v4si refLanes = (v4si){0} + (int)ref, tolLanes = (v4si){0} + (int)lane;
+        memcpy(&r, &refLanes, sizeof(r));
+        memcpy(&tol, &tolLanes, sizeof(tol));
+        for (; i + MATCH_BLOCK <= n; i += MATCH_BLOCK) {
+            v4si m0 = matchLanes(row + i, r, tol) ^ flip;
+            v4si m1 = matchLanes(row + i + 4, r, tol) ^ flip;
+            v4si m2 = matchLanes(row + i + 8, r, tol) ^ flip;
+            v4si m3 = matchLanes(row + i + 12, r, tol) ^ flip;
+            if (!allLanes(m0 & m1 & m2 & m3)) break;
+        }
+    }
+    while (i < n && pixelsSimilar(row[i], ref, tolerance) == want) {
+        i++;
+    }
+    return i;
+}
+
+/*
+Copy src onto the current render target with its top-left corner at (x, y)
+
+flags : BLIT_COLORKEY skips SURFACE_COLORKEY pixels,
+        BLIT_ALPHA blends by the source alpha,
+        BLIT_FLIP_X mirrors src horizontally
+*/
+void blitSurface(Surface *src, int x, int y, int flags) {
+    blitSurfaceRect(src, 0, 0, src->width, src->height, x, y, flags);
+}
+
+/*
+Copy the w x h rectangle of src at (sx, sy) onto the current render
+target at (x, y). BLIT_FLIP_X mirrors within the rectangle. Parts of the
+rectangle outside src are not drawn.
+*/
+void blitSurfaceRect(Surface *src, int sx, int sy, int w, int h, int x, int y, int flags) {
+    Surface *dst = getRenderTarget();
+    uint32_t flipped[BLIT_CHUNK];
+    int i, j;
+    if (!dst) {
+        dst = getScreenSurface();
+    }
+
+    // clip against the source; mirrored columns move to the other side
+    if (sx < 0) {
+        w += sx;
+        if (!(flags & BLIT_FLIP_X)) x -= sx;
+        sx = 0;
+    }
+    if (sx + w > src->width) {
+        if (flags & BLIT_FLIP_X) x += sx + w - src->width;
+        w = src->width - sx;
+    }
+    if (sy < 0) {
+        h += sy;
+        y -= sy;
+        sy = 0;
+    }
+    if (sy + h > src->height) h = src->height - sy;
+    if (w <= 0 || h <= 0) return;
+
+    // clip against the destination
+    int x0 = 0, y0 = 0, x1 = w, y1 = h;
+    if (dst) {
+        if (x < 0) x0 = -x;
+        if (y < 0) y0 = -y;
+        if (x + x1 > dst->width) x1 = dst->width - x;
+        if (y + y1 > dst->height) y1 = dst->height - y;
+        if (x1 <= x0 || y1 <= y0) return;
+        countStat(STAT_PIXELS_WRITTEN, (long)(x1 - x0) * (y1 - y0));
+        countStat(STAT_SPANS, y1 - y0);
+    }
+
+    profileBegin(PROFILE_BLIT);
+    traceBegin("blit");
+    for (j = y0; j < y1; j++) {
+        const uint32_t *s = surfaceRow(src, sy + j) + sx;
+        if (!(flags & BLIT_FLIP_X)) {
+            if (dst) {
+                blitRow(surfaceRow(dst, y + j) + x + x0, s + x0, x1 - x0, flags);
+            } else {
+                // no 32bpp target to write into, go through setXY
+                blitRowXY(x + x0, y + j, s + x0, x1 - x0, flags);
+            }
+            continue;
+        }
+        for (i = x0; i < x1; i += BLIT_CHUNK) {
+            int n = x1 - i < BLIT_CHUNK ? x1 - i : BLIT_CHUNK;
+            for (int k = 0; k < n; k++) {
+                flipped[k] = s[w - 1 - i - k];
+            }
+            if (dst) {
+                blitRow(surfaceRow(dst, y + j) + x + i, flipped, n, flags);
+            } else {
+                blitRowXY(x + i, y + j, flipped, n, flags);
+            }
+        }
+    }
+    traceEnd("blit");
+    profileEnd(PROFILE_BLIT);
+}
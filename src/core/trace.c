@@ -0,0 +1,121 @@
+#include "trace.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+volatile int tracingEnabled = 0;
+const char *tracePath = 0;
+long traceEpoch = 0;
+// every thread's buffer, pushed with compare-and-swap
+TraceBuffer *traceBuffers = 0;
+__thread TraceBuffer *threadTraceBuffer = 0;
+
+long traceNow(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000L + ts.tv_nsec;
+}
+
+TraceBuffer* getTraceBuffer(void) {
+    TraceBuffer *b = threadTraceBuffer;
+    if (b) {
+        return b;
+    }
+    b = calloc(1, sizeof(TraceBuffer));
+    if (!b) {
+        return 0;
+    }
+    b->tid = syscall(SYS_gettid);
+    b->next = __atomic_load_n(&traceBuffers, __ATOMIC_RELAXED);
+    while (!__atomic_compare_exchange_n(&traceBuffers, &b->next, b, 1,
+                                        __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+    }
+    threadTraceBuffer = b;
+    return b;
+}
+
+/*
+Start recording; the trace is written to path by writeTrace() (called
+from terminate()). Does nothing when path is 0, so callers can pass
+getenv("PAINT_TRACE") directly.
+*/
+int initTracing(const char *path) {
+    if (!path || !*path) {
+        return 0;
+    }
+    tracePath = path;
+    traceEpoch = traceNow();
+    tracingEnabled = 1;
+    return 1;
+}
+
+void traceEvent(const char *name, char phase) {
+    TraceBuffer *b = getTraceBuffer();
+    if (!b) {
+        return;
+    }
+    unsigned int n = b->count;
+    if (n == TRACE_BUFFER_EVENTS) {
+        b->dropped++;
+        return;
+    }
+    b->events[n].name = name;
+    b->events[n].phase = phase;
+    b->events[n].timestamp = traceNow();
+    __atomic_store_n(&b->count, n + 1, __ATOMIC_RELEASE);
+}
+
+/*
+Label the calling thread in the trace viewer
+*/
+void traceThreadName(const char *name) {
+    if (!tracingEnabled) return;
+    TraceBuffer *b = getTraceBuffer();
+    if (b) {
+        b->threadName = name;
+    }
+}
+
+/*
+Stop recording and write every thread's events as Chrome trace JSON
+(chrome://tracing, Perfetto). Threads still running lose whatever they
+record afterwards.
+*/
+int writeTrace(void) {
+    if (!tracingEnabled) {
+        return 0;
+    }
+    tracingEnabled = 0;
+
+    FILE *f = fopen(tracePath, "w");
+    if (!f) {
+        perror("Error: cannot write trace");
+        return -1;
+    }
+
+    int pid = getpid();
+    int first = 1;
+    fprintf(f, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+    for (TraceBuffer *b = __atomic_load_n(&traceBuffers, __ATOMIC_ACQUIRE); b; b = b->next) {
+        unsigned int count = __atomic_load_n(&b->count, __ATOMIC_ACQUIRE);
+        if (b->threadName) {
+            fprintf(f, "%s{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": %d, \"tid\": %d, "
+                    "\"args\": {\"name\": \"%s\"}}", first ? "" : ",\n", pid, b->tid, b->threadName);
+            first = 0;
+        }
+        for (unsigned int i = 0; i < count; i++) {
+            TraceEvent *e = &b->events[i];
+            fprintf(f, "%s{\"name\": \"%s\", \"ph\": \"%c\", \"ts\": %.3f, \"pid\": %d, \"tid\": %d%s}",
+                    first ? "" : ",\n", e->name, e->phase, (e->timestamp - traceEpoch) / 1000.0,
+                    pid, b->tid, e->phase == 'i' ? ", \"s\": \"t\"" : "");
+            first = 0;
+        }
+        if (b->dropped) {
+            fprintf(stderr, "trace: thread %d dropped %lu events\n", b->tid, b->dropped);
+        }
+    }
+    fprintf(f, "\n]}\n");
+    return fclose(f);
+}
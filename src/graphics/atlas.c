@@ -0,0 +1,71 @@
+#include "framebuffer.h"
+#include "atlas.h"
+#include <stdlib.h>
+#include <math.h>
+
+/*
+Pre-render steps rotations of shape, 360/steps degrees apart, into one
+packed atlas surface
+*/
+RotationAtlas* createRotationAtlas(const SpriteShape *shape, int steps, Color c) {
+    int i;
+    if (steps < 1) steps = 1;
+
+    RotationAtlas *atlas = malloc(sizeof(RotationAtlas));
+    if (!atlas) {
+        return 0;
+    }
+    atlas->steps = steps;
+    atlas->columns = (int)ceil(sqrt(steps));
+    atlas->cellWidth = shape->width;
+    atlas->cellHeight = shape->height;
+    atlas->anchorX = shape->anchorX;
+    atlas->anchorY = shape->anchorY;
+
+    int rows = (steps + atlas->columns - 1) / atlas->columns;
+    atlas->surface = createSurface(atlas->columns * shape->width, rows * shape->height);
+    Surface *cell = createSurface(shape->width, shape->height);
+    if (!atlas->surface || !cell) {
+        destroySurface(cell);
+        destroyRotationAtlas(atlas);
+        return 0;
+    }
+
+    // rasterize each step into a scratch cell so it cannot bleed into
+    // its neighbours, then pack it
+    Surface *previous = getRenderTarget();
+    for (i = 0; i < steps; i++) {
+        clearSurface(cell, SURFACE_COLORKEY);
+        setRenderTarget(cell);
+        shape->draw(make_point(shape->anchorX, shape->anchorY), c, i * 360 / steps);
+        setRenderTarget(atlas->surface);
+        blitSurface(cell, (i % atlas->columns) * shape->width, (i / atlas->columns) * shape->height, 0);
+    }
+    setRenderTarget(previous);
+    destroySurface(cell);
+
+    return atlas;
+}
+
+void destroyRotationAtlas(RotationAtlas *atlas) {
+    if (atlas) {
+        destroySurface(atlas->surface);
+        free(atlas);
+    }
+}
+
+/*
+Blit the pre-rendered step nearest to angle (degrees) with the shape's
+anchor at p
+*/
+void drawRotated(RotationAtlas *atlas, Point p, int angle) {
+    angle %= 360;
+    if (angle < 0) angle += 360;
+    int step = ((angle * atlas->steps + 180) / 360) % atlas->steps;
+
+    blitSurfaceRect(atlas->surface,
+                    (step % atlas->columns) * atlas->cellWidth,
+                    (step / atlas->columns) * atlas->cellHeight,
+                    atlas->cellWidth, atlas->cellHeight,
+                    p.x - atlas->anchorX, p.y - atlas->anchorY, BLIT_COLORKEY);
+}
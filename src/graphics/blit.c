@@ -0,0 +1,379 @@
+#include "blit.h"
+#include "framebuffer.h"
+#include "palette.h"
+#include "profiler.h"
+#include "trace.h"
+#include "stats.h"
+#include <string.h>
+
+typedef uint32_t v4su __attribute__((vector_size(16)));
+typedef uint16_t v8hu __attribute__((vector_size(16)));
+typedef int v4si __attribute__((vector_size(16)));
+
+// Source columns a filtered chunk mixes in one contiguous pass
+#define BLIT_SPAN (2 * BLIT_CHUNK)
+
+// the blue/red and green/alpha bytes of a pixel, one per 16 bit half
+#define CHANNEL_PAIRS 0x00FF00FFu
+
+static inline int allLanes(v4si m) {
+    uint64_t q[2];
+    memcpy(q, &m, sizeof(q));
+    return (q[0] & q[1]) == ~(uint64_t)0;
+}
+
+static inline int anyLane(v4si m) {
+    uint64_t q[2];
+    memcpy(q, &m, sizeof(q));
+    return (q[0] | q[1]) != 0;
+}
+
+/*
+Both 16 bit halves of x divided by 255, rounded. Exact for halves up to
+255 * 255, which is all a blend can produce.
+*/
+static inline uint32_t div255Pairs(uint32_t x) {
+    x += 0x00800080u;
+    return (x + (x >> 8 & CHANNEL_PAIRS)) >> 8 & CHANNEL_PAIRS;
+}
+
+static inline v8hu div255Lanes(v8hu x) {
+    x += 128;
+    return (x + (x >> 8)) >> 8;
+}
+
+/*
+s over d by the alpha byte of s. The result alpha is s alpha over d
+alpha, so blending onto an opaque target keeps it opaque.
+*/
+static inline uint32_t blendPixel(uint32_t s, uint32_t d) {
+    uint32_t a = s >> 24, ia = 255 - a;
+    s |= 0xFF000000u;
+    uint32_t rb = (s & CHANNEL_PAIRS) * a + (d & CHANNEL_PAIRS) * ia;
+    uint32_t ag = (s >> 8 & CHANNEL_PAIRS) * a + (d >> 8 & CHANNEL_PAIRS) * ia;
+    return div255Pairs(rb) | div255Pairs(ag) << 8;
+}
+
+static inline v4su blendLanes(v4su s, v4su d) {
+    v4su a = s >> 24;
+    v8hu wa = (v8hu)(a | a << 16);
+    v8hu wd = 255 - wa;
+    s |= 0xFF000000u;
+    v8hu rb = (v8hu)(s & CHANNEL_PAIRS) * wa + (v8hu)(d & CHANNEL_PAIRS) * wd;
+    v8hu ag = (v8hu)(s >> 8 & CHANNEL_PAIRS) * wa + (v8hu)(d >> 8 & CHANNEL_PAIRS) * wd;
+    return (v4su)div255Lanes(rb) | (v4su)div255Lanes(ag) << 8;
+}
+
+/*
+a and b mixed by the weight f (0..256, both 16 bit halves of each lane)
+*/
+static inline v4su lerpLanes(v4su a, v4su b, v4su f) {
+    v8hu fb = (v8hu)f, fa = 256 - fb;
+    v8hu rb = ((v8hu)(a & CHANNEL_PAIRS) * fa + (v8hu)(b & CHANNEL_PAIRS) * fb + 128) >> 8;
+    v8hu ag = ((v8hu)(a >> 8 & CHANNEL_PAIRS) * fa + (v8hu)(b >> 8 & CHANNEL_PAIRS) * fb + 128) >> 8;
+    return (v4su)rb | (v4su)ag << 8;
+}
+
+/*
+Compose n pixels of src onto dst
+
+flags : BLIT_COLORKEY skips SURFACE_COLORKEY pixels,
+        BLIT_ALPHA blends by the source alpha (SURFACE_COLORKEY has
+        alpha 0, so it is skipped as well)
+*/
+void blitRow(uint32_t *dst, const uint32_t *src, int n, int flags) {
+    int i = 0;
+
+    if (flags & BLIT_ALPHA) {
+        for (; i + 4 <= n; i += 4) {
+            v4su s, d;
+            memcpy(&s, src + i, sizeof(s));
+            v4su a = s >> 24;
+            if (allLanes(a == 255)) {
+                memcpy(dst + i, &s, sizeof(s));
+                continue;
+            }
+            if (allLanes(a == 0)) continue;
+            memcpy(&d, dst + i, sizeof(d));
+            d = blendLanes(s, d);
+            memcpy(dst + i, &d, sizeof(d));
+        }
+        for (; i < n; i++) {
+            uint32_t a = src[i] >> 24;
+            if (a == 255) dst[i] = src[i];
+            else if (a) dst[i] = blendPixel(src[i], dst[i]);
+        }
+    } else if (flags & BLIT_COLORKEY) {
+        v4su key = (v4su){0} + SURFACE_COLORKEY;
+        for (; i + 4 <= n; i += 4) {
+            v4su s, d;
+            memcpy(&s, src + i, sizeof(s));
+            v4si m = s == key;
+            if (anyLane(m)) {
+                if (allLanes(m)) continue;
+                memcpy(&d, dst + i, sizeof(d));
+                s = (d & (v4su)m) | (s & ~(v4su)m);
+            }
+            memcpy(dst + i, &s, sizeof(s));
+        }
+        for (; i < n; i++) {
+            if (src[i] != SURFACE_COLORKEY) dst[i] = src[i];
+        }
+    } else if (n > 0) {
+        memmove(dst, src, (size_t)n * sizeof(uint32_t));
+    }
+}
+
+/*
+blitRow for targets without 32bpp pixels: through getXY and setXY
+*/
+void blitRowXY(int x, int y, const uint32_t *src, int n, int flags) {
+    for (int i = 0; i < n; i++) {
+        uint32_t px = src[i];
+        if ((flags & BLIT_ALPHA) && px >> 24 != 255) {
+            if (px >> 24 == 0) continue;
+            px = blendPixel(px, packColor(getXY(x + i, y)));
+        } else if ((flags & BLIT_COLORKEY) && px == SURFACE_COLORKEY) {
+            continue;
+        }
+        setXY(1, x + i, y, unpackColor(px));
+    }
+}
+
+// Source columns one chunk of a filtered row reads
+typedef struct {
+    int first, last;
+    int column[BLIT_CHUNK + 3];         // left of the filtered pair
+    int next[BLIT_CHUNK + 3];           // right of the filtered pair
+    uint32_t weight[BLIT_CHUNK + 3];    // of next, 0..255 in both 16 bit halves
+} ScaleColumns;
+
+/*
+Filter columns of the n destination pixels starting at 16.16 source
+position u, padded to a multiple of 4 with copies of the last one
+*/
+static void scaleColumns(ScaleColumns *t, int64_t u, int64_t step, int sw, int n) {
+    int k;
+    for (k = 0; k < n; k++, u += step) {
+        int64_t p = u < 0 ? 0 : u;
+        int c = p >> 16, f = p >> 8 & 255;
+        if (c >= sw - 1) {
+            c = sw - 1;
+            f = 0;
+        }
+        t->column[k] = c;
+        t->next[k] = f ? c + 1 : c;
+        t->weight[k] = f | f << 16;
+    }
+    for (; k & 3; k++) {
+        t->column[k] = t->column[n - 1];
+        t->next[k] = t->next[n - 1];
+        t->weight[k] = t->weight[n - 1];
+    }
+    t->first = t->column[0];
+    t->last = t->next[n - 1];
+}
+
+static inline uint32_t lerpPixel(uint32_t a, uint32_t b, uint32_t f) {
+    uint32_t fa = 256 - f;
+    uint32_t rb = ((a & CHANNEL_PAIRS) * fa + (b & CHANNEL_PAIRS) * f + 0x00800080u) >> 8 & CHANNEL_PAIRS;
+    uint32_t ag = ((a >> 8 & CHANNEL_PAIRS) * fa + (b >> 8 & CHANNEL_PAIRS) * f + 0x00800080u) >> 8 & CHANNEL_PAIRS;
+    return rb | ag << 8;
+}
+
+static inline v4su gatherLanes(const uint32_t *row, const int *c) {
+    return (v4su){row[c[0]], row[c[1]], row[c[2]], row[c[3]]};
+}
+
+/*
+Nearest samples of row for the n destination pixels starting at 16.16
+source position u
+*/
+static void sampleNearest(uint32_t *out, const uint32_t *row, int64_t u, int64_t step, int n) {
+    for (int k = 0; k < n; k++, u += step) {
+        out[k] = row[u >> 16];
+    }
+}
+
+/*
+Filtered samples between source rows top and bottom, fy the weight of
+bottom. Rows are mixed first: across the chunk's columns in one
+contiguous pass when they are few enough, otherwise per sample.
+*/
+static void sampleBilinear(uint32_t *out, const ScaleColumns *t, const uint32_t *top,
+                           const uint32_t *bottom, int fy, int n) {
+    uint32_t mixed[BLIT_SPAN];
+    const uint32_t *row = top;
+    v4su wy = (v4su){0} + (uint32_t)(fy | fy << 16);
+
+    if (fy && t->last - t->first < BLIT_SPAN) {
+        int c = t->first;
+        for (; c + 4 <= t->last + 1; c += 4) {
+            v4su a, b;
+            memcpy(&a, top + c, sizeof(a));
+            memcpy(&b, bottom + c, sizeof(b));
+            a = lerpLanes(a, b, wy);
+            memcpy(mixed + c - t->first, &a, sizeof(a));
+        }
+        for (; c <= t->last; c++) {
+            mixed[c - t->first] = lerpPixel(top[c], bottom[c], fy);
+        }
+        row = mixed - t->first;
+        fy = 0;
+    }
+
+    for (int k = 0; k < n; k += 4) {
+        v4su left = gatherLanes(row, t->column + k);
+        v4su right = gatherLanes(row, t->next + k);
+        if (fy) {
+            left = lerpLanes(left, gatherLanes(bottom, t->column + k), wy);
+            right = lerpLanes(right, gatherLanes(bottom, t->next + k), wy);
+        }
+        v4su w;
+        memcpy(&w, t->weight + k, sizeof(w));
+        v4su s = lerpLanes(left, right, w);
+        memcpy(out + k, &s, sizeof(s));
+    }
+}
+
+/*
+Stretch the sw x sh rectangle of src at (sx, sy) over the w x h
+rectangle at (x, y) of the current render target. Destination pixel
+centers are mapped into the source rectangle and take the nearest
+source pixel, or with BLIT_BILINEAR the four nearest filtered.
+BLIT_COLORKEY and BLIT_ALPHA apply to the samples; the colorkey test
+sees filtered colors, so keyed images scale best with nearest. The
+source rectangle is clamped to src.
+*/
+void blitScaled(Surface *src, int sx, int sy, int sw, int sh, int x, int y, int w, int h, int flags) {
+    uint32_t samples[BLIT_CHUNK + 3];
+    ScaleColumns columns;
+    int filter = flags & BLIT_BILINEAR;
+    Surface *dst = getRenderTarget();
+    if (!dst) {
+        dst = getScreenSurface();
+    }
+
+    if (sx < 0) { sw += sx; sx = 0; }
+    if (sy < 0) { sh += sy; sy = 0; }
+    if (sx + sw > src->width) sw = src->width - sx;
+    if (sy + sh > src->height) sh = src->height - sy;
+    if (sw <= 0 || sh <= 0 || w <= 0 || h <= 0) return;
+
+    // 16.16 source position of the first destination pixel center, and
+    // the distance between two of them
+    int64_t stepX = ((int64_t)sw << 16) / w;
+    int64_t stepY = ((int64_t)sh << 16) / h;
+    int64_t u0 = stepX / 2, v0 = stepY / 2;
+    if (filter) {
+        // filter weights are measured from source pixel centers
+        u0 -= 0x8000;
+        v0 -= 0x8000;
+    }
+
+    int x0 = 0, y0 = 0, x1 = w, y1 = h;
+    if (dst) {
+        if (x < 0) x0 = -x;
+        if (y < 0) y0 = -y;
+        if (x + x1 > dst->width) x1 = dst->width - x;
+        if (y + y1 > dst->height) y1 = dst->height - y;
+        if (x1 <= x0 || y1 <= y0) return;
+        countStat(STAT_PIXELS_WRITTEN, (long)(x1 - x0) * (y1 - y0));
+        countStat(STAT_SPANS, y1 - y0);
+    }
+
+    profileBegin(PROFILE_BLIT);
+    traceBegin("blitScaled");
+    // a chunk of columns at a time, so its filter columns are found once
+    for (int i = x0; i < x1; i += BLIT_CHUNK) {
+        int n = x1 - i < BLIT_CHUNK ? x1 - i : BLIT_CHUNK;
+        if (filter) {
+            scaleColumns(&columns, u0 + i * stepX, stepX, sw, n);
+        }
+
+        for (int j = y0; j < y1; j++) {
+            int64_t v = v0 + j * stepY;
+            if (filter) {
+                if (v < 0) v = 0;
+                int r = v >> 16, fy = v >> 8 & 255;
+                if (r >= sh - 1) {
+                    r = sh - 1;
+                    fy = 0;
+                }
+                const uint32_t *top = surfaceRow(src, sy + r) + sx;
+                sampleBilinear(samples, &columns, top, fy ? top + src->pitch : top, fy, n);
+            } else {
+                sampleNearest(samples, surfaceRow(src, sy + (int)(v >> 16)) + sx, u0 + i * stepX, stepX, n);
+            }
+            if (dst) {
+                blitRow(surfaceRow(dst, y + j) + x + i, samples, n, flags);
+            } else {
+                blitRowXY(x + i, y + j, samples, n, flags);
+            }
+        }
+    }
+    traceEnd("blitScaled");
+    profileEnd(PROFILE_BLIT);
+}
+
+static inline v4su pack565Lanes(v4su p) {
+    return (p >> 8 & 0xF800) | (p >> 5 & 0x07E0) | (p >> 3 & 0x001F);
+}
+
+static inline v4su unpack565Lanes(v4su t) {
+    v4su r = t >> 11, g = t >> 5 & 63, b = t & 31;
+    return 0xFF000000u | (r << 3 | r >> 2) << 16 | (g << 2 | g >> 4) << 8 | (b << 3 | b >> 2);
+}
+
+/*
+0xAARRGGBB to RGB565 without dithering, eight pixels per step
+*/
+void packRow565(uint16_t *dst, const uint32_t *src, int n) {
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        v4su lo, hi;
+        memcpy(&lo, src + i, sizeof(lo));
+        memcpy(&hi, src + i + 4, sizeof(hi));
+        v8hu t = __builtin_shuffle((v8hu)pack565Lanes(lo), (v8hu)pack565Lanes(hi),
+                                   (v8hu){0, 2, 4, 6, 8, 10, 12, 14});
+        memcpy(dst + i, &t, sizeof(t));
+    }
+    for (; i < n; i++) {
+        uint32_t p = src[i];
+        dst[i] = packRGB565(p >> 16 & 255, p >> 8 & 255, p & 255);
+    }
+}
+
+/*
+RGB565 to opaque 0xAARRGGBB, channels widened by repeating their top bits
+*/
+void unpackRow565(uint32_t *dst, const uint16_t *src, int n) {
+    int i = 0;
+    v8hu zero = {0};
+    for (; i + 8 <= n; i += 8) {
+        v8hu t;
+        memcpy(&t, src + i, sizeof(t));
+        v4su lo = unpack565Lanes((v4su)__builtin_shuffle(t, zero, (v8hu){0, 8, 1, 9, 2, 10, 3, 11}));
+        v4su hi = unpack565Lanes((v4su)__builtin_shuffle(t, zero, (v8hu){4, 12, 5, 13, 6, 14, 7, 15}));
+        memcpy(dst + i, &lo, sizeof(lo));
+        memcpy(dst + i + 4, &hi, sizeof(hi));
+    }
+    for (; i < n; i++) {
+        dst[i] = packColor(unpackRGB565(src[i]));
+    }
+}
+
+/*
+Whole-surface conversions; pitch is in pixels of the 16 bit image
+*/
+void surfaceToRGB565(const Surface *s, uint16_t *dst, int pitch) {
+    for (int j = 0; j < s->height; j++) {
+        packRow565(dst + (long)j * pitch, surfaceRow(s, j), s->width);
+    }
+}
+
+void surfaceFromRGB565(Surface *s, const uint16_t *src, int pitch) {
+    for (int j = 0; j < s->height; j++) {
+        unpackRow565(surfaceRow(s, j), src + (long)j * pitch, s->width);
+    }
+}
@@ -1,5 +1,6 @@
 #include "framebuffer.h"
 #include "clipping.h"
+#include "profiler.h"
 #include <stdio.h>
 
 ClippingWindow setClippingWindow(int left, int right, int top, int bottom){
@@ -58,6 +59,7 @@ int isCompletelyOutside(LineAnalysisResult x){
 
 
 LineAnalysisResult analyzeLine(Point startPoint, Point endPoint, ClippingWindow cw){
+	profileBegin(PROFILE_CLIP);
 	RegionCode startPointRegionCode = computeRegionCode(startPoint,cw);
 	RegionCode endPointRegionCode = computeRegionCode(endPoint,cw);
 
@@ -76,11 +78,13 @@ LineAnalysisResult analyzeLine(Point startPoint, Point endPoint, ClippingWindow
 	result.startPointRegionCode = startPointRegionCode;
 	result.endPointRegionCode = endPointRegionCode;
 
+	profileEnd(PROFILE_CLIP);
 	return result;
 }
 
 
 void clipLine(LineAnalysisResult lar1, ClippingWindow cw1 , Point * output) {
+	profileBegin(PROFILE_CLIP);
 
 	Color white = setColor(255,255,255);
 	Point line[2];
@@ -226,22 +230,5 @@ void clipLine(LineAnalysisResult lar1, ClippingWindow cw1 , Point * output) {
 		output[1] = makePoint(lar1.endPoint.x, lar1.endPoint.y);
 
 	}
-}
-// Bridge functions for new interface compatibility
-struct clipping_boundary create_clipping_window(int left, int right, int top, int bottom) {
-    struct clipping_boundary boundary;
-    boundary.left_boundary = left;
-    boundary.right_boundary = right;
-    boundary.top_boundary = top;
-    boundary.bottom_boundary = bottom;
-    return boundary;
-}
-
-struct viewport_region_code initialize_empty_region_code(void) {
-    struct viewport_region_code code;
-    code.left_region = 0;
-    code.right_region = 0;
-    code.top_region = 0;
-    code.bottom_region = 0;
-    return code;
+	profileEnd(PROFILE_CLIP);
 }
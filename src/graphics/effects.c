@@ -0,0 +1,187 @@
+#include "effects.h"
+#include "framebuffer.h"
+#include "profiler.h"
+#include <math.h>
+#include <string.h>
+
+#define PI 3.14159265f
+
+ColorRamp fireRamp;
+ColorRamp smokeRamp;
+int rampsReady = 0;
+
+/*
+Interpolate n >= 2 evenly spaced stops into a COLOR_RAMP_SIZE table
+*/
+void buildColorRamp(ColorRamp *ramp, int n, const Color *stops) {
+    for (int i = 0; i < COLOR_RAMP_SIZE; i++) {
+        float t = (float)i * (n - 1) / (COLOR_RAMP_SIZE - 1);
+        int k = (int)t;
+        if (k >= n - 1) k = n - 2;
+        float f = t - k;
+        int r = stops[k].R + (int)((stops[k + 1].R - stops[k].R) * f);
+        int g = stops[k].G + (int)((stops[k + 1].G - stops[k].G) * f);
+        int b = stops[k].B + (int)((stops[k + 1].B - stops[k].B) * f);
+        ramp->colors[i] = (r << 16) | (g << 8) | b;
+    }
+}
+
+void buildDefaultRamps(void) {
+    Color fire[5] = {
+        setColor(255, 255, 220), setColor(255, 200, 60), setColor(218, 114, 53),
+        setColor(120, 30, 10), setColor(0, 0, 0)
+    };
+    Color smoke[3] = {setColor(70, 60, 55), setColor(35, 30, 30), setColor(0, 0, 0)};
+    buildColorRamp(&fireRamp, 5, fire);
+    buildColorRamp(&smokeRamp, 3, smoke);
+    rampsReady = 1;
+}
+
+int initEffects(EffectSystem *fx, int maxParticles) {
+    memset(fx, 0, sizeof(*fx));
+    if (initParticleSystem(&fx->particles, maxParticles)) {
+        return -1;
+    }
+    fx->particles.gravity = 1;
+    fx->particles.drag = 0;
+    fx->density = 1;
+    fx->seed = 2463534242u;
+    if (!rampsReady) {
+        buildDefaultRamps();
+    }
+    return 0;
+}
+
+void freeEffects(EffectSystem *fx) {
+    freeParticleSystem(&fx->particles);
+}
+
+void setEffectDensity(EffectSystem *fx, float density) {
+    fx->density = density < 0 ? 0 : (density > 1 ? 1 : density);
+}
+
+/*
+Copy e into a free slot: one done emitting whose particles have all
+expired. Returns 0 when all slots are busy.
+*/
+Emitter* addEmitter(EffectSystem *fx, const Emitter *e) {
+    for (int n = 0; n < MAX_EMITTERS; n++) {
+        int i = (fx->nextEmitter + n) % MAX_EMITTERS;
+        if (fx->emitters[i].steps == 0 && fx->lingering[i] == 0) {
+            fx->emitters[i] = *e;
+            if (fx->emitters[i].steps < 1) fx->emitters[i].steps = 1;
+            fx->nextEmitter = (i + 1) % MAX_EMITTERS;
+            return &fx->emitters[i];
+        }
+    }
+    return 0;
+}
+
+// xorshift32, uniform in [0, 1)
+float randomUnit(EffectSystem *fx) {
+    uint32_t x = fx->seed;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    fx->seed = x;
+    return (x >> 8) * (1.0f / 16777216.0f);
+}
+
+/*
+A fireball with a short smoke trail. size scales the particle count.
+*/
+void spawnExplosion(EffectSystem *fx, Point p, int size) {
+    Emitter fire = {p, 400 * size, 60 * size, 6, 20, 160, -90, 360, 40, 2, &fireRamp};
+    Emitter smoke = {p, 0, 40 * size, 45, 5, 40, -90, 120, 70, 3, &smokeRamp};
+    addEmitter(fx, &fire);
+    addEmitter(fx, &smoke);
+}
+
+void emit(EffectSystem *fx, int slot, int count) {
+    Emitter *e = &fx->emitters[slot];
+    for (int i = 0; i < count; i++) {
+        float angle = (e->angle + (randomUnit(fx) - 0.5f) * e->spread) * PI / 180;
+        float speed = e->speedMin + (e->speedMax - e->speedMin) * randomUnit(fx);
+        float life = e->life * (0.75f + 0.5f * randomUnit(fx));
+        int k = spawnParticle(&fx->particles, e->pos.x, e->pos.y,
+                              cosf(angle) * speed, sinf(angle) * speed, life);
+        if (k < 0) {
+            return;
+        }
+        fx->particles.tag[k] = slot;
+    }
+}
+
+/*
+One simulation step: run the emitters, then move and age every particle
+*/
+void updateEffects(EffectSystem *fx) {
+    for (int i = 0; i < MAX_EMITTERS; i++) {
+        Emitter *e = &fx->emitters[i];
+        if (e->steps == 0) {
+            if (fx->lingering[i] > 0) fx->lingering[i]--;
+            continue;
+        }
+        int count = e->rate;
+        if (e->burst) {
+            count += e->burst;
+            e->burst = 0;
+        }
+        emit(fx, i, (int)(count * fx->density));
+        if (--e->steps == 0) {
+            // particles live up to 1.25 life steps, and the last ones
+            // are moved for the first time below
+            fx->lingering[i] = (int)ceilf(e->life * 1.25f) + 1;
+        }
+    }
+    updateParticles(&fx->particles);
+}
+
+/*
+Per-channel a + b clamped at 255, four bytes at once
+*/
+uint32_t addPixelsSaturated(uint32_t a, uint32_t b) {
+    uint32_t sum = (a & 0x7F7F7F7F) + (b & 0x7F7F7F7F);
+    uint32_t high = (a ^ b) & 0x80808080;
+    uint32_t carry = ((a & b) | (sum & high)) & 0x80808080;
+    return (sum ^ high) | ((carry >> 7) * 0xFF);
+}
+
+/*
+Add every particle's ramp color onto the render target (or the 32bpp
+screen). Nothing is drawn when neither is available.
+*/
+void drawEffects(EffectSystem *fx) {
+    Surface *dst = getRenderTarget();
+    ParticleSystem *ps = &fx->particles;
+    if (!dst) {
+        dst = getScreenSurface();
+    }
+    if (!dst) {
+        return;
+    }
+
+    profileBegin(PROFILE_BLIT);
+    for (int i = 0; i < ps->count; i++) {
+        const Emitter *e = &fx->emitters[ps->tag[i]];
+        int x = (int)ps->x[i];
+        int y = (int)ps->y[i];
+        int size = e->size;
+        if (x < 0 || y < 0 || x + size > dst->width || y + size > dst->height) continue;
+
+        // the ramp runs over the emitter's nominal life; jittered
+        // particles clamp at either end
+        int age = (int)((1 - ps->life[i] / e->life) * (COLOR_RAMP_SIZE - 1));
+        if (age < 0) age = 0;
+        if (age > COLOR_RAMP_SIZE - 1) age = COLOR_RAMP_SIZE - 1;
+        uint32_t color = e->ramp->colors[age];
+
+        uint32_t *row = dst->pixels + (long)y * dst->pitch + x;
+        for (int j = 0; j < size; j++, row += dst->pitch) {
+            for (int k = 0; k < size; k++) {
+                row[k] = addPixelsSaturated(row[k], color);
+            }
+        }
+    }
+    profileEnd(PROFILE_BLIT);
+}
@@ -0,0 +1,215 @@
+#include "entity.h"
+#include "game.h"
+#include "collision.h"
+#include "profiler.h"
+#include <string.h>
+
+#define LAYER_PROJECTILE 1
+#define LAYER_PLANE 2
+
+// loose boxes around drawPlane and drawProjectile, relative to the anchor
+#define PLANE_HALF_WIDTH 120
+#define PLANE_TOP 50
+#define PLANE_BOTTOM 45
+#define PROJECTILE_HALF_WIDTH 15
+#define PROJECTILE_LENGTH 40
+
+int initWorld(World *w) {
+    memset(w, 0, sizeof(*w));
+    if (initParticleSystem(&w->debris, MAX_DEBRIS)) {
+        return -1;
+    }
+    w->debris.groundY = displayHeight - 100;
+    w->lastWings = -1;
+    return 0;
+}
+
+void freeWorld(World *w) {
+    freeParticleSystem(&w->debris);
+}
+
+/*
+Each spawn returns the new entity's index, or -1 when its pool is full
+*/
+int spawnProjectile(World *w, Point tip) {
+    if (w->projectileCount == MAX_PROJECTILES) {
+        return -1;
+    }
+    Projectile *p = &w->projectiles[w->projectileCount];
+    p->pos = tip;
+    p->prev = tip;
+    return w->projectileCount++;
+}
+
+int spawnPlane(World *w, Point p, int dx, int dy) {
+    if (w->planeCount == MAX_PLANES) {
+        return -1;
+    }
+    Plane *plane = &w->planes[w->planeCount];
+    plane->pos = p;
+    plane->prev = p;
+    plane->dx = dx;
+    plane->dy = dy;
+    return w->planeCount++;
+}
+
+int spawnDebris(World *w, DebrisKind kind, Point p, int vx, int vy) {
+    int i = spawnParticle(&w->debris, p.x, p.y, vx, vy, PARTICLE_IMMORTAL);
+    if (i >= 0) {
+        w->debris.tag[i] = kind;
+    }
+    return i;
+}
+
+/*
+Facing to pass to drawPlane: planes flying right are drawn mirrored
+*/
+int planeDirection(const Plane *plane) {
+    return plane->dx > 0 ? -1 : 1;
+}
+
+/*
+Returns the index of the wings, which the crash scene follows, or -1 when
+the debris pool is full. Debris never expire, so the index stays valid.
+*/
+int spawnCrashDebris(World *w, const Plane *plane) {
+    Point p = plane->pos;
+    int sign = plane->dx;
+    spawnDebris(w, DEBRIS_PARACHUTE, makePoint(p.x, p.y - 200), -100 * sign, -100);
+    spawnDebris(w, DEBRIS_COCKPIT, p, 100 * sign, -50);
+    spawnDebris(w, DEBRIS_BODY, p, 100 * sign, 0);
+    int wings = spawnDebris(w, DEBRIS_WINGS, p, 0, -50);
+    spawnDebris(w, DEBRIS_PROPELLER, makePoint(p.x - 40, p.y + 10), -100 * sign, 0);
+    return wings;
+}
+
+void updatePlanes(World *w) {
+    for (int i = 0; i < w->planeCount; i++) {
+        Plane *plane = &w->planes[i];
+        plane->prev = plane->pos;
+        plane->pos.x += PLANE_STEP * plane->dx;
+        plane->pos.y += PLANE_STEP * plane->dy;
+
+        if (plane->pos.x > displayWidth - 200) plane->dx = -1;
+        else if (plane->pos.x < 100) plane->dx = 1;
+        if (plane->pos.y > 200) plane->dy = -1;
+        else if (plane->pos.y < 100) plane->dy = 1;
+    }
+}
+
+void updateProjectiles(World *w) {
+    Point muzzle;
+    if (takeFireRequest(&muzzle)) {
+        spawnProjectile(w, muzzle);
+    }
+
+    for (int i = 0; i < w->projectileCount; i++) {
+        Projectile *p = &w->projectiles[i];
+        p->prev = p->pos;
+        p->pos.y -= PROJECTILE_STEP;
+        if (p->pos.y <= 80) {
+            w->projectiles[i--] = w->projectiles[--w->projectileCount];
+        }
+    }
+}
+
+/*
+Projectiles against planes: sort-and-sweep over their boxes, then the
+polygon test for each candidate pair. A hit removes both and throws the
+plane's debris.
+*/
+void resolveHits(World *w) {
+    Collider colliders[MAX_PROJECTILES + MAX_PLANES];
+    CollisionPair pairs[MAX_PROJECTILES * MAX_PLANES];
+    char projectileHit[MAX_PROJECTILES] = {0};
+    char planeHit[MAX_PLANES] = {0};
+    int n = 0;
+
+    for (int i = 0; i < w->projectileCount; i++, n++) {
+        Point tip = w->projectiles[i].pos;
+        colliders[n].box.xMin = tip.x - PROJECTILE_HALF_WIDTH;
+        colliders[n].box.xMax = tip.x + PROJECTILE_HALF_WIDTH;
+        colliders[n].box.yMin = tip.y;
+        colliders[n].box.yMax = tip.y + PROJECTILE_LENGTH;
+        colliders[n].id = i;
+        colliders[n].layer = LAYER_PROJECTILE;
+        colliders[n].mask = LAYER_PLANE;
+    }
+    for (int i = 0; i < w->planeCount; i++, n++) {
+        Point p = w->planes[i].pos;
+        colliders[n].box.xMin = p.x - PLANE_HALF_WIDTH;
+        colliders[n].box.xMax = p.x + PLANE_HALF_WIDTH;
+        colliders[n].box.yMin = p.y - PLANE_TOP;
+        colliders[n].box.yMax = p.y + PLANE_BOTTOM;
+        colliders[n].id = MAX_PROJECTILES + i;
+        colliders[n].layer = LAYER_PLANE;
+        colliders[n].mask = LAYER_PROJECTILE;
+    }
+
+    int count = sweepAndPrune(colliders, n, pairs, MAX_PROJECTILES * MAX_PLANES);
+    for (int k = 0; k < count; k++) {
+        int a = pairs[k].a < pairs[k].b ? pairs[k].a : pairs[k].b;
+        int b = (pairs[k].a < pairs[k].b ? pairs[k].b : pairs[k].a) - MAX_PROJECTILES;
+        if (projectileHit[a] || planeHit[b]) continue;
+        Projectile *p = &w->projectiles[a];
+        Plane *plane = &w->planes[b];
+        if (projectileHitsPlane(p->pos.x, p->pos.y, plane->pos, planeDirection(plane))) {
+            projectileHit[a] = 1;
+            planeHit[b] = 1;
+        }
+    }
+
+    // remove back to front so the swapped-in entities were already checked
+    for (int i = w->planeCount - 1; i >= 0; i--) {
+        if (planeHit[i]) {
+            w->lastWings = spawnCrashDebris(w, &w->planes[i]);
+            w->lastDestroyed = w->planes[i];
+            w->planesDestroyed++;
+            w->planes[i] = w->planes[--w->planeCount];
+        }
+    }
+    for (int i = w->projectileCount - 1; i >= 0; i--) {
+        if (projectileHit[i]) {
+            w->projectiles[i] = w->projectiles[--w->projectileCount];
+        }
+    }
+}
+
+/*
+One simulation step for every entity
+*/
+void updateWorld(World *w) {
+    updatePlanes(w);
+    updateProjectiles(w);
+    profileBegin(PROFILE_PHYSICS);
+    resolveHits(w);
+    profileEnd(PROFILE_PHYSICS);
+    updateParticles(&w->debris);
+}
+
+Point lerpEntity(Point a, Point b, float t) {
+    return makePoint(a.x + (int)((b.x - a.x) * t), a.y + (int)((b.y - a.y) * t));
+}
+
+/*
+alpha : position between the previous and the current simulation step
+*/
+void drawWorld(World *w, float alpha, Color planeColor) {
+    for (int i = 0; i < w->planeCount; i++) {
+        Plane *plane = &w->planes[i];
+        drawPlane(lerpEntity(plane->prev, plane->pos, alpha), planeDirection(plane), planeColor);
+    }
+    for (int i = 0; i < w->projectileCount; i++) {
+        drawProjectile(lerpEntity(w->projectiles[i].prev, w->projectiles[i].pos, alpha));
+    }
+    for (int i = 0; i < w->debris.count; i++) {
+        Point p = particlePosition(&w->debris, i);
+        switch (w->debris.tag[i]) {
+            case DEBRIS_PARACHUTE: drawParachute(p); break;
+            case DEBRIS_COCKPIT: drawBrokenPlaneCockpit(p); break;
+            case DEBRIS_BODY: drawBrokenPlaneBody(p); break;
+            case DEBRIS_WINGS: drawBrokenPlaneWings(p); break;
+            case DEBRIS_PROPELLER: drawBaling(p.x, p.y, p.y); break;
+        }
+    }
+}
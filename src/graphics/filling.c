@@ -1,55 +1,468 @@
 #include "framebuffer.h"
 #include "filling.h"
+#include "profiler.h"
+#include "trace.h"
+#include "stats.h"
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
+#include <limits.h>
 
 
 /*
-Procedure floodfill
+State of one fill. The visited bitset has one bit per pixel of the
+fillable area; a pixel is written at most once, so no mode can loop even
+when the fill color itself counts as inside.
+*/
+typedef struct {
+    Surface *s;             // packed target, 0 = go through getXY/setXY
+    int width;
+    int height;
+    Color color;
+    uint32_t pixel;
+    uint32_t ref;
+    int tolerance;
+    int boundary;           // inside = not similar to ref
+    int connect8;
+    uint64_t *visited;
+    int words;              // bitset words per row
+    uint32_t *scratch;      // row read back through getXY
+    int y0, y1;             // rows this state owns, see FillBand
+    struct FillBand *band;  // 0 = serial fill
+    long pixels;            // counted here, added to the stats by fillRegion
+    int spans;
+    long queued;            // seeds queued, added as STAT_QUEUE_ALLOCS
+} FillState;
 
-fp_x    : fire point x
-fp_y    : fire point y
-C   : warna flood
-fc  : warna dasar yang akan ditimpa oleh warna flood
+/*
+Row range [y, l, r) handed to the band that owns row y
 */
+typedef struct FillSeed {
+    int y, l, r;
+    struct FillSeed *next;
+} FillSeed;
 
-void floodFill(int fp_x, int fp_y, Color C, Color fc) {
+/*
+One worker of a parallel fill. It only reads, writes and marks its own
+rows; seeds for rows of the neighbouring bands are pushed onto their
+inbox (lock-free, the owner takes the whole list at once). pending
+counts seeds sent but not yet worked off, so the fill is over when it
+drops to zero. A seed that cannot be allocated sets dropped, and the
+fill is finished serially once the bands are done.
+*/
+typedef struct FillBand {
+    FillState st;
+    FillSeed *inbox;
+    struct FillBand *bands;
+    long *pending;
+    int *dropped;
+} FillBand;
 
-    if (isColorSame(C, fc)) {
+int fillThreadCount = 0;
+
+// Pixels read at a time while widening a seed on screens without packed
+// pixels, where every read goes through getXY
+#define FILL_READ_CHUNK 64
+
+/*
+Pixels of row y from l to r. Packed targets are read in place, other
+screens are read into the scratch row (indexed by x as well).
+*/
+static uint32_t* fillRow(FillState *st, int y, int l, int r) {
+    if (st->s) {
+        return surfaceRow(st->s, y);
+    }
+    for (int i = l; i < r; i++) {
+        st->scratch[i] = packColor(getXY(i, y));
+    }
+    return st->scratch;
+}
+
+static inline uint32_t fillPixel(const FillState *st, int x, int y) {
+    return st->s ? surfaceRow(st->s, y)[x] : packColor(getXY(x, y));
+}
+
+static inline int isInside(const FillState *st, uint32_t p) {
+    return pixelsSimilar(p, st->ref, st->tolerance) != st->boundary;
+}
+
+static inline int isVisited(const FillState *st, int x, int y) {
+    return st->visited[(long)y * st->words + (x >> 6)] >> (x & 63) & 1;
+}
+
+/*
+Leading run of [x, x+n) on row y whose visited bits all equal want
+*/
+static int visitedRun(const FillState *st, int y, int x, int n, int want) {
+    const uint64_t *bits = st->visited + (long)y * st->words;
+    int i = x, end = x + n;
+    while (i < end) {
+        // set bits end the run
+        uint64_t w = (want ? ~bits[i >> 6] : bits[i >> 6]) >> (i & 63);
+        if (w) {
+            i += __builtin_ctzll(w);
+            break;
+        }
+        i += 64 - (i & 63);
+    }
+    return (i < end ? i : end) - x;
+}
+
+/*
+Leading run of [x, x+n) that can be filled (want = 1) or must be
+skipped (want = 0): inside by color and not visited yet
+*/
+static int fillRun(const FillState *st, const uint32_t *row, int y, int x, int n, int want) {
+    if (want) {
+        int c = matchRun(row + x, n, st->ref, st->tolerance, !st->boundary);
+        return visitedRun(st, y, x, c, 0);
+    }
+    int i = x, end = x + n;
+    while (i < end) {
+        i += matchRun(row + i, end - i, st->ref, st->tolerance, st->boundary);
+        if (i >= end) break;
+        int v = visitedRun(st, y, i, end - i, 1);
+        if (v == 0) break;
+        i += v;
+    }
+    return i - x;
+}
+
+/*
+End of the fillable run starting at x on row y. Through getXY the row is
+read a chunk at a time and only as far as the run goes.
+*/
+static int runEnd(FillState *st, int y, int x) {
+    if (st->s) {
+        return x + fillRun(st, surfaceRow(st->s, y), y, x, st->width - x, 1);
+    }
+    while (x < st->width) {
+        int n = st->width - x < FILL_READ_CHUNK ? st->width - x : FILL_READ_CHUNK;
+        int run = fillRun(st, fillRow(st, y, x, x + n), y, x, n, 1);
+        x += run;
+        if (run < n) break;
+    }
+    return x;
+}
+
+static void writeSpan(FillState *st, int y, int l, int r) {
+    uint64_t *bits = st->visited + (long)y * st->words;
+    for (int i = l; i < r; ) {
+        // whole words at a time
+        int n = 64 - (i & 63) < r - i ? 64 - (i & 63) : r - i;
+        bits[i >> 6] |= (n == 64 ? ~(uint64_t)0 : (((uint64_t)1 << n) - 1)) << (i & 63);
+        i += n;
+    }
+    if (st->s) {
+        uint32_t *row = surfaceRow(st->s, y);
+        for (int i = l; i < r; i++) {
+            row[i] = st->pixel;
+        }
+        st->pixels += r - l;
+    } else {
+        for (int i = l; i < r; i++) {
+            setXY(1, i, y, st->color);
+        }
+    }
+    st->spans++;
+}
+
+static void sendSeed(FillBand *to, int y, int l, int r) {
+    FillSeed *seed = malloc(sizeof(FillSeed));
+    if (!seed) {
+        __atomic_store_n(to->dropped, 1, __ATOMIC_RELAXED);
+        return;
+    }
+    seed->y = y;
+    seed->l = l;
+    seed->r = r;
+    __atomic_add_fetch(to->pending, 1, __ATOMIC_RELAXED);
+    seed->next = __atomic_load_n(&to->inbox, __ATOMIC_RELAXED);
+    while (!__atomic_compare_exchange_n(&to->inbox, &seed->next, seed, 1,
+                                        __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+    }
+}
+
+/*
+Queue one seed per fillable stretch of [lo, hi) on row y, or hand the
+range to the band owning y
+*/
+static void seedRow(FillState *st, queue *pq, int y, int lo, int hi) {
+    if (y < st->y0 || y >= st->y1) {
+        FillBand *b = st->band;
+        sendSeed(&b->bands[y < st->y0 ? b - b->bands - 1 : b - b->bands + 1], y, lo, hi);
         return;
     }
+    uint32_t *row = fillRow(st, y, lo, hi);
+    int x = lo;
+    while (x < hi) {
+        x += fillRun(st, row, y, x, hi - x, 0);
+        if (x >= hi) break;
+        insertPoint(pq, makePoint(x, y));
+        st->queued++;
+        x += fillRun(st, row, y, x, hi - x, 1);
+    }
+}
+
+/*
+Scanline fill shared by every mode. Each seed is widened into the full
+fillable run on its row, the run is written in one pass, and the rows
+above and below get one seed per fillable stretch under it (one pixel
+wider on each side with 8-connectivity).
 
+Returns when the queue is empty, or early once a serial fill has written
+limit pixels, leaving the rest of the seeds in pq.
+*/
+static void spanFill(FillState *st, queue *pq, long limit) {
+    while(!queueEmpty(pq) && st->pixels < limit) {
+        Point p = nextPoint(pq);
+        if (isVisited(st, p.x, p.y) || !isInside(st, fillPixel(st, p.x, p.y))) {
+            continue;   // filled from another seed meanwhile
+        }
+
+        // only the stretch the seed widens into is read
+        int l = p.x;
+        while (l > 0 && !isVisited(st, l-1, p.y) && isInside(st, fillPixel(st, l-1, p.y))) {
+            l--;
+        }
+        int r = runEnd(st, p.y, p.x);
+        writeSpan(st, p.y, l, r);
+
+        int lo = st->connect8 && l > 0 ? l - 1 : l;
+        int hi = st->connect8 && r < st->width ? r + 1 : r;
+        if (p.y > 0) seedRow(st, pq, p.y - 1, lo, hi);
+        if (p.y + 1 < st->height) seedRow(st, pq, p.y + 1, lo, hi);
+    }
+}
+
+static void* fillBandLoop(void *arg) {
+    FillBand *b = arg;
     queue pq_d;
     queue* pq = &pq_d;
 
     initQueue(pq);
+    while (1) {
+        FillSeed *seed = __atomic_exchange_n(&b->inbox, 0, __ATOMIC_ACQUIRE);
+        if (!seed) {
+            if (__atomic_load_n(b->pending, __ATOMIC_ACQUIRE) == 0) break;
+            sched_yield();
+            continue;
+        }
+        long taken = 0;
+        while (seed) {
+            FillSeed *next = seed->next;
+            seedRow(&b->st, pq, seed->y, seed->l, seed->r);
+            free(seed);
+            seed = next;
+            taken++;
+        }
+        spanFill(&b->st, pq, LONG_MAX);
+        // only now, so pending cannot reach zero while seeds are on their way
+        __atomic_sub_fetch(b->pending, taken, __ATOMIC_RELEASE);
+    }
+    return 0;
+}
 
-    insertPoint(pq, makePoint(fp_x, fp_y));
+/*
+Run work on every one of n structs of size bytes at items, the first on
+this thread and the others on their own threads (or here as well when a
+thread cannot be started)
+*/
+static void runBands(void *items, size_t size, int n, void *(*work)(void *)) {
+    pthread_t threads[FILL_MAX_THREADS];
+    int started[FILL_MAX_THREADS];
+    for (int i = 1; i < n; i++) {
+        started[i] = pthread_create(&threads[i], 0, work, (char *)items + i * size) == 0;
+    }
+    work(items);
+    for (int i = 1; i < n; i++) {
+        if (started[i]) {
+            pthread_join(threads[i], 0);
+        } else {
+            work((char *)items + i * size);
+        }
+    }
+}
 
-    setXY(1, fp_x, fp_y, C);
+/*
+Worker threads for rows rows, at least FILL_MIN_ROWS each
+*/
+static int fillThreads(int rows) {
+    long n = fillThreadCount > 0 ? fillThreadCount : sysconf(_SC_NPROCESSORS_ONLN);
+    if (n > rows / FILL_MIN_ROWS) n = rows / FILL_MIN_ROWS;
+    if (n > FILL_MAX_THREADS) n = FILL_MAX_THREADS;
+    return n < 1 ? 1 : n;
+}
+
+/*
+Threads used by large fills, 0 = one per core
+*/
+void setFillThreads(int n) {
+    fillThreadCount = n;
+}
+
+/*
+Seeds dropped by a parallel fill left parts of the region unfilled:
+every run of written pixels seeds the rows next to it again, and the
+fill continues serially from there
+*/
+static void finishDroppedFill(FillState *st, queue *pq) {
+    for (int y = 0; y < st->height; y++) {
+        int x = 0;
+        while (x < st->width) {
+            x += visitedRun(st, y, x, st->width - x, 0);
+            if (x >= st->width) break;
+            int l = x;
+            x += visitedRun(st, y, x, st->width - x, 1);
+            int lo = st->connect8 && l > 0 ? l - 1 : l;
+            int hi = st->connect8 && x < st->width ? x + 1 : x;
+            if (y > 0) seedRow(st, pq, y - 1, lo, hi);
+            if (y + 1 < st->height) seedRow(st, pq, y + 1, lo, hi);
+        }
+    }
+    spanFill(st, pq, LONG_MAX);
+}
+
+/*
+Finish a fill that outgrew FILL_PARALLEL_PIXELS on horizontal bands of
+rows, one per worker. The seeds still queued are sent to their bands.
+*/
+static void parallelFill(FillState *st, queue *pq, int n) {
+    FillBand bands[FILL_MAX_THREADS];
+    long pending = 0;
+    int dropped = 0;
 
-    while(!queueEmpty(pq)) {
+    for (int i = 0; i < n; i++) {
+        bands[i].st = *st;
+        bands[i].st.y0 = (long)st->height * i / n;
+        bands[i].st.y1 = (long)st->height * (i + 1) / n;
+        bands[i].st.band = &bands[i];
+        bands[i].st.pixels = 0;
+        bands[i].st.spans = 0;
+        bands[i].st.queued = 0;
+        bands[i].inbox = 0;
+        bands[i].bands = bands;
+        bands[i].pending = &pending;
+        bands[i].dropped = &dropped;
+    }
+    while (!queueEmpty(pq)) {
         Point p = nextPoint(pq);
-        if ((p.x>=0) && (p.x<(vinfo.xres-1)) && (p.y>=0) && (p.y<(vinfo.yres-7))) {
-            if (isColorSame(fc, getXY(p.x, p.y-1)) == 1) {
-                setXY(1, p.x, p.y-1, C);
-                insertPoint(pq, makePoint(p.x, p.y-1));
-            }
+        int i = (long)p.y * n / st->height;
+        while (p.y < bands[i].st.y0) i--;
+        while (p.y >= bands[i].st.y1) i++;
+        sendSeed(&bands[i], p.y, p.x, p.x + 1);
+    }
+    runBands(bands, sizeof(FillBand), n, fillBandLoop);
+    for (int i = 0; i < n; i++) {
+        st->pixels += bands[i].st.pixels;
+        st->spans += bands[i].st.spans;
+        st->queued += bands[i].st.queued;
+    }
+    if (dropped) {
+        finishDroppedFill(st, pq);
+    }
+}
 
-            if (isColorSame(fc, getXY(p.x+1, p.y)) == 1) {
-                setXY(1, p.x+1, p.y, C);
-                insertPoint(pq, makePoint(p.x+1, p.y));
-            }
+/*
+Fill the region around (x, y) with C.
 
-            if (isColorSame(fc, getXY(p.x, p.y+1)) == 1) {
-                setXY(1, p.x, p.y+1, C);
-                insertPoint(pq, makePoint(p.x, p.y+1));
-            }
+ref       : without FILL_BOUNDARY the color to replace, with it the
+            outline color the fill stops at
+tolerance : per-channel distance at which a pixel still counts as ref
+flags     : FILL_BOUNDARY, FILL_CONNECT8
 
-            if (isColorSame(fc, getXY(p.x-1, p.y)) == 1) {
-                setXY(1, p.x-1, p.y, C);
-                insertPoint(pq, makePoint(p.x-1, p.y));
+Fills of 32bpp targets that grow past FILL_PARALLEL_PIXELS continue on
+worker threads; small ones never start any.
+*/
+void fillRegion(int x, int y, Color C, Color ref, int tolerance, int flags) {
+    FillState st;
+    queue pq_d;
+    queue* pq = &pq_d;
+
+    profileBegin(PROFILE_FILL);
+    traceBegin("fillRegion");
+    countStat(STAT_FILLS, 1);
+
+    st.s = getRenderTarget();
+    if (!st.s) {
+        st.s = getScreenSurface();
+    }
+    // the area setXY can write to
+    st.width = renderWidth() - 1;
+    st.height = renderHeight() - 1;
+    st.color = C;
+    st.pixel = packColor(C);
+    st.ref = packColor(ref);
+    st.tolerance = tolerance;
+    st.boundary = (flags & FILL_BOUNDARY) != 0;
+    st.connect8 = (flags & FILL_CONNECT8) != 0;
+    st.words = (st.width + 63) / 64;
+    st.visited = 0;
+    st.scratch = 0;
+    st.y0 = 0;
+    st.y1 = st.height;
+    st.band = 0;
+    st.pixels = 0;
+    st.spans = 0;
+    st.queued = 0;
+    if (x >= 0 && x < st.width && y >= 0 && y < st.height) {
+        st.visited = calloc((size_t)st.words * st.height, sizeof(uint64_t));
+        st.scratch = st.s ? 0 : malloc(st.width * sizeof(uint32_t));
+        if (st.visited && (st.s || st.scratch)) {
+            int n = st.s ? fillThreads(st.height) : 1;
+            initQueue(pq);
+            insertPoint(pq, makePoint(x, y));
+            st.queued++;
+            spanFill(&st, pq, n > 1 ? FILL_PARALLEL_PIXELS : LONG_MAX);
+            if (!queueEmpty(pq)) {
+                parallelFill(&st, pq, n);
             }
         }
     }
+    // fill workers exit right away, so their counts are added here
+    countStat(STAT_PIXELS_WRITTEN, st.pixels);
+    countStat(STAT_SPANS, st.spans);
+    countStat(STAT_QUEUE_ALLOCS, st.queued);
+    free(st.visited);
+    free(st.scratch);
+    traceEnd("fillRegion");
+    profileEnd(PROFILE_FILL);
+}
+
+/*
+Procedure floodfill
+
+fp_x    : fire point x
+fp_y    : fire point y
+C   : warna flood
+fc  : warna dasar yang akan ditimpa oleh warna flood
+
+Fills the 4-connected area of fc-colored pixels around the fire point.
+*/
+
+void floodFill(int fp_x, int fp_y, Color C, Color fc) {
+
+    if (isColorSame(C, fc)) {
+        return;
+    }
+    fillRegion(fp_x, fp_y, C, fc, COLOR_TOLERANCE, 0);
+}
+
+/*
+Fill everything around (x, y) up to pixels of the boundary color
+*/
+void boundaryFill(int x, int y, Color C, Color boundary) {
+    fillRegion(x, y, C, boundary, COLOR_TOLERANCE, FILL_BOUNDARY);
+}
+
+/*
+Fill the area around (x, y) whose channels are within tolerance of the
+color at (x, y); use a wide tolerance to swallow anti-aliased edges
+*/
+void toleranceFill(int x, int y, Color C, int tolerance) {
+    fillRegion(x, y, C, getXY(x, y), tolerance, 0);
 }
 
 void flood(int x, int y, Color newColor, Color oldColor) {
@@ -68,38 +481,335 @@ void flood(int x, int y, Color newColor, Color oldColor) {
     }
 }
 
-void raster_fill(int y_min, int y_max, int x_min, int x_max) {
+/*
+Run of pixels on one row of a rasterFill, either boundary color or gap
+*/
+typedef struct {
+    int l, r;
+    int boundary;
+} RasterRun;
 
-    for (int i = y_min; i < y_max; ++i) {
-        for (int j = x_min; j < x_max; ++j) {
+/*
+Rows of a rasterFill handled by one thread: first their runs are
+collected, later the inside gap runs are written
+*/
+typedef struct {
+    const Surface *s;       // pixels read; (ox, oy) is its top-left corner
+    int ox, oy;
+    int x0, x1;             // columns [x0, x1)
+    int y0, y1;             // rows of this band
+    uint32_t boundary;
+    RasterRun *runs;
+    int count;
+    int capacity;
+    int *rowStart;          // first run of every row, relative to this band
+    // write pass
+    Surface *dst;
+    const RasterRun *all;   // every band's runs, this band's start at base
+    const char *inside;
+    int base;
+    uint32_t pixel;
+    long pixels;
+    int spans;
+} RasterBand;
 
-        if (available[j][i] == 0)
-            if (isColorSame(getXY(j, i), setColor(255,255,255))) { // iteration one line in minimapand view
+static const uint32_t* rasterRow(const RasterBand *b, int y) {
+    return surfaceRow(b->s, y - b->oy) - b->ox;
+}
 
-                // Start here
-                if (isColorSame(getXY(j+1,i), setColor(255,255,255))) { // building
-                    while (isColorSame(getXY(j+1,i), setColor(255,255,255))) {
-                        j++;
-                    }
-                    j++;
-                } else if (isColorSame(getXY(j+1,i), setColor(0,0,0))) { // building not filled
-                    while (isColorSame(getXY(j+1,i), setColor(0,0,0))) {
-                        setXY(1, j, i, setColor(255,255,255));
-                        if (i >= 0 && j >= 0)
-                            available[i][j] = 1;
-                        j++;
+static void addRun(RasterBand *b, int l, int r, int boundary) {
+    if (b->count == b->capacity) {
+        int capacity = b->capacity ? b->capacity * 2 : 256;
+        RasterRun *runs = realloc(b->runs, capacity * sizeof(RasterRun));
+        if (!runs) {
+            b->count = -1;
+            return;
+        }
+        b->runs = runs;
+        b->capacity = capacity;
+    }
+    b->runs[b->count].l = l;
+    b->runs[b->count].r = r;
+    b->runs[b->count].boundary = boundary;
+    b->count++;
+}
+
+static void* rasterBandRuns(void *arg) {
+    RasterBand *b = arg;
+    for (int y = b->y0; y < b->y1 && b->count >= 0; y++) {
+        const uint32_t *row = rasterRow(b, y);
+        int boundary = 0;
+        b->rowStart[y - b->y0] = b->count;
+        for (int x = b->x0; x < b->x1 && b->count >= 0; boundary = !boundary) {
+            int n = matchRun(row + x, b->x1 - x, b->boundary, COLOR_TOLERANCE, boundary);
+            if (n > 0) {
+                addRun(b, x, x + n, boundary);
+            }
+            x += n;
+        }
+    }
+    return 0;
+}
+
+static void* rasterBandWrite(void *arg) {
+    RasterBand *b = arg;
+    for (int y = b->y0; y < b->y1; y++) {
+        int end = y + 1 < b->y1 ? b->rowStart[y + 1 - b->y0] : b->count;
+        for (int k = b->rowStart[y - b->y0]; k < end; k++) {
+            const RasterRun *run = &b->all[b->base + k];
+            if (!b->inside[b->base + k]) continue;
+            uint32_t *row = surfaceRow(b->dst, y);
+            for (int x = run->l; x < run->r; x++) {
+                row[x] = b->pixel;
+            }
+            b->pixels += run->r - run->l;
+            b->spans++;
+        }
+    }
+    return 0;
+}
+
+static int findRun(int *parent, int i) {
+    while (parent[i] != i) {
+        parent[i] = parent[parent[i]];
+        i = parent[i];
+    }
+    return i;
+}
+
+static void joinRuns(int *parent, int a, int b) {
+    a = findRun(parent, a);
+    b = findRun(parent, b);
+    if (a != b) parent[a > b ? a : b] = a > b ? b : a;
+}
+
+/*
+Decide which gap runs are inside. Runs are joined into regions (gaps
+4-connected) and outlines (boundary pixels 8-connected), and a 0-1 BFS
+from the outside counts the outlines crossed to reach every region; odd
+means inside. Index count stands for everything outside the rectangle.
+*/
+static int markInside(const RasterRun *runs, int count, const int *rowStart, int rows,
+                      int x0, int x1, char *inside) {
+    int out = count;
+    int *parent = malloc((count + 1) * sizeof(int));
+    int *degree = calloc(count + 2, sizeof(int));
+    int *edges = malloc(4 * (count + 1) * sizeof(int));
+    int *adjacent = malloc(4 * (count + 1) * sizeof(int));
+    int *dist = malloc((count + 1) * sizeof(int));
+    int *deque = malloc(2 * (4 * (count + 1) + 1) * sizeof(int));
+    int edgeCount = 0;
+    int ok = parent && degree && edges && adjacent && dist && deque;
+
+    for (int i = 0; ok && i <= count; i++) {
+        parent[i] = i;
+    }
+    for (int y = 0; ok && y < rows; y++) {
+        int end = rowStart[y + 1];
+        int j = rowStart[y + 1];
+        int nextEnd = y + 1 < rows ? rowStart[y + 2] : j;
+        for (int k = rowStart[y]; k < end; k++) {
+            const RasterRun *a = &runs[k];
+            // the rectangle's edges touch the outside
+            if (y == 0 || y == rows - 1 || a->l == x0 || a->r == x1) {
+                if (a->boundary) {
+                    edges[edgeCount++] = out;
+                    edges[edgeCount++] = k;
+                } else {
+                    joinRuns(parent, k, out);
+                }
+            }
+            if (k + 1 < end) {
+                edges[edgeCount++] = k;
+                edges[edgeCount++] = k + 1;
+            }
+            while (j < nextEnd && runs[j].r < a->l) j++;
+            for (int m = j; m < nextEnd && runs[m].l <= a->r; m++) {
+                const RasterRun *b = &runs[m];
+                if (a->boundary != b->boundary) continue;
+                if (a->boundary || (a->l < b->r && b->l < a->r)) {
+                    joinRuns(parent, k, m);
+                }
+            }
+        }
+    }
+
+    if (ok) {
+        // adjacency lists of the joined components, packed into one array
+        for (int e = 0; e < edgeCount; e++) {
+            edges[e] = findRun(parent, edges[e]);
+            degree[edges[e] + 1]++;
+        }
+        for (int i = 0; i <= count; i++) {
+            degree[i + 1] += degree[i];
+        }
+        int *fill = dist;
+        memcpy(fill, degree, (count + 1) * sizeof(int));
+        for (int e = 0; e < edgeCount; e += 2) {
+            adjacent[fill[edges[e]]++] = edges[e + 1];
+            adjacent[fill[edges[e + 1]]++] = edges[e];
+        }
+
+        int root = findRun(parent, out);
+        int head = 4 * (count + 1);
+        int tail = head;
+        for (int i = 0; i <= count; i++) {
+            dist[i] = 0x7FFFFFFF;
+        }
+        dist[root] = 0;
+        deque[tail++] = root;
+        while (head < tail) {
+            int u = deque[head++];
+            int uBoundary = u < count && runs[u].boundary;
+            for (int e = degree[u]; e < degree[u + 1]; e++) {
+                int v = adjacent[e];
+                int vBoundary = v < count && runs[v].boundary;
+                int cost = vBoundary && !uBoundary;
+                if (dist[u] + cost < dist[v]) {
+                    dist[v] = dist[u] + cost;
+                    if (cost) deque[tail++] = v; else deque[--head] = v;
+                }
+            }
+        }
+        for (int k = 0; k < count; k++) {
+            int d = dist[findRun(parent, k)];
+            inside[k] = !runs[k].boundary && d != 0x7FFFFFFF && (d & 1);
+        }
+    }
+    free(parent);
+    free(degree);
+    free(edges);
+    free(adjacent);
+    free(dist);
+    free(deque);
+    return ok;
+}
+
+/*
+Even-odd region fill: every area inside the rectangle [x_min, x_max) x
+[y_min, y_max) enclosed by an odd number of outlines of the boundary color
+is set to C, so holes of nested outlines stay open. Outlines that touch
+count as one. Rows are split into runs by bands on up to
+FILL_MAX_THREADS threads, the regions are resolved once for the whole
+rectangle, and the bands write the inside runs. The rectangle should
+enclose the outlines; what lies beyond it counts as outside.
+*/
+void rasterFill(int x_min, int y_min, int x_max, int y_max, Color boundary, Color C) {
+    int width = renderWidth() - 1;
+    int height = renderHeight() - 1;
+    if (x_min < 0) x_min = 0;
+    if (y_min < 0) y_min = 0;
+    if (x_max > width) x_max = width;
+    if (y_max > height) y_max = height;
+    if (x_min >= x_max || y_min >= y_max) {
+        return;
+    }
+
+    profileBegin(PROFILE_FILL);
+    traceBegin("rasterFill");
+    countStat(STAT_FILLS, 1);
+
+    int rows = y_max - y_min;
+    RasterBand bands[FILL_MAX_THREADS];
+    int *rowStart = malloc((rows + 2) * sizeof(int));
+    RasterRun *runs = 0;
+    char *inside = 0;
+    Surface *s = getRenderTarget();
+    Surface *copy = 0;
+    int n = 1;
+    int count = 0;
+
+    if (!s) {
+        s = getScreenSurface();
+    }
+    if (s) {
+        n = fillThreads(rows);
+    } else if ((copy = createSurface(x_max - x_min, rows))) {
+        // 16bpp and 8bpp screens: read the rows once into a surface
+        for (int y = y_min; y < y_max; y++) {
+            for (int x = x_min; x < x_max; x++) {
+                surfaceRow(copy, y - y_min)[x - x_min] = packColor(getXY(x, y));
+            }
+        }
+    }
+
+    for (int i = 0; i < n; i++) {
+        RasterBand *b = &bands[i];
+        memset(b, 0, sizeof(*b));
+        b->s = s ? s : copy;
+        b->ox = s ? 0 : x_min;
+        b->oy = s ? 0 : y_min;
+        b->x0 = x_min;
+        b->x1 = x_max;
+        b->y0 = y_min + (long)rows * i / n;
+        b->y1 = y_min + (long)rows * (i + 1) / n;
+        b->boundary = packColor(boundary);
+        b->rowStart = rowStart + (b->y0 - y_min);
+    }
+    if (rowStart && (s || copy)) {
+        runBands(bands, sizeof(RasterBand), n, rasterBandRuns);
+        // one run array and global row starts
+        for (int i = 0; i < n; i++) {
+            if (bands[i].count < 0) count = -1;
+            if (count >= 0) count += bands[i].count;
+        }
+        runs = count > 0 ? malloc(count * sizeof(RasterRun)) : 0;
+        inside = count > 0 ? malloc(count) : 0;
+    }
+    if (runs && inside) {
+        int base = 0;
+        for (int i = 0; i < n; i++) {
+            memcpy(runs + base, bands[i].runs, bands[i].count * sizeof(RasterRun));
+            for (int y = bands[i].y0; y < bands[i].y1; y++) {
+                rowStart[y - y_min] += base;
+            }
+            bands[i].base = 0;
+            bands[i].all = runs;
+            base += bands[i].count;
+        }
+        rowStart[rows] = count;
+        rowStart[rows + 1] = count;
+
+        if (markInside(runs, count, rowStart, rows, x_min, x_max, inside)) {
+            if (s) {
+                for (int i = 0; i < n; i++) {
+                    bands[i].dst = s;
+                    bands[i].inside = inside;
+                    bands[i].pixel = packColor(C);
+                    bands[i].count = i + 1 < n ? bands[i + 1].rowStart[0] : count;
+                }
+                runBands(bands, sizeof(RasterBand), n, rasterBandWrite);
+                for (int i = 0; i < n; i++) {
+                    // workers exit right away, so their counts are added here
+                    countStat(STAT_PIXELS_WRITTEN, bands[i].pixels);
+                    countStat(STAT_SPANS, bands[i].spans);
+                }
+            } else {
+                for (int y = 0; y < rows; y++) {
+                    for (int k = rowStart[y]; k < rowStart[y + 1]; k++) {
+                        if (!inside[k]) continue;
+                        for (int x = runs[k].l; x < runs[k].r; x++) {
+                            setXY(1, x, y_min + y, C);
+                        }
+                        countStat(STAT_SPANS, 1);
                     }
-                    j++;
                 }
             }
-            //  else if (isColorSame(getXY(j, i), setColor(255,0,0))) { // iteration one line in clipping window
-            //     while (!isColorSame(getXY(j+1, i), setColor(255,0,0)) && !isColorSame(getXY(j-1, i), setColor(255,0,0))) {
-            //         setXY(1, j+1, i, setColor(255,0,0));
-            //         available[i][j] = 1;
-            //     }
-                
-            // }
-            // else if (isColorSame(getXY(j, i), setColor(0,))) { // iteration one line in clipping window
         }
     }
-}
\ No newline at end of file
+
+    for (int i = 0; i < n; i++) {
+        free(bands[i].runs);
+    }
+    free(runs);
+    free(inside);
+    free(rowStart);
+    destroySurface(copy);
+    traceEnd("rasterFill");
+    profileEnd(PROFILE_FILL);
+}
+
+// Legacy name: fill inside white outlines with white
+void raster_fill(int y_min, int y_max, int x_min, int x_max) {
+    rasterFill(x_min, y_min, x_max, y_max, setColor(255,255,255), setColor(255,255,255));
+}
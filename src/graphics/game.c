@@ -1,6 +1,19 @@
 #include "framebuffer.h"
 #include <unistd.h>
 #include "game.h"
+#include "sprite.h"
+#include "atlas.h"
+#include "collision.h"
+
+// sprite cache slots
+#define SPRITE_ID_PLANE 0
+#define SPRITE_ID_TANK 1
+#define SPRITE_ID_PARACHUTE 2
+#define SPRITE_ID_BROKEN_COCKPIT 3
+#define SPRITE_ID_BROKEN_BODY 4
+#define SPRITE_ID_BROKEN_WINGS 5
+#define SPRITE_ID_BALING 6
+#define SPRITE_ID_TIRE 7
 
 typedef struct {
 	Point body[4];
@@ -44,7 +57,12 @@ typedef struct {
 	Color warnaBG;
 } Parachute;
 
-void drawBaling(int x, int y, int rotation){
+/*
+Propeller blades spinning around anc
+*/
+static void rasterizeBaling(Point anc, Color c, int rotation){
+		int x = anc.x - 20;
+		int y = anc.y - 20;
  		Point d[4];
 	 	d[0].x = 20+x;
 	 	d[0].y = 20+y;
@@ -64,46 +82,23 @@ void drawBaling(int x, int y, int rotation){
 	 	d[3] = rotatePoint(d[3],d[0],rotation);
 
 
-	 	Point d_fp;
-	 	d_fp.x = 20+x;
-	 	d_fp.y = 30+y;
-
-	 	drawPolygon(4,d,setColor(255,255,255),1);
-	 	//floodFill(d_fp.x, d_fp.y, setColor(255,255,255) , getXY(d_fp.x, d_fp.y));
-
-
-	 	Point d1[4];
-	 	d1[0] = rotatePoint(d[0],d[0],180);
-	 	d1[1] = rotatePoint(d[1],d[0],180);
-	 	d1[2] = rotatePoint(d[2],d[0],180);
-	 	d1[3] = rotatePoint(d[3],d[0],180);
-	 	Point d1_fp=rotatePoint(d_fp,d[0],180);
-	 	drawPolygon(4,d1,setColor(255,255,255),1);
-	 	//floodFill(d1_fp.x, d1_fp.y, setColor(255,255,255) , getXY(d1_fp.x, d1_fp.y));
-
-
-	 	Point d2[4];
-	 	d2[0] = rotatePoint(d[0],d[0],90);
-	 	d2[1] = rotatePoint(d[1],d[0],90);
-	 	d2[2] = rotatePoint(d[2],d[0],90);
-	 	d2[3] = rotatePoint(d[3],d[0],90);
-	 	Point d2_fp;
-	 	d2_fp = rotatePoint(d_fp,d[0],90);
-	 	drawPolygon(4,d2,setColor(255,255,255),1);
-	 	//floodFill(d2_fp.x, d2_fp.y, setColor(255,255,255) , getXY(d2_fp.x, d2_fp.y));
-
-	 	Point d3[4];
-	 	d3[0] = rotatePoint(d[0],d[0],-90);
-	 	d3[1] = rotatePoint(d[1],d[0],-90);
-	 	d3[2] = rotatePoint(d[2],d[0],-90);
-	 	d3[3] = rotatePoint(d[3],d[0],-90);
-	 	Point d3_fp = rotatePoint(d_fp,d[0],-90);
-	 	drawPolygon(4,d3,setColor(255,255,255),1);
-	 	//floodFill(d3_fp.x, d3_fp.y, setColor(255,255,255) , getXY(d3_fp.x, d3_fp.y));
-
+	 	// the four blades as one batch: d and its copies turned 180, 90
+	 	// and -90 degrees around the hub
+	 	static const int bladeTurns[4] = {0, 180, 90, -90};
+	 	static const int bladeOffsets[5] = {0, 4, 8, 12, 16};
+	 	const PolygonStyle bladeStyle = {setColor(255,255,255), 1};
+	 	Point blades[16];
+	 	int i, k;
+	 	for (i = 0; i < 4; i++) {
+	 		for (k = 0; k < 4; k++) {
+	 			blades[i*4 + k] = i == 0 ? d[k] : rotatePoint(d[k], d[0], bladeTurns[i]);
+	 		}
+	 	}
+	 	PolygonBatch batch = {blades, bladeOffsets, &bladeStyle, 1, 4};
+	 	drawPolygonBatch(&batch);
  	}
 
-void drawTire(Point P, int rot) {
+static void rasterizeTire(Point P, Color c, int rot) {
 	Color black = setColor(0,0,0);
 	drawCircle(10, P, 4, black);
 	Point velg[4];
@@ -126,52 +121,111 @@ void drawTire(Point P, int rot) {
 
 }
 
+static const SpriteShape balingSprite = {SPRITE_ID_BALING, 48, 48, 24, 24, rasterizeBaling};
+static const SpriteShape tireSprite = {SPRITE_ID_TIRE, 34, 34, 16, 16, rasterizeTire};
+
+RotationAtlas *balingAtlas = 0;
+RotationAtlas *tireAtlas = 0;
+int rotationAtlasSteps = ROTATION_ATLAS_STEPS;
+
+/*
+Pre-render the spinning parts (propeller, tire) in rotationSteps steps.
+More steps means smoother rotation at the cost of atlas memory.
+*/
+void initGameSprites(int rotationSteps) {
+	freeGameSprites();
+	rotationAtlasSteps = rotationSteps;
+	balingAtlas = createRotationAtlas(&balingSprite, rotationSteps, setColor(255,255,255));
+	tireAtlas = createRotationAtlas(&tireSprite, rotationSteps, setColor(0,0,0));
+}
 
-void drawPlane(Point p, int direction, Color planeColor) {
+void freeGameSprites(void) {
+	destroyRotationAtlas(balingAtlas);
+	destroyRotationAtlas(tireAtlas);
+	balingAtlas = 0;
+	tireAtlas = 0;
+	freeSpriteCache();
+}
+
+void drawBaling(int x, int y, int rotation) {
+	if (!balingAtlas) {
+		balingAtlas = createRotationAtlas(&balingSprite, rotationAtlasSteps, setColor(255,255,255));
+	}
+	if (!balingAtlas) {
+		// out of memory: rasterize this frame's propeller directly
+		rasterizeBaling(makePoint(x + 20, y + 20), setColor(255,255,255), rotation);
+		return;
+	}
+	drawRotated(balingAtlas, makePoint(x + 20, y + 20), rotation);
+}
+
+void drawTire(Point P, int rot) {
+	if (!tireAtlas) {
+		tireAtlas = createRotationAtlas(&tireSprite, rotationAtlasSteps, setColor(0,0,0));
+	}
+	if (!tireAtlas) {
+		rasterizeTire(P, setColor(0,0,0), rot);
+		return;
+	}
+	drawRotated(tireAtlas, P, rot);
+}
+
+
+/*
+Plane hull facing right with its anchor at p; drawPlane mirrors it
+at blit time for the other direction
+*/
+static void rasterizePlaneHull(Point p, Color planeColor, int angle) {
   Point offset;
   offset.x = -1169;
   offset.y = -75;
-  int mul = direction > 0 ? 1 : -1;
 
 	//Color planeColor = setColor(25,25,25);
 	//plane body
 	Point d[6];
-	d[0].x = p.x + (mul * (offset.x + 1250));
+	d[0].x = p.x + (offset.x + 1250);
 	d[0].y = p.y + ((offset.y + 50));
-	d[1].x = p.x + (mul * (offset.x + 1100));
+	d[1].x = p.x + (offset.x + 1100);
 	d[1].y = p.y + ((offset.y + 50));
-	d[2].x = p.x + (mul * (offset.x + 1054));
+	d[2].x = p.x + (offset.x + 1054);
 	d[2].y = p.y + ((offset.y + 90));
-	d[3].x = p.x + (mul * (offset.x + 1285));
+	d[3].x = p.x + (offset.x + 1285);
 	d[3].y = p.y + ((offset.y + 90));
-	d[4].x = p.x + (mul * (offset.x + 1285));
+	d[4].x = p.x + (offset.x + 1285);
 	d[4].y = p.y + ((offset.y + 25));
-	d[5].x = p.x + (mul * (offset.x + 1250));
+	d[5].x = p.x + (offset.x + 1250);
 	d[5].y = p.y + ((offset.y + 50));
 	drawPolygon(6,d,planeColor,2);
-	floodFill(p.x + (mul * (offset.x + 1250)), p.y + ((offset.y + 55)), planeColor, getXY(p.x + (mul * (offset.x + 1250)), p.y + ((offset.y + 55))));
+	floodFill(p.x + (offset.x + 1250), p.y + ((offset.y + 55)), planeColor, getXY(p.x + (offset.x + 1250), p.y + ((offset.y + 55))));
 
 
 	//plane wing
 	Point e[4];
-	e[0].x = p.x + (mul * (offset.x + 1120));
+	e[0].x = p.x + (offset.x + 1120);
 	e[0].y = p.y + ((offset.y + 80));
-	e[1].x = p.x + (mul * (offset.x + 1220));
+	e[1].x = p.x + (offset.x + 1220);
 	e[1].y = p.y + ((offset.y + 115));
-	e[2].x = p.x + (mul * (offset.x + 1280));
+	e[2].x = p.x + (offset.x + 1280);
 	e[2].y = p.y + ((offset.y + 120));
-	e[3].x = p.x + (mul * (offset.x + 1180));
+	e[3].x = p.x + (offset.x + 1180);
 	e[3].y = p.y + ((offset.y + 80));
 	drawPolygon(4,e,planeColor,2);
-	floodFill(p.x + (mul * (offset.x + 1220)), p.y + ((offset.y + 110))	 , planeColor, getXY(p.x + (mul * (offset.x + 1220)),p.y + ((offset.y + 110))));
+	floodFill(p.x + (offset.x + 1220), p.y + ((offset.y + 110))	 , planeColor, getXY(p.x + (offset.x + 1220),p.y + ((offset.y + 110))));
+}
+
+static const SpriteShape planeHullSprite = {SPRITE_ID_PLANE, 242, 112, 120, 56, rasterizePlaneHull};
+
+void drawPlane(Point p, int direction, Color planeColor) {
+	int mul = direction > 0 ? 1 : -1;
+
+	drawSprite(&planeHullSprite, p, direction, 0, planeColor);
 
 	drawBaling(p.x -40 , p.y + 10 , p.x - 120);
 	Point ptire = makePoint((p.x + (-mul*60)), p.y + 20);
 	drawTire(ptire, p.x - 120);
-
 }
 
-void drawBrokenPlaneCockpit(Point lastPoint) {
+static void rasterizeBrokenPlaneCockpit(Point lastPoint, Color c, int angle) {
 
 	BrokenPlane brokenPlane;
 
@@ -194,7 +248,7 @@ void drawBrokenPlaneCockpit(Point lastPoint) {
 	// front body - trapezoid
 }
 
-void drawBrokenPlaneBody(Point lastPoint) {
+static void rasterizeBrokenPlaneBody(Point lastPoint, Color c, int angle) {
 
 	BrokenPlane brokenPlane;
 
@@ -229,7 +283,7 @@ void drawBrokenPlaneBody(Point lastPoint) {
 	floodFill(lastPoint.x + 135, lastPoint.y + 20, black, getXY(lastPoint.x + 135, lastPoint.y + 20));
 }
 	// left right wing - trapezoid
-void drawBrokenPlaneWings(Point lastPoint) {
+static void rasterizeBrokenPlaneWings(Point lastPoint, Color c, int angle) {
 
 	BrokenPlane brokenPlane;
 
@@ -265,7 +319,7 @@ void drawBrokenPlaneWings(Point lastPoint) {
 
 }
 
-void drawParachute(Point anc) {
+static void rasterizeParachute(Point anc, Color c, int angle) {
 	Parachute Par;
 	Color black = setColor(0,0,0);
 	Color pink = setColor(255,192,203);
@@ -372,7 +426,7 @@ void drawParachute(Point anc) {
 	drawBresenhamLine(Par.legs[2],Par.legs[3],black,2);
 }
 
-void drawTank(Point anc) {
+static void rasterizeTank(Point anc, Color c, int angle) {
 
 	Tank t;
 	Color black = setColor(0,0,0);
@@ -441,9 +495,35 @@ void drawTank(Point anc) {
 }
 
 
+static const SpriteShape brokenPlaneCockpitSprite = {SPRITE_ID_BROKEN_COCKPIT, 56, 80, 50, 54, rasterizeBrokenPlaneCockpit};
+static const SpriteShape brokenPlaneBodySprite = {SPRITE_ID_BROKEN_BODY, 168, 94, 4, 50, rasterizeBrokenPlaneBody};
+static const SpriteShape brokenPlaneWingsSprite = {SPRITE_ID_BROKEN_WINGS, 208, 176, 4, 64, rasterizeBrokenPlaneWings};
+static const SpriteShape parachuteSprite = {SPRITE_ID_PARACHUTE, 214, 398, 130, 4, rasterizeParachute};
+static const SpriteShape tankSprite = {SPRITE_ID_TANK, 262, 162, 130, 150, rasterizeTank};
+
+void drawBrokenPlaneCockpit(Point lastPoint) {
+	drawSprite(&brokenPlaneCockpitSprite, lastPoint, 1, 0, setColor(0,0,0));
+}
+
+void drawBrokenPlaneBody(Point lastPoint) {
+	drawSprite(&brokenPlaneBodySprite, lastPoint, 1, 0, setColor(0,0,0));
+}
+
+void drawBrokenPlaneWings(Point lastPoint) {
+	drawSprite(&brokenPlaneWingsSprite, lastPoint, 1, 0, setColor(0,0,0));
+}
+
+void drawParachute(Point anc) {
+	drawSprite(&parachuteSprite, anc, 1, 0, setColor(0,0,0));
+}
+
+void drawTank(Point anc) {
+	drawSprite(&tankSprite, anc, 1, 0, setColor(0,0,0));
+}
+
+
 int cannonX;
 int cannonY;
-int destProjectile;
 
 void buildCannon(int x, int y, Color c) {
     cannonX = x;
@@ -451,45 +531,102 @@ void buildCannon(int x, int y, Color c) {
 	drawTank(makePoint(x, y));
 }
 
+volatile int fireRequested = 0;
+
+// collision outlines relative to the drawing anchor, matching
+// rasterizePlaneHull and drawProjectile
+static const Point planeBodyOutline[5] = {
+	{81, -25}, {-69, -25}, {-115, 15}, {116, 15}, {116, -50}
+};
+static const Point planeWingOutline[4] = {
+	{-49, 5}, {51, 40}, {111, 45}, {11, 5}
+};
+// drawn at -60, 20 and mirrored with the plane
+static const Point planeTireOutline[8] = {
+	{-53, 3}, {-43, 13}, {-43, 27}, {-53, 37}, {-67, 37}, {-77, 27}, {-77, 13}, {-67, 3}
+};
+// the propeller spins around -20, 30 (drawBaling draws it 20, 20 from
+// its anchor at -40, 10) and is not mirrored
+static const Point planePropellerOutline[8] = {
+	{-10, 6}, {4, 20}, {4, 40}, {-10, 54}, {-30, 54}, {-44, 40}, {-44, 20}, {-30, 6}
+};
+static const Point projectileOutline[7] = {
+	{0, 0}, {10, 15}, {15, 16}, {15, 40}, {-15, 40}, {-15, 16}, {-10, 15}
+};
+
+/*
+Fire the cannon. The projectile is launched by the entity update on the
+next simulation step.
+*/
 void shootCannon() {
-	int y = cannonY - 12;
-	int x = cannonX;
+	fireRequested = 1;
+}
+
+/*
+Returns 1 and the muzzle position if the cannon was fired since the last
+call
+*/
+int takeFireRequest(Point *muzzle) {
+	if (!fireRequested) {
+		return 0;
+	}
+	fireRequested = 0;
+	*muzzle = makePoint(cannonX, cannonY - 12);
+	return 1;
+}
+
+/*
+Projectile against the plane drawn at p facing direction
+*/
+int projectileHitsPlane(int x, int y, Point p, int direction) {
+	Point projectile[7];
+	Point body[5];
+	Point wing[4];
+	Point tire[8];
+	Point propeller[8];
+
+	transformPolygon(7, projectileOutline, makePoint(x, y), 1, projectile);
+	transformPolygon(5, planeBodyOutline, p, direction, body);
+	transformPolygon(4, planeWingOutline, p, direction, wing);
+	transformPolygon(8, planeTireOutline, p, direction, tire);
+	transformPolygon(8, planePropellerOutline, p, 1, propeller);
+	return polygonsIntersect(7, projectile, 5, body) || polygonsIntersect(7, projectile, 4, wing) ||
+	       polygonsIntersect(7, projectile, 8, tire) || polygonsIntersect(7, projectile, 8, propeller);
+}
+
+/*
+Projectile with its tip at p
+*/
+void drawProjectile(Point p) {
+	int x = p.x;
+	int y = p.y;
 	Color black;
 	black.R = 0;
 	black.G = 0;
 	black.B = 0;
 
-	while ((y > 80) && (destProjectile == 0)) {
-		Point head[3];
-	    Point body[4];
-
-	    head[0].x = x;
-	    head[1].x = x - 10;
-	    head[2].x = x + 10;
-	    head[0].y = y;
-	    head[1].y = y + 15;
-	    head[2].y = y + 15;
-
-	    drawPolygon(3, head, black, 2);
-	    floodFill(x, y+4, setColor(125, 0, 125), getXY(x, y+4));
-
-	    body[0].x = x - 15;
-	    body[1].x = x - 15;
-	    body[2].x = x + 15;
-	    body[3].x = x + 15;
-	    body[0].y = y + 16;
-	    body[1].y = y + 40;
-	    body[2].y = y + 40;
-	    body[3].y = y + 16;
-
-	    drawPolygon(4, body, black, 2);
-	    floodFill(x, y+18, setColor(60, 0, 60), getXY(x, y+18));
-
-		usleep(5000);
-		y -= 4;
-		if ((y < 240) && (y > 120) && (x > (planeloc-115)) && (x < (planeloc + 115))) {
-		    destProjectile = 1;
-		    endSign = 1;
-		}
-	}
+	Point head[3];
+	Point body[4];
+
+	head[0].x = x;
+	head[1].x = x - 10;
+	head[2].x = x + 10;
+	head[0].y = y;
+	head[1].y = y + 15;
+	head[2].y = y + 15;
+
+	drawPolygon(3, head, black, 2);
+	floodFill(x, y+4, setColor(125, 0, 125), getXY(x, y+4));
+
+	body[0].x = x - 15;
+	body[1].x = x - 15;
+	body[2].x = x + 15;
+	body[3].x = x + 15;
+	body[0].y = y + 16;
+	body[1].y = y + 40;
+	body[2].y = y + 40;
+	body[3].y = y + 16;
+
+	drawPolygon(4, body, black, 2);
+	floodFill(x, y+18, setColor(60, 0, 60), getXY(x, y+18));
 }
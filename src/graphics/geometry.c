@@ -1,5 +1,7 @@
 #include "framebuffer.h"
 #include "geometry.h"
+#include "profiler.h"
+#include "trace.h"
 #include <stdlib.h>
 
 
@@ -138,6 +140,8 @@ void plotVerticalLine (Point P1, Point P2, Color C, int W) {
 }
 
 void drawBresenhamLine (Point P1, Point P2, Color C, int W) {
+	profileBegin(PROFILE_GEOMETRY);
+	traceBegin("drawBresenhamLine");
 	if (P1.x > P2.x) {
 		swapPoint(&P1,&P2);
 	}
@@ -154,6 +158,8 @@ void drawBresenhamLine (Point P1, Point P2, Color C, int W) {
 		//printf("P Slope\n");
 		plotSlopPositiveLine(P1,P2,C,W);
 	}
+	traceEnd("drawBresenhamLine");
+	profileEnd(PROFILE_GEOMETRY);
 }
 
 void drawPolyline (int n, Point *P, Color C, int W) {
@@ -173,16 +179,39 @@ W	: weight (ketebalan) garis yang diinginkan
 */
 
 void drawPolygon (int n, Point *P, Color C, int W) {
+	profileBegin(PROFILE_GEOMETRY);
+	traceBegin("drawPolygon");
 	drawPolyline(n, P, C, W);
 	drawBresenhamLine(P[n-1], P[0], C, W);
+	traceEnd("drawPolygon");
+	profileEnd(PROFILE_GEOMETRY);
+}
+
+/*
+Outline every polygon of batch, the same as one drawPolygon call each but
+timed and traced once for the whole batch
+*/
+void drawPolygonBatch (const PolygonBatch *batch) {
+	profileBegin(PROFILE_GEOMETRY);
+	traceBegin("drawPolygonBatch");
+	for (int i = 0; i < batch->count; i++) {
+		const Point *P = batch->vertices + batch->offsets[i];
+		int n = batch->offsets[i + 1] - batch->offsets[i];
+		const PolygonStyle *style = batchStyle(batch, i);
+		for (int k = 0; k < n; k++) {
+			drawBresenhamLine(P[k == 0 ? n - 1 : k - 1], P[k], style->color, style->width);
+		}
+	}
+	traceEnd("drawPolygonBatch");
+	profileEnd(PROFILE_GEOMETRY);
 }
 
 /*
 initialPoint : explosion location in the screen
 scaleFactor : size of the explosion
-*P isi dengan array explosionPoint
+*P isi dengan array explosionPoint (tidak diubah)
 */
-void drawExplosion (Point initialPoint, int n, Point *P, int scaleFactor) {
+void drawExplosion (Point initialPoint, int n, const Point *P, int scaleFactor) {
 	/*Orange Color*/
 	Color C;
 	C.R = 218;
@@ -190,20 +219,15 @@ void drawExplosion (Point initialPoint, int n, Point *P, int scaleFactor) {
 	C.B = 53;
 
 	int i;
-
-	if (scaleFactor >1) {
-		for (i = 0; i<n; i++) {
-			P[i].x *= scaleFactor;
-			P[i].y *= scaleFactor;
-		}
-	}
+	// work on a copy: P is usually the shared explosionPoint template
+	Point Q[n];
 
 	for (i = 0; i<n; i++) {
-		P[i].x += initialPoint.x;
-		P[i].y +=initialPoint.y;
+		Q[i].x = P[i].x * (scaleFactor > 1 ? scaleFactor : 1) + initialPoint.x;
+		Q[i].y = P[i].y * (scaleFactor > 1 ? scaleFactor : 1) + initialPoint.y;
 	}
 
-	drawPolygon(n, P, C, 2);
+	drawPolygon(n, Q, C, 2);
 }
 
 void plot8pixel (Point P, int p, int q, int W, Color C) {
@@ -241,6 +265,8 @@ void drawCircle (int radius, Point P, int W, Color C) {
     q = radius;
     d = 3 - 2*radius;
 
+    profileBegin(PROFILE_GEOMETRY);
+    traceBegin("drawCircle");
     plot8pixel(P, p, q, W, C);
 
     while (p < q) {
@@ -255,6 +281,8 @@ void drawCircle (int radius, Point P, int W, Color C) {
 
         plot8pixel(P, p, q, W, C);
     }
+    traceEnd("drawCircle");
+    profileEnd(PROFILE_GEOMETRY);
 }
 
 
@@ -269,6 +297,8 @@ void drawCircleHalf (int radius, Point P, int W, Color C) {
     q = radius;
     d = 3 - 2*radius;
 
+    profileBegin(PROFILE_GEOMETRY);
+    traceBegin("drawCircleHalf");
     plot4pixel(P, p, q, W, C);
 
     while (p < q) {
@@ -283,46 +313,19 @@ void drawCircleHalf (int radius, Point P, int W, Color C) {
 
         plot4pixel(P, p, q, W, C);
     }
+    traceEnd("drawCircleHalf");
+    profileEnd(PROFILE_GEOMETRY);
 }
 
 
 void drawRect(int x, int y, int w, int h, Color c) {
+  profileBegin(PROFILE_GEOMETRY);
+  traceBegin("drawRect");
   for (int i = 0; i < w; i++) {
     for (int j = 0; j < h; j++) {
       setXY(1, x+i, y+j, c);
     }
   }
-}
-// Bridge functions for new interface compatibility
-void draw_line_between_points(struct coordinate_point start_point, 
-                             struct coordinate_point end_point,
-                             struct color_rgba line_color, 
-                             int line_thickness) {
-    drawBresenhamLine(start_point, end_point, line_color, line_thickness);
-}
-
-void draw_connected_polyline(int vertex_count, struct coordinate_point *vertex_array, 
-                            struct color_rgba line_color, int line_thickness) {
-    drawPolyline(vertex_count, vertex_array, line_color, line_thickness);
-}
-
-void draw_filled_polygon(int vertex_count, struct coordinate_point *vertex_array, 
-                        struct color_rgba fill_color, int outline_thickness) {
-    drawPolygon(vertex_count, vertex_array, fill_color, outline_thickness);
-}
-
-void draw_circle_outline(int radius, struct coordinate_point center_point, 
-                        int line_thickness, struct color_rgba circle_color) {
-    drawCircle(radius, center_point, line_thickness, circle_color);
-}
-
-void draw_semicircle_outline(int radius, struct coordinate_point center_point, 
-                            int line_thickness, struct color_rgba circle_color) {
-    drawCircleHalf(radius, center_point, line_thickness, circle_color);
-}
-
-void draw_filled_rectangle(int top_left_x, int top_left_y, 
-                          int rectangle_width, int rectangle_height,
-                          struct color_rgba fill_color) {
-    drawRect(top_left_x, top_left_y, rectangle_width, rectangle_height, fill_color);
+  traceEnd("drawRect");
+  profileEnd(PROFILE_GEOMETRY);
 }
@@ -0,0 +1,75 @@
+#include "framebuffer.h"
+#include "sprite.h"
+
+Sprite spriteCache[MAX_SPRITE_SHAPES][SPRITE_ROTATION_BUCKETS];
+
+int rotationBucket(int angle) {
+    angle %= 360;
+    if (angle < 0) angle += 360;
+    return ((angle * SPRITE_ROTATION_BUCKETS + 180) / 360) % SPRITE_ROTATION_BUCKETS;
+}
+
+/*
+Return the cached sprite of shape at angle (rounded to the nearest
+rotation bucket), rasterizing it first if needed.
+The sprite is re-rasterized when asked for a different color.
+*/
+Sprite* getSprite(const SpriteShape *shape, int angle, Color c) {
+    int bucket = rotationBucket(angle);
+    Sprite *sprite = &spriteCache[shape->id][bucket];
+
+    if (sprite->surface && packColor(sprite->color) == packColor(c)) {
+        return sprite;
+    }
+
+    if (!sprite->surface) {
+        sprite->surface = createSurface(shape->width, shape->height);
+        if (!sprite->surface) {
+            return 0;
+        }
+    } else {
+        clearSurface(sprite->surface, SURFACE_COLORKEY);
+    }
+    sprite->anchorX = shape->anchorX;
+    sprite->anchorY = shape->anchorY;
+    sprite->color = c;
+
+    Surface *previous = getRenderTarget();
+    setRenderTarget(sprite->surface);
+    shape->draw(make_point(shape->anchorX, shape->anchorY), c, bucket * 360 / SPRITE_ROTATION_BUCKETS);
+    setRenderTarget(previous);
+
+    return sprite;
+}
+
+/*
+Draw shape with its anchor at p
+
+direction : negative mirrors the sprite horizontally around p
+angle     : rotation in degrees handed to the shape's draw function
+c         : shape color
+*/
+void drawSprite(const SpriteShape *shape, Point p, int direction, int angle, Color c) {
+    Sprite *sprite = getSprite(shape, angle, c);
+    if (!sprite) {
+        shape->draw(p, c, angle);
+        return;
+    }
+
+    if (direction < 0) {
+        blitSurface(sprite->surface, p.x - (sprite->surface->width - 1 - sprite->anchorX),
+                    p.y - sprite->anchorY, BLIT_COLORKEY | BLIT_FLIP_X);
+    } else {
+        blitSurface(sprite->surface, p.x - sprite->anchorX, p.y - sprite->anchorY, BLIT_COLORKEY);
+    }
+}
+
+void freeSpriteCache(void) {
+    int i, j;
+    for (i = 0; i < MAX_SPRITE_SHAPES; i++) {
+        for (j = 0; j < SPRITE_ROTATION_BUCKETS; j++) {
+            destroySurface(spriteCache[i][j].surface);
+            spriteCache[i][j].surface = 0;
+        }
+    }
+}
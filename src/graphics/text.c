@@ -0,0 +1,474 @@
+#include "text.h"
+#include "framebuffer.h"
+#include "profiler.h"
+#include "trace.h"
+#include "stats.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PSF1_MAGIC0 0x36
+#define PSF1_MAGIC1 0x04
+#define PSF1_MODE512 0x01
+#define PSF1_MODEHASTAB 0x06
+#define PSF1_SEPARATOR 0xFFFF
+#define PSF1_STARTSEQ 0xFFFE
+#define PSF2_MAGIC 0x864ab572
+#define PSF2_HAS_UNICODE_TABLE 0x01
+#define PSF2_SEPARATOR 0xFF
+#define PSF2_STARTSEQ 0xFE
+#define NO_GLYPH 0xFFFF
+
+// glyphs decoded per batch by drawText
+#define TEXT_BATCH 128
+
+/*
+Built-in 8x8 font for ASCII 32..126 (the public domain IBM PC BIOS
+shapes), bit i of each byte is column i
+*/
+static const uint8_t builtinGlyphs[95][8] = {
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, {0x18, 0x3C, 0x3C, 0x18, 0x18, 0x00, 0x18, 0x00},
+    {0x36, 0x36, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, {0x36, 0x36, 0x7F, 0x36, 0x7F, 0x36, 0x36, 0x00},
+    {0x0C, 0x3E, 0x03, 0x1E, 0x30, 0x1F, 0x0C, 0x00}, {0x00, 0x63, 0x33, 0x18, 0x0C, 0x66, 0x63, 0x00},
+    {0x1C, 0x36, 0x1C, 0x6E, 0x3B, 0x33, 0x6E, 0x00}, {0x06, 0x06, 0x03, 0x00, 0x00, 0x00, 0x00, 0x00},
+    {0x18, 0x0C, 0x06, 0x06, 0x06, 0x0C, 0x18, 0x00}, {0x06, 0x0C, 0x18, 0x18, 0x18, 0x0C, 0x06, 0x00},
+    {0x00, 0x66, 0x3C, 0xFF, 0x3C, 0x66, 0x00, 0x00}, {0x00, 0x0C, 0x0C, 0x3F, 0x0C, 0x0C, 0x00, 0x00},
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0x0C, 0x0C, 0x06}, {0x00, 0x00, 0x00, 0x3F, 0x00, 0x00, 0x00, 0x00},
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0x0C, 0x0C, 0x00}, {0x60, 0x30, 0x18, 0x0C, 0x06, 0x03, 0x01, 0x00},
+    {0x3E, 0x63, 0x73, 0x7B, 0x6F, 0x67, 0x3E, 0x00}, {0x0C, 0x0E, 0x0C, 0x0C, 0x0C, 0x0C, 0x3F, 0x00},
+    {0x1E, 0x33, 0x30, 0x1C, 0x06, 0x33, 0x3F, 0x00}, {0x1E, 0x33, 0x30, 0x1C, 0x30, 0x33, 0x1E, 0x00},
+    {0x38, 0x3C, 0x36, 0x33, 0x7F, 0x30, 0x78, 0x00}, {0x3F, 0x03, 0x1F, 0x30, 0x30, 0x33, 0x1E, 0x00},
+    {0x1C, 0x06, 0x03, 0x1F, 0x33, 0x33, 0x1E, 0x00}, {0x3F, 0x33, 0x30, 0x18, 0x0C, 0x0C, 0x0C, 0x00},
+    {0x1E, 0x33, 0x33, 0x1E, 0x33, 0x33, 0x1E, 0x00}, {0x1E, 0x33, 0x33, 0x3E, 0x30, 0x18, 0x0E, 0x00},
+    {0x00, 0x0C, 0x0C, 0x00, 0x00, 0x0C, 0x0C, 0x00}, {0x00, 0x0C, 0x0C, 0x00, 0x00, 0x0C, 0x0C, 0x06},
+    {0x18, 0x0C, 0x06, 0x03, 0x06, 0x0C, 0x18, 0x00}, {0x00, 0x00, 0x3F, 0x00, 0x00, 0x3F, 0x00, 0x00},
+    {0x06, 0x0C, 0x18, 0x30, 0x18, 0x0C, 0x06, 0x00}, {0x1E, 0x33, 0x30, 0x18, 0x0C, 0x00, 0x0C, 0x00},
+    {0x3E, 0x63, 0x7B, 0x7B, 0x7B, 0x03, 0x1E, 0x00}, {0x0C, 0x1E, 0x33, 0x33, 0x3F, 0x33, 0x33, 0x00},
+    {0x3F, 0x66, 0x66, 0x3E, 0x66, 0x66, 0x3F, 0x00}, {0x3C, 0x66, 0x03, 0x03, 0x03, 0x66, 0x3C, 0x00},
+    {0x1F, 0x36, 0x66, 0x66, 0x66, 0x36, 0x1F, 0x00}, {0x7F, 0x46, 0x16, 0x1E, 0x16, 0x46, 0x7F, 0x00},
+    {0x7F, 0x46, 0x16, 0x1E, 0x16, 0x06, 0x0F, 0x00}, {0x3C, 0x66, 0x03, 0x03, 0x73, 0x66, 0x7C, 0x00},
+    {0x33, 0x33, 0x33, 0x3F, 0x33, 0x33, 0x33, 0x00}, {0x1E, 0x0C, 0x0C, 0x0C, 0x0C, 0x0C, 0x1E, 0x00},
+    {0x78, 0x30, 0x30, 0x30, 0x33, 0x33, 0x1E, 0x00}, {0x67, 0x66, 0x36, 0x1E, 0x36, 0x66, 0x67, 0x00},
+    {0x0F, 0x06, 0x06, 0x06, 0x46, 0x66, 0x7F, 0x00}, {0x63, 0x77, 0x7F, 0x7F, 0x6B, 0x63, 0x63, 0x00},
+    {0x63, 0x67, 0x6F, 0x7B, 0x73, 0x63, 0x63, 0x00}, {0x1C, 0x36, 0x63, 0x63, 0x63, 0x36, 0x1C, 0x00},
+    {0x3F, 0x66, 0x66, 0x3E, 0x06, 0x06, 0x0F, 0x00}, {0x1E, 0x33, 0x33, 0x33, 0x3B, 0x1E, 0x38, 0x00},
+    {0x3F, 0x66, 0x66, 0x3E, 0x36, 0x66, 0x67, 0x00}, {0x1E, 0x33, 0x07, 0x0E, 0x38, 0x33, 0x1E, 0x00},
+    {0x3F, 0x2D, 0x0C, 0x0C, 0x0C, 0x0C, 0x1E, 0x00}, {0x33, 0x33, 0x33, 0x33, 0x33, 0x33, 0x3F, 0x00},
+    {0x33, 0x33, 0x33, 0x33, 0x33, 0x1E, 0x0C, 0x00}, {0x63, 0x63, 0x63, 0x6B, 0x7F, 0x77, 0x63, 0x00},
+    {0x63, 0x63, 0x36, 0x1C, 0x1C, 0x36, 0x63, 0x00}, {0x33, 0x33, 0x33, 0x1E, 0x0C, 0x0C, 0x1E, 0x00},
+    {0x7F, 0x63, 0x31, 0x18, 0x4C, 0x66, 0x7F, 0x00}, {0x1E, 0x06, 0x06, 0x06, 0x06, 0x06, 0x1E, 0x00},
+    {0x03, 0x06, 0x0C, 0x18, 0x30, 0x60, 0x40, 0x00}, {0x1E, 0x18, 0x18, 0x18, 0x18, 0x18, 0x1E, 0x00},
+    {0x08, 0x1C, 0x36, 0x63, 0x00, 0x00, 0x00, 0x00}, {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xFF},
+    {0x0C, 0x0C, 0x18, 0x00, 0x00, 0x00, 0x00, 0x00}, {0x00, 0x00, 0x1E, 0x30, 0x3E, 0x33, 0x6E, 0x00},
+    {0x07, 0x06, 0x06, 0x3E, 0x66, 0x66, 0x3B, 0x00}, {0x00, 0x00, 0x1E, 0x33, 0x03, 0x33, 0x1E, 0x00},
+    {0x38, 0x30, 0x30, 0x3E, 0x33, 0x33, 0x6E, 0x00}, {0x00, 0x00, 0x1E, 0x33, 0x3F, 0x03, 0x1E, 0x00},
+    {0x1C, 0x36, 0x06, 0x0F, 0x06, 0x06, 0x0F, 0x00}, {0x00, 0x00, 0x6E, 0x33, 0x33, 0x3E, 0x30, 0x1F},
+    {0x07, 0x06, 0x36, 0x6E, 0x66, 0x66, 0x67, 0x00}, {0x0C, 0x00, 0x0E, 0x0C, 0x0C, 0x0C, 0x1E, 0x00},
+    {0x30, 0x00, 0x30, 0x30, 0x30, 0x33, 0x33, 0x1E}, {0x07, 0x06, 0x66, 0x36, 0x1E, 0x36, 0x67, 0x00},
+    {0x0E, 0x0C, 0x0C, 0x0C, 0x0C, 0x0C, 0x1E, 0x00}, {0x00, 0x00, 0x33, 0x7F, 0x7F, 0x6B, 0x63, 0x00},
+    {0x00, 0x00, 0x1F, 0x33, 0x33, 0x33, 0x33, 0x00}, {0x00, 0x00, 0x1E, 0x33, 0x33, 0x33, 0x1E, 0x00},
+    {0x00, 0x00, 0x3B, 0x66, 0x66, 0x3E, 0x06, 0x0F}, {0x00, 0x00, 0x6E, 0x33, 0x33, 0x3E, 0x30, 0x78},
+    {0x00, 0x00, 0x3B, 0x6E, 0x66, 0x06, 0x0F, 0x00}, {0x00, 0x00, 0x3E, 0x03, 0x1E, 0x30, 0x1F, 0x00},
+    {0x08, 0x0C, 0x3E, 0x0C, 0x0C, 0x2C, 0x18, 0x00}, {0x00, 0x00, 0x33, 0x33, 0x33, 0x33, 0x6E, 0x00},
+    {0x00, 0x00, 0x33, 0x33, 0x33, 0x1E, 0x0C, 0x00}, {0x00, 0x00, 0x63, 0x6B, 0x7F, 0x7F, 0x36, 0x00},
+    {0x00, 0x00, 0x63, 0x36, 0x1C, 0x36, 0x63, 0x00}, {0x00, 0x00, 0x33, 0x33, 0x33, 0x3E, 0x30, 0x1F},
+    {0x00, 0x00, 0x3F, 0x19, 0x0C, 0x26, 0x3F, 0x00}, {0x38, 0x0C, 0x0C, 0x07, 0x0C, 0x0C, 0x38, 0x00},
+    {0x18, 0x18, 0x18, 0x00, 0x18, 0x18, 0x18, 0x00}, {0x07, 0x0C, 0x0C, 0x38, 0x0C, 0x0C, 0x07, 0x00},
+    {0x6E, 0x3B, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+};
+
+/*
+Size of one string, remembered by measureText
+*/
+typedef struct {
+    const Font *font;
+    int length;
+    int width;
+    int height;
+    char text[TEXT_CACHE_LENGTH];
+} TextMeasure;
+
+Font defaultFont;
+uint32_t defaultFontMasks[95 * 8];
+int defaultFontReady = 0;
+__thread TextMeasure textMeasures[TEXT_CACHE_SIZE];
+
+/*
+Next codepoint of UTF-8 text. A malformed byte counts as one U+FFFD.
+*/
+static uint32_t nextCodepoint(const char **text) {
+    const unsigned char *s = (const unsigned char *)*text;
+    uint32_t c = s[0];
+    if (c < 0x80) {
+        *text += 1;
+        return c;
+    }
+    int n = (c >> 5) == 6 ? 1 : (c >> 4) == 14 ? 2 : (c >> 3) == 30 ? 3 : -1;
+    if (n < 0) {
+        *text += 1;
+        return 0xFFFD;
+    }
+    c &= 0x3F >> n;
+    for (int i = 1; i <= n; i++) {
+        if ((s[i] & 0xC0) != 0x80) {
+            *text += 1;
+            return 0xFFFD;
+        }
+        c = c << 6 | (s[i] & 0x3F);
+    }
+    *text += n + 1;
+    return c;
+}
+
+static int compareMappings(const void *a, const void *b) {
+    uint32_t x = ((const FontMapping *)a)->codepoint, y = ((const FontMapping *)b)->codepoint;
+    return x < y ? -1 : x > y;
+}
+
+/*
+Record that codepoint is drawn with glyph; the first mapping wins
+*/
+static int mapCodepoint(Font *font, uint32_t codepoint, int glyph, int *capacity) {
+    if (codepoint < FONT_DIRECT_MAP) {
+        if (font->direct[codepoint] == NO_GLYPH) font->direct[codepoint] = glyph;
+        return 1;
+    }
+    if (font->mappingCount == *capacity) {
+        *capacity = *capacity ? *capacity * 2 : 256;
+        FontMapping *grown = realloc(font->mappings, *capacity * sizeof(FontMapping));
+        if (!grown) return 0;
+        font->mappings = grown;
+    }
+    font->mappings[font->mappingCount].codepoint = codepoint;
+    font->mappings[font->mappingCount].glyph = glyph;
+    font->mappingCount++;
+    return 1;
+}
+
+/*
+Sort the mappings and pick the fallback glyph, '?' when the font has one
+*/
+static void finishMappings(Font *font) {
+    if (font->mappingCount) {
+        qsort(font->mappings, font->mappingCount, sizeof(FontMapping), compareMappings);
+    }
+    font->fallback = font->direct['?'] != NO_GLYPH ? font->direct['?'] : 0;
+    for (int c = 0; c < FONT_DIRECT_MAP; c++) {
+        if (font->direct[c] == NO_GLYPH) font->direct[c] = font->fallback;
+    }
+}
+
+/*
+The 8x8 font compiled into the engine, always available. Not freed.
+*/
+Font* builtinFont(void) {
+    if (!defaultFontReady) {
+        memset(&defaultFont, 0, sizeof(defaultFont));
+        defaultFont.width = 8;
+        defaultFont.height = 8;
+        defaultFont.glyphCount = 95;
+        defaultFont.masks = defaultFontMasks;
+        defaultFont.builtin = 1;
+        memset(defaultFont.direct, 0xFF, sizeof(defaultFont.direct));
+        for (int g = 0; g < 95; g++) {
+            for (int r = 0; r < 8; r++) {
+                defaultFontMasks[g * 8 + r] = builtinGlyphs[g][r];
+            }
+            defaultFont.direct[32 + g] = g;
+        }
+        finishMappings(&defaultFont);
+        defaultFontReady = 1;
+    }
+    return &defaultFont;
+}
+
+static uint32_t readLE32(const unsigned char *p) {
+    return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+/*
+Glyph masks from PSF bitmaps: rows of rowBytes bytes, leftmost pixel in
+the high bit of the first byte
+*/
+static int readGlyphs(Font *font, const unsigned char *bitmaps, int rowBytes) {
+    font->masks = malloc((size_t)font->glyphCount * font->height * sizeof(uint32_t));
+    if (!font->masks) return 0;
+    for (long r = 0; r < (long)font->glyphCount * font->height; r++) {
+        const unsigned char *row = bitmaps + r * rowBytes;
+        uint32_t mask = 0;
+        for (int i = 0; i < font->width; i++) {
+            if (row[i >> 3] & (0x80 >> (i & 7))) mask |= 1u << i;
+        }
+        font->masks[r] = mask;
+    }
+    return 1;
+}
+
+/*
+PSF1: 8 pixels wide, 256 or 512 glyphs, optional table of UCS-2 values
+*/
+static int parsePSF1(Font *font, const unsigned char *data, long size) {
+    int mode = data[2];
+    font->width = 8;
+    font->height = data[3];
+    font->glyphCount = mode & PSF1_MODE512 ? 512 : 256;
+    long tableStart = 4 + (long)font->glyphCount * font->height;
+    if (font->height == 0 || size < tableStart || !readGlyphs(font, data + 4, 1)) {
+        return 0;
+    }
+    int capacity = 0;
+    if (!(mode & PSF1_MODEHASTAB)) {
+        for (int g = 0; g < font->glyphCount; g++) {
+            if (!mapCodepoint(font, g, g, &capacity)) return 0;
+        }
+        return 1;
+    }
+    int g = 0, inSequence = 0;
+    for (long p = tableStart; p + 1 < size && g < font->glyphCount; p += 2) {
+        unsigned value = data[p] | data[p + 1] << 8;
+        if (value == PSF1_SEPARATOR) {
+            g++;
+            inSequence = 0;
+        } else if (value == PSF1_STARTSEQ) {
+            inSequence = 1;
+        } else if (!inSequence && !mapCodepoint(font, value, g, &capacity)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/*
+PSF2: any size up to FONT_MAX_WIDTH wide, optional table of UTF-8 strings
+*/
+static int parsePSF2(Font *font, const unsigned char *data, long size) {
+    if (size < 32) return 0;
+    uint32_t headerSize = readLE32(data + 8);
+    uint32_t flags = readLE32(data + 12);
+    uint32_t length = readLE32(data + 16);
+    uint32_t charSize = readLE32(data + 20);
+    font->height = readLE32(data + 24);
+    font->width = readLE32(data + 28);
+    int rowBytes = (font->width + 7) / 8;
+    if (font->width < 1 || font->width > FONT_MAX_WIDTH || font->height < 1 || font->height > 256 ||
+        length < 1 || length > NO_GLYPH || charSize != (uint32_t)rowBytes * font->height ||
+        headerSize > size || (size - headerSize) / charSize < length) {
+        return 0;
+    }
+    font->glyphCount = length;
+    if (!readGlyphs(font, data + headerSize, rowBytes)) {
+        return 0;
+    }
+    int capacity = 0;
+    if (!(flags & PSF2_HAS_UNICODE_TABLE)) {
+        for (int g = 0; g < font->glyphCount; g++) {
+            if (!mapCodepoint(font, g, g, &capacity)) return 0;
+        }
+        return 1;
+    }
+    const char *p = (const char *)data + headerSize + (long)length * charSize;
+    const char *end = (const char *)data + size;
+    int g = 0, inSequence = 0;
+    while (p < end && g < font->glyphCount) {
+        unsigned char c = *p;
+        if (c == PSF2_SEPARATOR) {
+            p++;
+            g++;
+            inSequence = 0;
+        } else if (c == PSF2_STARTSEQ) {
+            p++;
+            inSequence = 1;
+        } else {
+            uint32_t codepoint = nextCodepoint(&p);
+            if (!inSequence && !mapCodepoint(font, codepoint, g, &capacity)) return 0;
+        }
+    }
+    return 1;
+}
+
+/*
+Load a PSF1 or PSF2 console font (as found in /usr/share/consolefonts,
+uncompressed). Returns 0 if the file cannot be read or is malformed.
+*/
+Font* loadFont(const char *path) {
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        perror("Error: cannot open font");
+        return 0;
+    }
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    // zero padded, so decoding a truncated UTF-8 table stops at the end
+    unsigned char *data = size > 4 ? calloc(1, size + 4) : 0;
+    Font *font = calloc(1, sizeof(Font));
+    if (!data || !font || fread(data, 1, size, f) != (size_t)size) {
+        fprintf(stderr, "Error: cannot read font %s\n", path);
+        fclose(f);
+        free(data);
+        free(font);
+        return 0;
+    }
+    fclose(f);
+
+    memset(font->direct, 0xFF, sizeof(font->direct));
+    int ok = 0;
+    if (data[0] == PSF1_MAGIC0 && data[1] == PSF1_MAGIC1) {
+        ok = parsePSF1(font, data, size);
+    } else if (readLE32(data) == PSF2_MAGIC) {
+        ok = parsePSF2(font, data, size);
+    }
+    free(data);
+    if (!ok) {
+        fprintf(stderr, "Error: %s is not a usable PSF font\n", path);
+        freeFont(font);
+        return 0;
+    }
+    finishMappings(font);
+    return font;
+}
+
+void freeFont(Font *font) {
+    if (font && !font->builtin) {
+        free(font->masks);
+        free(font->mappings);
+        free(font);
+    }
+}
+
+/*
+Glyph drawn for codepoint
+*/
+int fontGlyph(const Font *font, uint32_t codepoint) {
+    if (codepoint < FONT_DIRECT_MAP) {
+        return font->direct[codepoint];
+    }
+    int lo = 0, hi = font->mappingCount - 1;
+    while (lo <= hi) {
+        int mid = (lo + hi) / 2;
+        uint32_t c = font->mappings[mid].codepoint;
+        if (c == codepoint) return font->mappings[mid].glyph;
+        if (c < codepoint) lo = mid + 1;
+        else hi = mid - 1;
+    }
+    return font->fallback;
+}
+
+/*
+Blit n glyphs side by side with their top left at (x, y), one pixel row
+at a time across the whole run. Each glyph row is a mask, so only set
+pixels are visited. Returns the pixels written.
+*/
+static long drawGlyphRun(const Font *font, Surface *dst, int x, int y, const uint16_t *glyphs, int n, Color C) {
+    long pixels = 0;
+    int j0 = 0, j1 = font->height;
+    int width = dst ? dst->width : renderWidth();
+    if (dst) {
+        if (y < 0) j0 = -y;
+        if (y + j1 > dst->height) j1 = dst->height - y;
+    }
+    // glyphs wholly outside the target are skipped
+    int first = x < 0 ? -x / font->width : 0;
+    int last = n;
+    if (x + (long)n * font->width > width) last = (width - x + font->width - 1) / font->width;
+    if (last > n) last = n;
+
+    uint32_t pixel = packColor(C);
+    for (int j = j0; j < j1; j++) {
+        uint32_t *row = dst ? surfaceRow(dst, y + j) : 0;
+        for (int g = first; g < last; g++) {
+            int gx = x + g * font->width;
+            uint32_t mask = font->masks[glyphs[g] * font->height + j];
+            if (gx < 0) mask &= ~0u << -gx;
+            if (width - gx < 32) mask &= (1u << (width - gx)) - 1;
+            if (!dst) {
+                // no packed target, go through setXY
+                for (; mask; mask &= mask - 1) {
+                    setXY(1, gx + __builtin_ctz(mask), y + j, C);
+                }
+                continue;
+            }
+            for (; mask; mask &= mask - 1) {
+                row[gx + __builtin_ctz(mask)] = pixel;
+                pixels++;
+            }
+        }
+    }
+    return pixels;
+}
+
+/*
+Draw UTF-8 text with its top left at (x, y); '\n' starts a new line.
+Glyphs are decoded in batches and blitted as 1-bit masks straight into
+the render target.
+*/
+void drawText(const Font *font, int x, int y, const char *text, Color C) {
+    Surface *dst = getRenderTarget();
+    uint16_t glyphs[TEXT_BATCH];
+    long pixels = 0;
+    int penX = x;
+    if (!dst) {
+        dst = getScreenSurface();
+    }
+
+    profileBegin(PROFILE_BLIT);
+    traceBegin("drawText");
+    while (*text) {
+        int n = 0;
+        while (*text && *text != '\n' && n < TEXT_BATCH) {
+            glyphs[n++] = fontGlyph(font, nextCodepoint(&text));
+        }
+        pixels += drawGlyphRun(font, dst, penX, y, glyphs, n, C);
+        penX += n * font->width;
+        if (*text == '\n') {
+            text++;
+            penX = x;
+            y += font->height;
+        }
+    }
+    countStat(STAT_PIXELS_WRITTEN, pixels);
+    traceEnd("drawText");
+    profileEnd(PROFILE_BLIT);
+}
+
+/*
+Size of the box drawText covers for text. Strings up to TEXT_CACHE_LENGTH
+bytes are cached per thread in a slot picked by a hash of the bytes and
+checked against a copy of them, so labels measured every frame skip the
+UTF-8 decoding and line scanning.
+*/
+void measureText(const Font *font, const char *text, int *width, int *height) {
+    uint32_t hash = 2166136261u;
+    int length = 0;
+    for (const char *p = text; *p; p++, length++) {
+        hash = (hash ^ (unsigned char)*p) * 16777619u;
+    }
+    TextMeasure scratch;
+    TextMeasure *m = &scratch;
+    int cached = length < TEXT_CACHE_LENGTH;
+    if (cached) {
+        m = &textMeasures[hash % TEXT_CACHE_SIZE];
+        // a zeroed slot has no font, so it never matches
+        cached = m->font == font && m->length == length && !memcmp(m->text, text, length);
+    }
+    if (!cached) {
+        int columns = 0, widest = 0, lines = 1;
+        for (const char *p = text; *p;) {
+            if (*p == '\n') {
+                p++;
+                lines++;
+                columns = 0;
+                continue;
+            }
+            nextCodepoint(&p);
+            if (++columns > widest) widest = columns;
+        }
+        m->font = font;
+        m->length = length;
+        m->width = widest * font->width;
+        m->height = lines * font->height;
+        if (m != &scratch) memcpy(m->text, text, length);
+    }
+    if (width) *width = m->width;
+    if (height) *height = m->height;
+}
@@ -0,0 +1,464 @@
+#include "framebuffer.h"
+#include "tiles.h"
+#include "geometry.h"
+#include "profiler.h"
+#include "trace.h"
+#include "stats.h"
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+
+/*
+One binned primitive: a command of the list, or a single edge of a
+polygon command so long outlines only land in the tiles they cross
+*/
+typedef struct {
+    int command;
+    int edge;           // -1 = the whole command
+} TileItem;
+
+typedef struct {
+    int tile;
+    TileItem item;
+} TileRef;
+
+/*
+Tile bins of one pass. Pass one appends a (tile, item) ref for every
+tile an item may touch, then the refs are counting-sorted by tile so
+each tile keeps its items in submission order. Kept between calls, so a
+steady scene does not allocate.
+*/
+typedef struct {
+    int width, height;          // render target size
+    int tilesX, tilesY;
+    TileRef *refs;
+    int refCount;
+    int refCapacity;
+    int failed;                 // out of memory while binning
+    int *start;                 // tilesX * tilesY + 1 offsets into items
+    TileItem *items;
+    int tileCapacity;
+    int itemCapacity;
+} TileBins;
+
+/*
+One worker of pass two. Tiles are taken from a shared counter, so busy
+and empty parts of the screen even out across workers.
+*/
+typedef struct {
+    CommandList *list;
+    TileBins *bins;
+    Surface *target;
+    int *next;
+    long pixels;        // counted here, added to the stats by the caller
+} TileWorker;
+
+TileBins tileBins;
+int tileThreadCount = 0;
+
+/*
+Pass two runs on a pool of threads started on first use and kept, so a
+frame does not create threads (or their per-thread trace buffers). The
+caller is worker 0; a pass bumps tileGeneration to wake pool threads
+1..tileActive-1 and waits on tileDone until each has finished.
+*/
+TileWorker tileWorkers[TILE_MAX_THREADS];
+pthread_t tilePool[TILE_MAX_THREADS];
+unsigned long tileSeen[TILE_MAX_THREADS];      // last generation each pool thread took
+int tilePoolSize = 1;                           // the caller plus the threads started
+int tilePoolRunning = 0;
+unsigned long tileGeneration = 0;
+int tileActive = 0;
+int tilePending = 0;
+pthread_mutex_t tileLock = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t tileWake = PTHREAD_COND_INITIALIZER;
+pthread_cond_t tileDone = PTHREAD_COND_INITIALIZER;
+
+static void addRef(TileBins *b, int tile, TileItem item) {
+    if (b->refCount == b->refCapacity) {
+        int capacity = b->refCapacity ? b->refCapacity * 2 : 1024;
+        TileRef *grown = realloc(b->refs, capacity * sizeof(TileRef));
+        if (!grown) {
+            b->failed = 1;
+            return;
+        }
+        b->refs = grown;
+        b->refCapacity = capacity;
+    }
+    b->refs[b->refCount].tile = tile;
+    b->refs[b->refCount].item = item;
+    b->refCount++;
+}
+
+/*
+Every tile of the pixel box [x0, x1] x [y0, y1], clipped to the target
+*/
+static void binBox(TileBins *b, int x0, int y0, int x1, int y1, TileItem item) {
+    if (x0 < 0) x0 = 0;
+    if (y0 < 0) y0 = 0;
+    if (x1 >= b->width) x1 = b->width - 1;
+    if (y1 >= b->height) y1 = b->height - 1;
+    if (x0 > x1 || y0 > y1) {
+        return;
+    }
+    for (int ty = y0 >> TILE_SHIFT; ty <= y1 >> TILE_SHIFT; ty++) {
+        for (int tx = x0 >> TILE_SHIFT; tx <= x1 >> TILE_SHIFT; tx++) {
+            addRef(b, ty * b->tilesX + tx, item);
+        }
+    }
+}
+
+/*
+Tiles a W wide line from p to q may touch. drawBresenhamLine puts a WxW
+square at each step and strays at most one pixel from the exact line, so
+per tile column the line's rows are taken one pixel wider on each side.
+*/
+static void binLine(TileBins *b, Point p, Point q, int W, TileItem item) {
+    int lx = p.x < q.x ? p.x : q.x, hx = p.x < q.x ? q.x : p.x;
+    int ly = p.y < q.y ? p.y : q.y, hy = p.y < q.y ? q.y : p.y;
+    if (W < 1) W = 1;
+    if (p.x == q.x || p.y == q.y) {
+        binBox(b, lx, ly, hx + W - 1, hy + W - 1, item);
+        return;
+    }
+    int first = lx < 0 ? 0 : lx >> TILE_SHIFT;
+    int last = (hx + W - 1 < b->width ? hx + W - 1 : b->width - 1) >> TILE_SHIFT;
+    for (int tx = first; tx <= last; tx++) {
+        int xa = (tx << TILE_SHIFT) - (W - 1), xb = (tx << TILE_SHIFT) + TILE_SIZE - 1;
+        if (xa < lx) xa = lx;
+        if (xb > hx) xb = hx;
+        if (xa > xb) continue;
+        long ya = p.y + (long)(xa - 1 - p.x) * (q.y - p.y) / (q.x - p.x);
+        long yb = p.y + (long)(xb + 1 - p.x) * (q.y - p.y) / (q.x - p.x);
+        if (ya > yb) {
+            long t = ya;
+            ya = yb;
+            yb = t;
+        }
+        ya -= 2;
+        yb += 2;
+        if (ya < ly) ya = ly;
+        if (yb > hy) yb = hy;
+        binBox(b, tx << TILE_SHIFT, ya, (tx << TILE_SHIFT) + TILE_SIZE - 1, yb + W - 1, item);
+    }
+}
+
+static void binCommand(TileBins *b, CommandList *l, int i) {
+    RenderCommand *cmd = &l->commands[i];
+    TileItem item = {i, -1};
+    switch (cmd->type) {
+        case CMD_BACKGROUND:
+            binBox(b, 0, 0, b->width - 1, b->height - 1, item);
+            break;
+        case CMD_LINE:
+            binLine(b, cmd->line.p1, cmd->line.p2, cmd->width, item);
+            break;
+        case CMD_POLYGON: {
+            Point *P = l->vertices + cmd->polygon.vertexOffset;
+            int n = cmd->polygon.count;
+            for (item.edge = 0; item.edge < n; item.edge++) {
+                binLine(b, P[item.edge], P[(item.edge + 1) % n], cmd->width, item);
+            }
+            break;
+        }
+        case CMD_RECT:
+            binBox(b, cmd->rect.x, cmd->rect.y, cmd->rect.x + cmd->rect.w - 1,
+                   cmd->rect.y + cmd->rect.h - 1, item);
+            break;
+    }
+}
+
+/*
+Pass one for commands [first, end). Returns 0 when out of memory.
+*/
+static int binCommands(TileBins *b, CommandList *l, int first, int end, Surface *target) {
+    b->width = target->width;
+    b->height = target->height;
+    b->tilesX = (target->width + TILE_SIZE - 1) >> TILE_SHIFT;
+    b->tilesY = (target->height + TILE_SIZE - 1) >> TILE_SHIFT;
+    b->refCount = 0;
+    b->failed = 0;
+    for (int i = first; i < end; i++) {
+        binCommand(b, l, i);
+    }
+
+    int tiles = b->tilesX * b->tilesY;
+    if (tiles + 1 > b->tileCapacity) {
+        int *grown = realloc(b->start, (tiles + 1) * sizeof(int));
+        if (!grown) return 0;
+        b->start = grown;
+        b->tileCapacity = tiles + 1;
+    }
+    if (b->refCount > b->itemCapacity) {
+        TileItem *grown = realloc(b->items, b->refCount * sizeof(TileItem));
+        if (!grown) return 0;
+        b->items = grown;
+        b->itemCapacity = b->refCount;
+    }
+    if (b->failed) {
+        return 0;
+    }
+
+    memset(b->start, 0, (tiles + 1) * sizeof(int));
+    for (int i = 0; i < b->refCount; i++) {
+        b->start[b->refs[i].tile + 1]++;
+    }
+    for (int t = 0; t < tiles; t++) {
+        b->start[t + 1] += b->start[t];
+    }
+    // scatter with start[] as the cursors, which leaves start[t] at the
+    // end of tile t, then shift them back
+    for (int i = 0; i < b->refCount; i++) {
+        b->items[b->start[b->refs[i].tile]++] = b->refs[i].item;
+    }
+    for (int t = tiles; t > 0; t--) {
+        b->start[t] = b->start[t - 1];
+    }
+    b->start[0] = 0;
+    return 1;
+}
+
+static void drawItem(CommandList *l, TileItem item, const TileTarget *t) {
+    RenderCommand *cmd = &l->commands[item.command];
+    if (item.edge >= 0) {
+        Point *P = l->vertices + cmd->polygon.vertexOffset;
+        drawBresenhamLine(P[item.edge], P[(item.edge + 1) % cmd->polygon.count], cmd->color, cmd->width);
+    } else if (cmd->type == CMD_RECT) {
+        // only the part inside the tile, the rest would be clipped anyway
+        int x0 = cmd->rect.x > t->x ? cmd->rect.x : t->x;
+        int y0 = cmd->rect.y > t->y ? cmd->rect.y : t->y;
+        int x1 = cmd->rect.x + cmd->rect.w, y1 = cmd->rect.y + cmd->rect.h;
+        if (x1 > t->x + t->surface->width) x1 = t->x + t->surface->width;
+        if (y1 > t->y + t->surface->height) y1 = t->y + t->surface->height;
+        if (x0 < x1 && y0 < y1) {
+            drawRect(x0, y0, x1 - x0, y1 - y0, cmd->color);
+        }
+    } else {
+        executeCommand(l, cmd);
+    }
+}
+
+static inline int isBackground(const CommandList *l, TileItem item) {
+    return item.edge < 0 && l->commands[item.command].type == CMD_BACKGROUND;
+}
+
+/*
+Pass two: render whole tiles in a TILE_SIZE x TILE_SIZE buffer on this
+thread's stack, which stays in L1/L2, and copy each finished tile to the
+target once. Tiles whose items start with a background skip reading
+the target, and tiles holding only a background skip the buffer too.
+*/
+static void* tileWorkerLoop(void *arg) {
+    TileWorker *w = arg;
+    TileBins *b = w->bins;
+    uint32_t buffer[TILE_SIZE * TILE_SIZE];
+    Surface tile = {.width = TILE_SIZE, .height = TILE_SIZE, .pitch = TILE_SIZE, .pixels = buffer};
+    TileTarget t = {.surface = &tile};
+    int tiles = b->tilesX * b->tilesY;
+    int i;
+
+    setTileTarget(&t);
+    while ((i = __atomic_fetch_add(w->next, 1, __ATOMIC_RELAXED)) < tiles) {
+        int first = b->start[i], end = b->start[i + 1];
+        if (first == end) continue;
+        t.x = (i % b->tilesX) << TILE_SHIFT;
+        t.y = (i / b->tilesX) << TILE_SHIFT;
+        tile.width = b->width - t.x < TILE_SIZE ? b->width - t.x : TILE_SIZE;
+        tile.height = b->height - t.y < TILE_SIZE ? b->height - t.y : TILE_SIZE;
+
+        int k = end - 1;
+        while (k > first && !isBackground(w->list, b->items[k])) {
+            k--;
+        }
+        if (k == end - 1 && isBackground(w->list, b->items[k])) {
+            // nothing drawn over the background: clear the target directly
+            uint32_t pixel = packColor(w->list->commands[b->items[k].command].color);
+            for (int j = 0; j < tile.height; j++) {
+                uint32_t *row = surfaceRow(w->target, t.y + j) + t.x;
+                for (int x = 0; x < tile.width; x++) {
+                    row[x] = pixel;
+                }
+            }
+            t.pixels += (long)tile.width * tile.height;
+            continue;
+        }
+        if (!isBackground(w->list, b->items[k])) {
+            for (int j = 0; j < tile.height; j++) {
+                memcpy(surfaceRow(&tile, j), surfaceRow(w->target, t.y + j) + t.x, tile.width * sizeof(uint32_t));
+            }
+        }
+        for (; k < end; k++) {
+            drawItem(w->list, b->items[k], &t);
+        }
+        for (int j = 0; j < tile.height; j++) {
+            memcpy(surfaceRow(w->target, t.y + j) + t.x, surfaceRow(&tile, j), tile.width * sizeof(uint32_t));
+        }
+    }
+    setTileTarget(0);
+    w->pixels = t.pixels;
+    return NULL;
+}
+
+/*
+Threads for pass two: at most n, with at least TILE_MIN_TILES busy
+tiles each
+*/
+static int tileThreads(const TileBins *b, int n) {
+    int busy = 0;
+    for (int t = 0; t < b->tilesX * b->tilesY; t++) {
+        busy += b->start[t + 1] > b->start[t];
+    }
+    if (n > busy / TILE_MIN_TILES) n = busy / TILE_MIN_TILES;
+    return n < 1 ? 1 : n;
+}
+
+/*
+Threads used by executeCommandsTiled, 0 = one per core. With a single
+thread the commands are drawn directly.
+*/
+void setTileThreads(int n) {
+    tileThreadCount = n;
+}
+
+static void* tilePoolLoop(void *arg) {
+    int index = (int)(long)arg;
+    traceThreadName("tiles");
+
+    pthread_mutex_lock(&tileLock);
+    while (1) {
+        while (tilePoolRunning && tileSeen[index] == tileGeneration) {
+            pthread_cond_wait(&tileWake, &tileLock);
+        }
+        if (!tilePoolRunning) {
+            break;
+        }
+        tileSeen[index] = tileGeneration;
+        if (index >= tileActive) {
+            continue;
+        }
+        pthread_mutex_unlock(&tileLock);
+        tileWorkerLoop(&tileWorkers[index]);
+        pthread_mutex_lock(&tileLock);
+        if (--tilePending == 0) {
+            pthread_cond_signal(&tileDone);
+        }
+    }
+    pthread_mutex_unlock(&tileLock);
+    return NULL;
+}
+
+/*
+Grow the pool to n threads counting the caller. Returns how many there
+are, which is fewer when a thread cannot be created.
+*/
+static int startTileThreads(int n) {
+    pthread_mutex_lock(&tileLock);
+    tilePoolRunning = 1;
+    while (tilePoolSize < n) {
+        tileSeen[tilePoolSize] = tileGeneration;
+        if (pthread_create(&tilePool[tilePoolSize], NULL, tilePoolLoop, (void *)(long)tilePoolSize)) {
+            break;
+        }
+        tilePoolSize++;
+    }
+    pthread_mutex_unlock(&tileLock);
+    return tilePoolSize < n ? tilePoolSize : n;
+}
+
+/*
+Stop the tile threads. executeCommandsTiled starts them again when
+next called.
+*/
+void terminateTileThreads(void) {
+    pthread_mutex_lock(&tileLock);
+    tilePoolRunning = 0;
+    pthread_cond_broadcast(&tileWake);
+    pthread_mutex_unlock(&tileLock);
+    for (int i = 1; i < tilePoolSize; i++) {
+        pthread_join(tilePool[i], NULL);
+    }
+    tilePoolSize = 1;
+}
+
+static void renderTiles(CommandList *l, int first, int end, Surface *target) {
+    int next = 0;
+    long pixels = 0;
+
+    long n = tileThreadCount > 0 ? tileThreadCount : sysconf(_SC_NPROCESSORS_ONLN);
+    if (n > TILE_MAX_THREADS) n = TILE_MAX_THREADS;
+    if (n >= 2) {
+        n = binCommands(&tileBins, l, first, end, target) ? startTileThreads(tileThreads(&tileBins, n)) : 0;
+    }
+    if (n < 2) {
+        // out of memory, or too little work to share: draw straight into
+        // the target, which beats one thread walking every tile
+        for (int i = first; i < end; i++) {
+            executeCommand(l, &l->commands[i]);
+        }
+        return;
+    }
+    for (int i = 0; i < n; i++) {
+        tileWorkers[i].list = l;
+        tileWorkers[i].bins = &tileBins;
+        tileWorkers[i].target = target;
+        tileWorkers[i].next = &next;
+        tileWorkers[i].pixels = 0;
+    }
+
+    pthread_mutex_lock(&tileLock);
+    tileActive = n;
+    tilePending = n - 1;
+    tileGeneration++;
+    pthread_cond_broadcast(&tileWake);
+    pthread_mutex_unlock(&tileLock);
+
+    tileWorkerLoop(&tileWorkers[0]);
+
+    pthread_mutex_lock(&tileLock);
+    while (tilePending > 0) {
+        pthread_cond_wait(&tileDone, &tileLock);
+    }
+    pthread_mutex_unlock(&tileLock);
+
+    for (int i = 0; i < n; i++) {
+        pixels += tileWorkers[i].pixels;
+    }
+    countStat(STAT_PIXELS_WRITTEN, pixels);
+}
+
+/*
+Run every command of l like executeCommands, binning the drawing into
+screen tiles first. Fills, blits and presents read or write across
+tiles, so they split the list and run on their own between tiled passes. Only one
+thread may call this at a time (the bins are shared). Falls back to
+executeCommands when the target is not a packed surface or there is only
+one thread to render on.
+*/
+void executeCommandsTiled(CommandList *l) {
+    Surface *target = getRenderTarget();
+    if (!target) target = getScreenSurface();
+    if (!target) {
+        executeCommands(l);
+        return;
+    }
+
+    traceBegin("executeCommandsTiled");
+    int first = 0;
+    while (first < l->count) {
+        int end = first;
+        while (end < l->count && l->commands[end].type != CMD_FILL && l->commands[end].type != CMD_BLIT
+               && l->commands[end].type != CMD_PRESENT) {
+            end++;
+        }
+        if (end > first) {
+            renderTiles(l, first, end, target);
+        }
+        if (end < l->count) {
+            executeCommand(l, &l->commands[end]);
+        }
+        first = end + 1;
+    }
+    traceEnd("executeCommandsTiled");
+    resetCommandList(l);
+}
@@ -1,11 +1,13 @@
 #include "framebuffer.h"
 #include "transform.h"
+#include "profiler.h"
 #include <math.h>
 #include <stdlib.h>
 
 #define PI acos(-1)
 
 Point rotatePoint(Point p ,Point pivot, float angle){
+	profileBegin(PROFILE_TRANSFORM);
 	float s = sin(angle * PI / 180.0);
 	float c = cos(angle * PI / 180.0);
 	p.x -= pivot.x;
@@ -16,16 +18,20 @@ Point rotatePoint(Point p ,Point pivot, float angle){
 
 	p.x = xnew + pivot.x;
 	p.y = ynew + pivot.y;
+	profileEnd(PROFILE_TRANSFORM);
 	return p;
 
 }
 
 //return rotated muliple point
 Point* rotateMany(Point p, Point* p1, double angle, int length) {
+  profileBegin(PROFILE_TRANSFORM);
   Point *temp = (Point*) malloc(length*sizeof(Point));
-  for (int i = 0; i < length; i++) {
+  for (int i = 0; temp && i < length; i++) {
     temp[i] = rotatePoint(p1[i], p, angle);
   }
+  profileEnd(PROFILE_TRANSFORM);
+  return temp;
 }
 
 
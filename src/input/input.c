@@ -0,0 +1,205 @@
+#include "input.h"
+#include "trace.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <signal.h>
+#include <termios.h>
+#include <poll.h>
+#include <pthread.h>
+#include <time.h>
+
+// how long the reader waits for the rest of an escape sequence, and for
+// a stop request
+#define INPUT_POLL_MS 50
+
+/*
+Single-producer single-consumer ring: the reader thread pushes at head,
+the render loop pops at tail
+*/
+InputEvent inputQueue[INPUT_QUEUE_SIZE];
+unsigned int inputHead = 0;
+unsigned int inputTail = 0;
+unsigned long inputDropped = 0;
+
+struct termios savedTermios;
+int rawModeSet = 0;
+// dispositions replaced while the terminal is raw
+struct sigaction savedSigint, savedSigterm;
+volatile int inputRunning = 0;
+pthread_t inputReader;
+
+uint64_t inputTimestamp(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * (uint64_t)1000000000 + ts.tv_nsec;
+}
+
+void pushInputEvent(int key) {
+    unsigned int head = __atomic_load_n(&inputHead, __ATOMIC_RELAXED);
+    unsigned int tail = __atomic_load_n(&inputTail, __ATOMIC_ACQUIRE);
+    if (head - tail == INPUT_QUEUE_SIZE) {
+        inputDropped++;
+        return;
+    }
+    inputQueue[head & (INPUT_QUEUE_SIZE - 1)].key = key;
+    inputQueue[head & (INPUT_QUEUE_SIZE - 1)].timestamp = inputTimestamp();
+    __atomic_store_n(&inputHead, head + 1, __ATOMIC_RELEASE);
+}
+
+/*
+Pop the oldest pending event. Returns 0 when the queue is empty.
+Only one thread may consume.
+*/
+int pollInputEvent(InputEvent *ev) {
+    unsigned int tail = __atomic_load_n(&inputTail, __ATOMIC_RELAXED);
+    unsigned int head = __atomic_load_n(&inputHead, __ATOMIC_ACQUIRE);
+    if (head == tail) {
+        return 0;
+    }
+    *ev = inputQueue[tail & (INPUT_QUEUE_SIZE - 1)];
+    __atomic_store_n(&inputTail, tail + 1, __ATOMIC_RELEASE);
+    traceInstant("handleKey");
+    return 1;
+}
+
+unsigned long droppedInputEvents(void) {
+    return inputDropped;
+}
+
+/*
+Escape sequence decoder. ESC [ <params> <final> and ESC O <final> are
+collapsed into one event carrying the final byte, which is what the
+*_KEYPRESS arrow constants are defined as.
+*/
+#define DECODE_NORMAL 0
+#define DECODE_ESCAPE 1
+#define DECODE_CSI 2
+
+void *inputReaderLoop(void *arg) {
+    int state = DECODE_NORMAL;
+    unsigned char buf[64];
+    struct pollfd pfd;
+    pfd.fd = STDIN_FILENO;
+    pfd.events = POLLIN;
+    traceThreadName("input");
+
+    while (inputRunning) {
+        int ready = poll(&pfd, 1, INPUT_POLL_MS);
+        if (ready == 0) {
+            // a lone ESC that was not followed by a sequence
+            if (state != DECODE_NORMAL) {
+                pushInputEvent(ESCAPE_KEYPRESS);
+                state = DECODE_NORMAL;
+            }
+            continue;
+        }
+        if (ready < 0) {
+            continue;
+        }
+
+        int n = read(STDIN_FILENO, buf, sizeof(buf));
+        if (n <= 0) {
+            if (n == 0) break;  // stdin closed
+            continue;
+        }
+
+        traceBegin("decodeInput");
+        for (int i = 0; i < n; i++) {
+            unsigned char c = buf[i];
+            if (state == DECODE_NORMAL) {
+                if (c == ESCAPE_KEYPRESS) state = DECODE_ESCAPE;
+                else pushInputEvent(c);
+            } else if (state == DECODE_ESCAPE) {
+                if (c == '[' || c == 'O') {
+                    state = DECODE_CSI;
+                } else {
+                    pushInputEvent(ESCAPE_KEYPRESS);
+                    if (c == ESCAPE_KEYPRESS) {
+                        state = DECODE_ESCAPE;
+                    } else {
+                        pushInputEvent(c);
+                        state = DECODE_NORMAL;
+                    }
+                }
+            } else {
+                // skip parameter bytes until the final byte
+                if (c >= 0x40 && c <= 0x7E) {
+                    pushInputEvent(c);
+                    state = DECODE_NORMAL;
+                }
+            }
+        }
+        traceEnd("decodeInput");
+    }
+    return NULL;
+}
+
+void restoreTerminal(void) {
+    if (rawModeSet) {
+        tcsetattr(STDIN_FILENO, TCSANOW, &savedTermios);
+        sigaction(SIGINT, &savedSigint, 0);
+        sigaction(SIGTERM, &savedSigterm, 0);
+        rawModeSet = 0;
+    }
+}
+
+/*
+Ctrl-C and kill skip atexit, so restore echo and line mode here, then
+put back the previous disposition and re-raise. Only async-signal-safe
+calls.
+*/
+void terminalSignalHandler(int sig) {
+    tcsetattr(STDIN_FILENO, TCSANOW, &savedTermios);
+    sigaction(sig, sig == SIGINT ? &savedSigint : &savedSigterm, 0);
+    raise(sig);
+}
+
+void installTerminalSignalHandlers(void) {
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = terminalSignalHandler;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGINT, &sa, &savedSigint);
+    sigaction(SIGTERM, &sa, &savedSigterm);
+    // a signal the parent told us to ignore stays ignored
+    if (savedSigint.sa_handler == SIG_IGN) sigaction(SIGINT, &savedSigint, 0);
+    if (savedSigterm.sa_handler == SIG_IGN) sigaction(SIGTERM, &savedSigterm, 0);
+}
+
+/*
+Put the terminal in raw mode once and start the reader thread.
+Returns 0 on success.
+*/
+int initInput(void) {
+    struct termios raw;
+    if (tcgetattr(STDIN_FILENO, &savedTermios) == 0) {
+        raw = savedTermios;
+        raw.c_lflag &= ~(ICANON | ECHO);
+        raw.c_cc[VMIN] = 1;
+        raw.c_cc[VTIME] = 0;
+        if (tcsetattr(STDIN_FILENO, TCSANOW, &raw) == 0) {
+            rawModeSet = 1;
+            installTerminalSignalHandlers();
+            atexit(restoreTerminal);
+        }
+    }
+
+    inputRunning = 1;
+    if (pthread_create(&inputReader, NULL, inputReaderLoop, NULL)) {
+        fprintf(stderr, "Error creating input thread\n");
+        inputRunning = 0;
+        restoreTerminal();
+        return -1;
+    }
+    return 0;
+}
+
+void terminateInput(void) {
+    if (inputRunning) {
+        inputRunning = 0;
+        pthread_join(inputReader, NULL);
+    }
+    restoreTerminal();
+}
@@ -18,7 +18,3 @@ int getch(void) {
 int get_next_keyboard_input(void) {
     return getch();
 }
-
-int get_next_keyboard_input(void) {
-    return getch();  // Use existing getch function
-}
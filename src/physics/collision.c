@@ -0,0 +1,124 @@
+#include "collision.h"
+#include <stdlib.h>
+
+AABB polygonBounds(int n, const Point *P) {
+    AABB box;
+    box.xMin = box.xMax = P[0].x;
+    box.yMin = box.yMax = P[0].y;
+    for (int i = 1; i < n; i++) {
+        if (P[i].x < box.xMin) box.xMin = P[i].x;
+        if (P[i].x > box.xMax) box.xMax = P[i].x;
+        if (P[i].y < box.yMin) box.yMin = P[i].y;
+        if (P[i].y > box.yMax) box.yMax = P[i].y;
+    }
+    return box;
+}
+
+int aabbOverlap(AABB a, AABB b) {
+    return a.xMin <= b.xMax && b.xMin <= a.xMax && a.yMin <= b.yMax && b.yMin <= a.yMax;
+}
+
+/*
+Even-odd rule, so it works for concave outlines like the plane hull
+*/
+int pointInPolygon(Point p, int n, const Point *P) {
+    int inside = 0;
+    for (int i = 0, j = n - 1; i < n; j = i++) {
+        if ((P[i].y > p.y) != (P[j].y > p.y)) {
+            // x of the edge at height p.y, compared without dividing
+            long lhs = (long)(p.x - P[i].x) * (P[j].y - P[i].y);
+            long rhs = (long)(P[j].x - P[i].x) * (p.y - P[i].y);
+            if ((P[j].y > P[i].y) ? lhs < rhs : lhs > rhs) {
+                inside = !inside;
+            }
+        }
+    }
+    return inside;
+}
+
+long cross(Point o, Point a, Point b) {
+    return (long)(a.x - o.x) * (b.y - o.y) - (long)(a.y - o.y) * (b.x - o.x);
+}
+
+int onSegment(Point a, Point b, Point p) {
+    return p.x >= (a.x < b.x ? a.x : b.x) && p.x <= (a.x > b.x ? a.x : b.x) &&
+           p.y >= (a.y < b.y ? a.y : b.y) && p.y <= (a.y > b.y ? a.y : b.y);
+}
+
+/*
+Segments ab and cd touch or cross (endpoints and collinear overlap count)
+*/
+int segmentsIntersect(Point a, Point b, Point c, Point d) {
+    long d1 = cross(c, d, a);
+    long d2 = cross(c, d, b);
+    long d3 = cross(a, b, c);
+    long d4 = cross(a, b, d);
+    if (((d1 > 0 && d2 < 0) || (d1 < 0 && d2 > 0)) &&
+        ((d3 > 0 && d4 < 0) || (d3 < 0 && d4 > 0))) {
+        return 1;
+    }
+    return (d1 == 0 && onSegment(c, d, a)) || (d2 == 0 && onSegment(c, d, b)) ||
+           (d3 == 0 && onSegment(a, b, c)) || (d4 == 0 && onSegment(a, b, d));
+}
+
+/*
+Narrow phase for two closed polygons, convex or not: they overlap when an
+edge of one crosses an edge of the other, or one lies inside the other.
+*/
+int polygonsIntersect(int n1, const Point *P1, int n2, const Point *P2) {
+    if (!aabbOverlap(polygonBounds(n1, P1), polygonBounds(n2, P2))) {
+        return 0;
+    }
+    for (int i = 0, j = n1 - 1; i < n1; j = i++) {
+        for (int k = 0, l = n2 - 1; k < n2; l = k++) {
+            if (segmentsIntersect(P1[j], P1[i], P2[l], P2[k])) {
+                return 1;
+            }
+        }
+    }
+    return pointInPolygon(P1[0], n2, P2) || pointInPolygon(P2[0], n1, P1);
+}
+
+/*
+Place a polygon given relative to its anchor, mirrored the way
+drawSprite mirrors a sprite when direction < 0
+*/
+void transformPolygon(int n, const Point *local, Point origin, int direction, Point *out) {
+    for (int i = 0; i < n; i++) {
+        out[i].x = origin.x + (direction < 0 ? -local[i].x : local[i].x);
+        out[i].y = origin.y + local[i].y;
+    }
+}
+
+int compareColliders(const void *a, const void *b) {
+    const Collider *ca = a;
+    const Collider *cb = b;
+    return (ca->box.xMin > cb->box.xMin) - (ca->box.xMin < cb->box.xMin);
+}
+
+/*
+Broad phase: sort by left edge, then sweep, only pairing boxes whose x
+ranges overlap. O(n log n) plus the number of x-overlapping pairs.
+Reorders colliders. Returns the number of pairs written, at most
+maxPairs.
+*/
+int sweepAndPrune(Collider *colliders, int n, CollisionPair *pairs, int maxPairs) {
+    int count = 0;
+    qsort(colliders, n, sizeof(Collider), compareColliders);
+
+    for (int i = 0; i < n; i++) {
+        const Collider *a = &colliders[i];
+        for (int j = i + 1; j < n && colliders[j].box.xMin <= a->box.xMax; j++) {
+            const Collider *b = &colliders[j];
+            if (!(a->layer & b->mask) && !(b->layer & a->mask)) continue;
+            if (a->box.yMin > b->box.yMax || b->box.yMin > a->box.yMax) continue;
+            if (count == maxPairs) {
+                return count;
+            }
+            pairs[count].a = a->id;
+            pairs[count].b = b->id;
+            count++;
+        }
+    }
+    return count;
+}
@@ -0,0 +1,135 @@
+#include "particles.h"
+#include "profiler.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define GRAVITY 8
+#define DRAG 4
+
+/*
+Allocate room for capacity particles in one block. Returns 0 on success.
+Defaults match updatePhysicsPoint, with no ground.
+*/
+int initParticleSystem(ParticleSystem *ps, int capacity) {
+    void *block;
+    capacity = (capacity + PARTICLE_LANES - 1) / PARTICLE_LANES * PARTICLE_LANES;
+    memset(ps, 0, sizeof(*ps));
+    if (capacity <= 0 || posix_memalign(&block, sizeof(v4sf), (size_t)capacity * 7 * sizeof(float))) {
+        return -1;
+    }
+    memset(block, 0, (size_t)capacity * 7 * sizeof(float));
+
+    ps->capacity = capacity;
+    ps->x = block;
+    ps->y = ps->x + capacity;
+    ps->vx = ps->y + capacity;
+    ps->vy = ps->vx + capacity;
+    ps->life = ps->vy + capacity;
+    ps->bounces = (int *)(ps->life + capacity);
+    ps->tag = ps->bounces + capacity;
+
+    ps->gravity = GRAVITY;
+    ps->drag = DRAG;
+    ps->groundY = 1e9f;
+    ps->restitution = 0.6f;
+    ps->groundFriction = 0;
+    return 0;
+}
+
+void freeParticleSystem(ParticleSystem *ps) {
+    free(ps->x);
+    memset(ps, 0, sizeof(*ps));
+}
+
+/*
+Returns the new particle's index, or -1 when the system is full
+*/
+int spawnParticle(ParticleSystem *ps, float x, float y, float vx, float vy, float life) {
+    if (ps->count == ps->capacity) {
+        return -1;
+    }
+    int i = ps->count++;
+    ps->x[i] = x;
+    ps->y[i] = y;
+    ps->vx[i] = vx;
+    ps->vy[i] = vy;
+    ps->life[i] = life;
+    ps->bounces[i] = 0;
+    ps->tag[i] = 0;
+    return i;
+}
+
+void killParticle(ParticleSystem *ps, int i) {
+    int last = --ps->count;
+    ps->x[i] = ps->x[last];
+    ps->y[i] = ps->y[last];
+    ps->vx[i] = ps->vx[last];
+    ps->vy[i] = ps->vy[last];
+    ps->life[i] = ps->life[last];
+    ps->bounces[i] = ps->bounces[last];
+    ps->tag[i] = ps->tag[last];
+}
+
+// per lane: mask ? a : b
+#define SELECT(mask, a, b) ((v4sf)(((mask) & (v4si)(a)) | (~(mask) & (v4si)(b))))
+
+/*
+Advance every particle by one simulation step, PARTICLE_LANES at a time,
+then remove the ones whose life ran out. Lanes past count are padding
+and are updated harmlessly.
+*/
+void updateParticles(ParticleSystem *ps) {
+    const v4sf zero = {0};
+    const v4si signBit = (v4si){0} + (int)0x80000000;
+    v4sf gravity = zero + ps->gravity;
+    v4sf drag = zero + ps->drag;
+    v4sf ground = zero + ps->groundY;
+    v4sf restitution = zero - ps->restitution;
+    v4sf friction = zero + ps->groundFriction;
+    v4sf tenth = zero + 0.1f;
+    v4sf one = zero + 1;
+    v4si anyExpired = {0};
+
+    profileBegin(PROFILE_PHYSICS);
+    for (int i = 0; i < ps->count; i += PARTICLE_LANES) {
+        v4sf *x = (v4sf *)(ps->x + i);
+        v4sf *y = (v4sf *)(ps->y + i);
+        v4sf *vx = (v4sf *)(ps->vx + i);
+        v4sf *vy = (v4sf *)(ps->vy + i);
+        v4sf *life = (v4sf *)(ps->life + i);
+        v4si *bounces = (v4si *)(ps->bounces + i);
+
+        *x += *vx * tenth;
+        *y += *vy * tenth;
+        *vy += gravity;
+
+        // drag: shrink |vx| toward 0 without changing its sign
+        v4si sign = (v4si)*vx & signBit;
+        v4sf speed = (v4sf)((v4si)*vx & ~signBit) - drag;
+        speed = (v4sf)((v4si)speed & (speed > zero));
+        *vx = (v4sf)((v4si)speed | sign);
+
+        v4si hit = (*y > ground) & (*vy > zero);
+        *y = SELECT(hit, ground, *y);
+        *vy = SELECT(hit, *vy * restitution, *vy);
+        *vx = SELECT(hit, *vx * friction, *vx);
+        *bounces -= hit;    // hit lanes are -1
+
+        v4si mortal = *life > zero;
+        *life -= (v4sf)((v4si)one & mortal);
+        anyExpired |= mortal & (*life <= zero);
+    }
+
+    if (anyExpired[0] | anyExpired[1] | anyExpired[2] | anyExpired[3]) {
+        for (int i = ps->count - 1; i >= 0; i--) {
+            if (ps->life[i] <= 0 && ps->life[i] != PARTICLE_IMMORTAL) {
+                killParticle(ps, i);
+            }
+        }
+    }
+    profileEnd(PROFILE_PHYSICS);
+}
+
+Point particlePosition(const ParticleSystem *ps, int i) {
+    return make_point((int)ps->x[i], (int)ps->y[i]);
+}
@@ -1,5 +1,6 @@
 #include "framebuffer.h"
 #include "physics.h"
+#include "profiler.h"
 #include <stdlib.h>
 
 #define GRAVITY 8
@@ -16,6 +17,7 @@ PhysicsPoint makePhysicsPoint(int x, int y, int xvel, int yvel) {
 }
 
 void updatePhysicsPoint(PhysicsPoint* pp) {
+  profileBegin(PROFILE_PHYSICS);
   pp->pos.x += pp->vel.x/10;
   pp->pos.y += pp->vel.y/10;
 
@@ -28,4 +30,5 @@ void updatePhysicsPoint(PhysicsPoint* pp) {
   } else {
     pp->vel.x = 0;
   }
+  profileEnd(PROFILE_PHYSICS);
 }
@@ -0,0 +1,265 @@
+#include "image.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// BMP compression values
+#define BMP_RGB 0
+#define BMP_BITFIELDS 3
+#define BMP_ALPHABITFIELDS 6
+
+static inline uint32_t readLE16(const uint8_t *p) {
+    return p[0] | p[1] << 8;
+}
+
+static inline uint32_t readLE32(const uint8_t *p) {
+    return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static Surface* imageSurface(long width, long height) {
+    if (width <= 0 || height <= 0 || width > IMAGE_MAX_SIZE || height > IMAGE_MAX_SIZE) {
+        return 0;
+    }
+    return allocSurface(width, height);
+}
+
+/*
+Next number of a PNM header, skipping whitespace and # comments, or -1
+*/
+static long pnmField(const uint8_t *data, size_t size, size_t *pos) {
+    size_t i = *pos;
+    for (;;) {
+        while (i < size && (data[i] == ' ' || data[i] == '\t' || data[i] == '\r' || data[i] == '\n')) i++;
+        if (i < size && data[i] == '#') {
+            while (i < size && data[i] != '\n') i++;
+            continue;
+        }
+        break;
+    }
+    if (i >= size || data[i] < '0' || data[i] > '9') return -1;
+
+    long v = 0;
+    while (i < size && data[i] >= '0' && data[i] <= '9' && v <= 65535) {
+        v = v * 10 + (data[i++] - '0');
+    }
+    *pos = i;
+    return v;
+}
+
+/*
+Binary PGM (P5) and PPM (P6), 8 or 16 bits per sample
+*/
+static Surface* decodePNM(const uint8_t *data, size_t size) {
+    size_t pos = 2;
+    int channels = data[1] == '6' ? 3 : 1;
+    long width = pnmField(data, size, &pos);
+    long height = pnmField(data, size, &pos);
+    long maxval = pnmField(data, size, &pos);
+    // exactly one whitespace byte separates the header from the samples
+    if (maxval <= 0 || maxval > 65535 || ++pos > size) return 0;
+
+    int sampleBytes = maxval > 255 ? 2 : 1;
+    size_t rowBytes = (size_t)width * channels * sampleBytes;
+    if (width <= 0 || height <= 0 || (size - pos) / rowBytes < (size_t)height) return 0;
+    Surface *s = imageSurface(width, height);
+    if (!s) return 0;
+
+    const uint8_t *in = data + pos;
+    for (int j = 0; j < height; j++, in += rowBytes) {
+        uint32_t *row = surfaceRow(s, j);
+        if (maxval == 255 && channels == 3) {
+            for (int i = 0; i < width; i++) {
+                const uint8_t *p = in + i * 3;
+                row[i] = 0xFF000000u | p[0] << 16 | p[1] << 8 | p[2];
+            }
+            continue;
+        }
+        for (int i = 0; i < width; i++) {
+            uint32_t rgb[3];
+            for (int c = 0; c < channels; c++) {
+                const uint8_t *p = in + ((size_t)i * channels + c) * sampleBytes;
+                uint32_t v = sampleBytes == 2 ? (uint32_t)(p[0] << 8 | p[1]) : p[0];
+                if (v > (uint32_t)maxval) v = maxval;
+                rgb[c] = maxval == 255 ? v : (v * 255 + maxval / 2) / maxval;
+            }
+            if (channels == 1) rgb[1] = rgb[2] = rgb[0];
+            row[i] = 0xFF000000u | rgb[0] << 16 | rgb[1] << 8 | rgb[2];
+        }
+    }
+    return s;
+}
+
+// One channel of a bitfield pixel: mask it, shift it down and widen it to 8 bits
+typedef struct {
+    uint32_t mask;
+    int shift;
+    int bits;
+} BitField;
+
+static BitField bitField(uint32_t mask) {
+    BitField f = {mask, 0, 0};
+    if (mask) {
+        f.shift = __builtin_ctz(mask);
+        f.bits = 32 - __builtin_clz(mask) - f.shift;
+    }
+    return f;
+}
+
+static inline uint32_t fieldValue(BitField f, uint32_t px) {
+    if (!f.mask) return 0;
+    uint32_t v = (px & f.mask) >> f.shift;
+    if (f.bits >= 8) return v >> (f.bits - 8);
+    return v * 255 / ((1u << f.bits) - 1);
+}
+
+/*
+Uncompressed BMP: 1/4/8 bit palettes, 24 bit BGR, and 16/32 bit pixels
+with default or explicit channel masks. A 32 bit BGRA file on a 4 byte
+boundary is used in place, pointing the surface into data.
+*/
+static Surface* decodeBMP(uint8_t *data, size_t size) {
+    if (size < 26) return 0;
+    uint32_t offset = readLE32(data + 10);
+    uint32_t header = readLE32(data + 14);
+    if (header != 12 && (header < 40 || size < 14 + (size_t)header)) return 0;
+
+    long width, height;
+    int bpp, compression = BMP_RGB, paletteEntry = 4;
+    uint32_t colors = 0;
+    if (header == 12) {
+        width = readLE16(data + 18);
+        height = (int16_t)readLE16(data + 20);
+        bpp = readLE16(data + 24);
+        paletteEntry = 3;
+    } else {
+        width = (int32_t)readLE32(data + 18);
+        height = (int32_t)readLE32(data + 22);
+        bpp = readLE16(data + 28);
+        compression = readLE32(data + 30);
+        colors = readLE32(data + 46);
+    }
+    if (bpp != 1 && bpp != 4 && bpp != 8 && bpp != 16 && bpp != 24 && bpp != 32) return 0;
+    int bottomUp = height > 0;
+    if (height < 0) height = -height;
+    if (width <= 0 || width > IMAGE_MAX_SIZE || height == 0 || height > IMAGE_MAX_SIZE) return 0;
+
+    // channel masks follow the first 40 header bytes, in V3 and later
+    // headers as part of them
+    uint32_t masks[4] = {0, 0, 0, 0};
+    if (compression == BMP_BITFIELDS || compression == BMP_ALPHABITFIELDS) {
+        if (bpp != 16 && bpp != 32) return 0;
+        int count = compression == BMP_ALPHABITFIELDS || header >= 56 ? 4 : 3;
+        if (14 + 40 + 4 * (size_t)count > size) return 0;
+        for (int i = 0; i < count; i++) {
+            masks[i] = readLE32(data + 54 + 4 * i);
+        }
+    } else if (compression != BMP_RGB) {
+        return 0;
+    } else if (bpp == 16) {
+        masks[0] = 0x7C00, masks[1] = 0x03E0, masks[2] = 0x001F;
+    } else if (bpp == 32) {
+        masks[0] = 0x00FF0000, masks[1] = 0x0000FF00, masks[2] = 0x000000FF;
+    }
+
+    size_t stride = ((size_t)width * bpp + 31) / 32 * 4;
+    if (offset > size || (size - offset) / stride < (size_t)height) return 0;
+    uint8_t *pixels = data + offset;
+
+    if (bpp == 32 && masks[0] == 0x00FF0000 && masks[1] == 0x0000FF00 && masks[2] == 0x000000FF
+        && masks[3] == 0xFF000000 && offset % 4 == 0) {
+        Surface *s = malloc(sizeof(Surface));
+        if (!s) return 0;
+        s->width = width;
+        s->height = height;
+        s->pitch = bottomUp ? -width : width;
+        s->pixels = (uint32_t *)(bottomUp ? pixels + (height - 1) * stride : pixels);
+        s->mapping = data;
+        s->mappingSize = 0;
+        return s;
+    }
+
+    uint32_t palette[256];
+    if (bpp <= 8) {
+        if (!colors || colors > (1u << bpp)) colors = 1u << bpp;
+        // short palettes end where the pixels start
+        if (offset < 14 + header) return 0;
+        if (colors > (offset - 14 - header) / paletteEntry) colors = (offset - 14 - header) / paletteEntry;
+        const uint8_t *p = data + 14 + header;
+        for (uint32_t i = 0; i < 256; i++, p += paletteEntry) {
+            palette[i] = i < colors ? 0xFF000000u | p[2] << 16 | p[1] << 8 | p[0] : 0xFF000000u;
+        }
+    }
+
+    Surface *s = imageSurface(width, height);
+    if (!s) return 0;
+    BitField r = bitField(masks[0]), g = bitField(masks[1]), b = bitField(masks[2]), a = bitField(masks[3]);
+    for (int j = 0; j < height; j++) {
+        const uint8_t *in = pixels + (size_t)(bottomUp ? height - 1 - j : j) * stride;
+        uint32_t *row = surfaceRow(s, j);
+        if (bpp == 24) {
+            for (int i = 0; i < width; i++, in += 3) {
+                row[i] = 0xFF000000u | in[2] << 16 | in[1] << 8 | in[0];
+            }
+        } else if (bpp == 16 || bpp == 32) {
+            for (int i = 0; i < width; i++) {
+                uint32_t px = bpp == 16 ? readLE16(in + 2 * i) : readLE32(in + 4 * i);
+                uint32_t alpha = a.mask ? fieldValue(a, px) : 255;
+                row[i] = alpha << 24 | fieldValue(r, px) << 16 | fieldValue(g, px) << 8 | fieldValue(b, px);
+            }
+        } else {
+            int perByte = 8 / bpp, mask = (1 << bpp) - 1;
+            for (int i = 0; i < width; i++) {
+                int shift = 8 - bpp * (i % perByte + 1);
+                row[i] = palette[in[i / perByte] >> shift & mask];
+            }
+        }
+    }
+    return s;
+}
+
+Surface* loadImage(const char *path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        perror("Error: cannot open image");
+        return 0;
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0 || st.st_size < 8) {
+        fprintf(stderr, "Error: %s is not an image\n", path);
+        close(fd);
+        return 0;
+    }
+    size_t size = st.st_size;
+    // private and writable, so a surface loaded in place can be drawn on
+    // without touching the file
+    uint8_t *data = mmap(0, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        perror("Error: cannot map image");
+        return 0;
+    }
+
+    Surface *s = 0;
+    if (data[0] == 'P' && (data[1] == '5' || data[1] == '6')) {
+        s = decodePNM(data, size);
+    } else if (data[0] == 'B' && data[1] == 'M') {
+        s = decodeBMP(data, size);
+    } else if (memcmp(data, "\x89PNG\r\n\x1a\n", 8) == 0) {
+        s = decodePNG(data, size);
+    }
+    if (!s) {
+        fprintf(stderr, "Error: cannot decode image %s\n", path);
+        munmap(data, size);
+        return 0;
+    }
+    if (s->mapping == data) {
+        s->mappingSize = size;
+    } else {
+        munmap(data, size);
+    }
+    return s;
+}
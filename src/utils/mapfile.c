@@ -0,0 +1,120 @@
+#include "mapfile.h"
+#include "geometry.h"
+#include "cmdbuffer.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+/*
+Load every polygon of a map file into one contiguous vertex array.
+Returns 0 if the file cannot be read or is malformed.
+*/
+PolygonMap* loadPolygonMap(const char *path) {
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        perror("Error: cannot open map file");
+        return 0;
+    }
+
+    PolygonMap *map = calloc(1, sizeof(PolygonMap));
+    int vertexCapacity = 256;
+    int polygonCapacity = 32;
+    int vertexCount = 0;
+    int n;
+    if (map) {
+        map->vertices = malloc(vertexCapacity * sizeof(Point));
+        map->offsets = malloc((polygonCapacity + 1) * sizeof(int));
+    }
+    if (!map || !map->vertices || !map->offsets) {
+        fclose(f);
+        freePolygonMap(map);
+        return 0;
+    }
+    map->offsets[0] = 0;
+
+    while (fscanf(f, "%d", &n) == 1) {
+        if (n <= 0) {
+            break;
+        }
+        if (vertexCount + n > vertexCapacity) {
+            while (vertexCount + n > vertexCapacity) vertexCapacity *= 2;
+            Point *grown = realloc(map->vertices, vertexCapacity * sizeof(Point));
+            if (!grown) goto outOfMemory;
+            map->vertices = grown;
+        }
+        if (map->count == polygonCapacity) {
+            polygonCapacity *= 2;
+            int *grown = realloc(map->offsets, (polygonCapacity + 1) * sizeof(int));
+            if (!grown) goto outOfMemory;
+            map->offsets = grown;
+        }
+
+        int i;
+        for (i = 0; i < n; i++) {
+            if (fscanf(f, "%d %d", &map->vertices[vertexCount + i].x, &map->vertices[vertexCount + i].y) != 2) {
+                break;
+            }
+        }
+        if (i < n) {
+            fprintf(stderr, "Error: truncated polygon in %s\n", path);
+            goto fail;
+        }
+        vertexCount += n;
+        map->count++;
+        map->offsets[map->count] = vertexCount;
+    }
+
+    fclose(f);
+    return map;
+
+outOfMemory:
+    fprintf(stderr, "Error: out of memory loading %s\n", path);
+fail:
+    fclose(f);
+    freePolygonMap(map);
+    return 0;
+}
+
+void freePolygonMap(PolygonMap *map) {
+    if (map) {
+        free(map->vertices);
+        free(map->offsets);
+        free(map);
+    }
+}
+
+/*
+Outline every polygon of map, scaled about the origin then moved by offset
+*/
+void drawPolygonMap(const PolygonMap *map, Point offset, double scale, Color C, int W) {
+    Point buffer[64];
+    for (int i = 0; i < map->count; i++) {
+        int n = map->offsets[i + 1] - map->offsets[i];
+        const Point *src = map->vertices + map->offsets[i];
+        Point *P = n <= 64 ? buffer : malloc(n * sizeof(Point));
+        if (!P) continue;
+        for (int k = 0; k < n; k++) {
+            P[k] = make_point(offset.x + (int)(src[k].x * scale + 0.5),
+                              offset.y + (int)(src[k].y * scale + 0.5));
+        }
+        drawPolygon(n, P, C, W);
+        if (P != buffer) free(P);
+    }
+}
+
+/*
+Record map like drawPolygonMap into l as one batch, e.g. for
+executeCommandsTiled. The vertices are transformed straight into the
+list's vertex buffer.
+*/
+void recordPolygonMap(CommandList *l, const PolygonMap *map, Point offset, double scale, Color C, int W) {
+    int n = map->offsets[map->count];
+    Point *P = reserveVertices(l, n);
+    if (!P) return;
+    for (int k = 0; k < n; k++) {
+        P[k] = make_point(offset.x + (int)(map->vertices[k].x * scale + 0.5),
+                          offset.y + (int)(map->vertices[k].y * scale + 0.5));
+    }
+    PolygonStyle style = {C, W};
+    PolygonBatch batch = {P, map->offsets, &style, 1, map->count};
+    recordPolygonBatch(l, &batch);
+}
@@ -0,0 +1,801 @@
+#include "image.h"
+#include <stdlib.h>
+#include <string.h>
+
+/*
+Small PNG decoder: every color type and bit depth, tRNS transparency and
+Adam7 interlacing, with its own inflate. Chunk CRCs and the zlib Adler-32
+are not checked; corrupt data can give a wrong image but never reads or
+writes out of bounds. encodePNG at the end writes RGB screenshots.
+*/
+
+// Huffman codes up to this long decode with one table lookup
+#define INFLATE_FAST_BITS 10
+#define INFLATE_MAX_BITS 15
+
+typedef struct {
+    uint16_t fast[1 << INFLATE_FAST_BITS];   // symbol << 4 | length, 0 for longer codes
+    uint16_t count[INFLATE_MAX_BITS + 1];    // codes of each length
+    uint16_t symbol[288];                    // symbols in code order
+} Huffman;
+
+typedef struct {
+    const uint8_t *in, *end;
+    uint64_t bits;
+    int bitCount;
+    int overrun;                             // bytes read past the end, as zeros
+    uint8_t *out, *outStart, *outEnd;
+    Huffman literals, distances, lengths;
+} Inflater;
+
+static const uint16_t lengthBase[29] = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+static const uint8_t lengthExtra[29] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+static const uint16_t distanceBase[30] = {
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+};
+static const uint8_t distanceExtra[30] = {
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+// order the code length code lengths are stored in
+static const uint8_t lengthOrder[19] = {
+    16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15
+};
+
+static inline void refill(Inflater *z) {
+    while (z->bitCount <= 56) {
+        uint64_t byte = 0;
+        if (z->in < z->end) {
+            byte = *z->in++;
+        } else {
+            z->overrun++;
+        }
+        z->bits |= byte << z->bitCount;
+        z->bitCount += 8;
+    }
+}
+
+static inline uint32_t getBits(Inflater *z, int n) {
+    if (z->bitCount < n) refill(z);
+    uint32_t v = z->bits & ((1u << n) - 1);
+    z->bits >>= n;
+    z->bitCount -= n;
+    return v;
+}
+
+static inline uint32_t reverseBits(uint32_t code, int len) {
+    uint32_t reversed = 0;
+    for (int b = 0; b < len; b++) {
+        reversed |= (code >> b & 1) << (len - 1 - b);
+    }
+    return reversed;
+}
+
+static int buildHuffman(Huffman *h, const uint8_t *lengths, int n) {
+    uint16_t offsets[INFLATE_MAX_BITS + 1];
+    memset(h->count, 0, sizeof(h->count));
+    for (int i = 0; i < n; i++) {
+        h->count[lengths[i]]++;
+    }
+    h->count[0] = 0;
+
+    int left = 1;
+    for (int len = 1; len <= INFLATE_MAX_BITS; len++) {
+        left = (left << 1) - h->count[len];
+        if (left < 0) return -1;
+    }
+    offsets[1] = 0;
+    for (int len = 1; len < INFLATE_MAX_BITS; len++) {
+        offsets[len + 1] = offsets[len] + h->count[len];
+    }
+    for (int i = 0; i < n; i++) {
+        if (lengths[i]) h->symbol[offsets[lengths[i]]++] = i;
+    }
+
+    // codes are stored first bit first, so the table is indexed by the
+    // code reversed
+    memset(h->fast, 0, sizeof(h->fast));
+    int code = 0, k = 0;
+    for (int len = 1; len <= INFLATE_FAST_BITS; len++, code <<= 1) {
+        for (int i = 0; i < h->count[len]; i++, code++) {
+            for (int j = reverseBits(code, len); j < 1 << INFLATE_FAST_BITS; j += 1 << len) {
+                h->fast[j] = h->symbol[k] << 4 | len;
+            }
+            k++;
+        }
+    }
+    return 0;
+}
+
+/*
+Next symbol of h, or -1 for a code h does not have
+*/
+static inline int decodeSymbol(Inflater *z, const Huffman *h) {
+    if (z->bitCount < INFLATE_MAX_BITS) refill(z);
+    uint16_t e = h->fast[z->bits & ((1 << INFLATE_FAST_BITS) - 1)];
+    if (e) {
+        z->bits >>= e & 15;
+        z->bitCount -= e & 15;
+        return e >> 4;
+    }
+
+    // longer code: walk the canonical code one bit at a time
+    int code = 0, first = 0, index = 0;
+    for (int len = 1; len <= INFLATE_MAX_BITS; len++) {
+        code |= z->bits & 1;
+        z->bits >>= 1;
+        z->bitCount--;
+        int count = h->count[len];
+        if (code - first < count) return h->symbol[index + code - first];
+        index += count;
+        first = (first + count) << 1;
+        code <<= 1;
+    }
+    return -1;
+}
+
+static int inflateStored(Inflater *z) {
+    // drop to a byte boundary; whole bytes still buffered come first
+    getBits(z, z->bitCount & 7);
+    uint32_t len = getBits(z, 16);
+    if ((getBits(z, 16) ^ 0xFFFF) != len) return -1;
+    if ((size_t)(z->outEnd - z->out) < len) return -1;
+    while (len && z->bitCount >= 8) {
+        *z->out++ = getBits(z, 8);
+        len--;
+    }
+    if ((size_t)(z->end - z->in) < len) return -1;
+    memcpy(z->out, z->in, len);
+    z->out += len;
+    z->in += len;
+    return 0;
+}
+
+static int inflateCodes(Inflater *z) {
+    for (;;) {
+        int sym = decodeSymbol(z, &z->literals);
+        if (sym < 256) {
+            if (sym < 0 || z->out == z->outEnd) return -1;
+            *z->out++ = sym;
+            continue;
+        }
+        if (sym == 256) return 0;
+
+        sym -= 257;
+        if (sym >= 29) return -1;
+        int len = lengthBase[sym] + getBits(z, lengthExtra[sym]);
+        sym = decodeSymbol(z, &z->distances);
+        if (sym < 0 || sym >= 30) return -1;
+        int dist = distanceBase[sym] + getBits(z, distanceExtra[sym]);
+        if (dist > z->out - z->outStart || len > z->outEnd - z->out) return -1;
+
+        const uint8_t *from = z->out - dist;
+        if (dist == 1) {
+            memset(z->out, *from, len);
+            z->out += len;
+            continue;
+        }
+        // an overlapping match repeats its first dist bytes: copy what is
+        // already there, doubling the piece each time
+        while (len > 0) {
+            int n = z->out - from < len ? z->out - from : len;
+            memcpy(z->out, from, n);
+            z->out += n;
+            len -= n;
+        }
+    }
+}
+
+static int inflateFixed(Inflater *z) {
+    uint8_t lengths[288];
+    int i = 0;
+    for (; i < 144; i++) lengths[i] = 8;
+    for (; i < 256; i++) lengths[i] = 9;
+    for (; i < 280; i++) lengths[i] = 7;
+    for (; i < 288; i++) lengths[i] = 8;
+    buildHuffman(&z->literals, lengths, 288);
+    memset(lengths, 5, 30);
+    buildHuffman(&z->distances, lengths, 30);
+    return inflateCodes(z);
+}
+
+static int inflateDynamic(Inflater *z) {
+    uint8_t lengths[320];
+    int literalCount = getBits(z, 5) + 257;
+    int distanceCount = getBits(z, 5) + 1;
+    int lengthCount = getBits(z, 4) + 4;
+    if (literalCount > 286 || distanceCount > 30) return -1;
+
+    memset(lengths, 0, 19);
+    for (int i = 0; i < lengthCount; i++) {
+        lengths[lengthOrder[i]] = getBits(z, 3);
+    }
+    if (buildHuffman(&z->lengths, lengths, 19)) return -1;
+
+    int n = literalCount + distanceCount;
+    for (int i = 0; i < n;) {
+        int sym = decodeSymbol(z, &z->lengths);
+        if (sym < 0) return -1;
+        if (sym < 16) {
+            lengths[i++] = sym;
+            continue;
+        }
+        int value = 0, repeat;
+        if (sym == 16) {
+            if (i == 0) return -1;
+            value = lengths[i - 1];
+            repeat = 3 + getBits(z, 2);
+        } else if (sym == 17) {
+            repeat = 3 + getBits(z, 3);
+        } else {
+            repeat = 11 + getBits(z, 7);
+        }
+        if (i + repeat > n) return -1;
+        while (repeat--) lengths[i++] = value;
+    }
+    if (!lengths[256]) return -1;
+    if (buildHuffman(&z->literals, lengths, literalCount)) return -1;
+    if (buildHuffman(&z->distances, lengths + literalCount, distanceCount)) return -1;
+    return inflateCodes(z);
+}
+
+/*
+Inflate the zlib stream in..in+size into exactly outSize bytes at out
+*/
+static int inflateZlib(const uint8_t *in, size_t size, uint8_t *out, size_t outSize) {
+    if (size < 2 || (in[0] & 15) != 8 || (in[0] << 8 | in[1]) % 31 || (in[1] & 0x20)) {
+        return -1;
+    }
+    Inflater *z = malloc(sizeof(Inflater));
+    if (!z) return -1;
+    z->in = in + 2;
+    z->end = in + size;
+    z->bits = 0;
+    z->bitCount = 0;
+    z->overrun = 0;
+    z->out = z->outStart = out;
+    z->outEnd = out + outSize;
+
+    int last, result = 0;
+    do {
+        last = getBits(z, 1);
+        int type = getBits(z, 2);
+        if (type == 0) {
+            result = inflateStored(z);
+        } else if (type == 1) {
+            result = inflateFixed(z);
+        } else if (type == 2) {
+            result = inflateDynamic(z);
+        } else {
+            result = -1;
+        }
+        // past the end by more than the bit buffer holds: truncated stream
+    } while (!result && !last && z->overrun <= 8);
+
+    if (z->overrun > 8 || z->out != z->outEnd) result = -1;
+    free(z);
+    return result;
+}
+
+/*
+The Paeth predictor, written as selects so it compiles without branches
+*/
+static inline uint8_t paeth(int a, int b, int c) {
+    int pa = abs(b - c), pb = abs(a - c), pc = abs(a + b - 2 * c);
+    int bc = pb <= pc ? b : c;
+    return pa <= pb && pa <= pc ? a : bc;
+}
+
+/*
+Undo the filter of one row in place; prior is the row above, unfiltered,
+and bpp the bytes per pixel (at least 1)
+*/
+static int unfilterRow(uint8_t *row, const uint8_t *prior, size_t n, int bpp, int filter) {
+    size_t i;
+    switch (filter) {
+    case 0:
+        break;
+    case 1:
+        for (i = bpp; i < n; i++) row[i] += row[i - bpp];
+        break;
+    case 2:
+        for (i = 0; i < n; i++) row[i] += prior[i];
+        break;
+    case 3:
+        for (i = 0; i < (size_t)bpp; i++) row[i] += prior[i] >> 1;
+        for (; i < n; i++) row[i] += (row[i - bpp] + prior[i]) >> 1;
+        break;
+    case 4:
+        for (i = 0; i < (size_t)bpp; i++) row[i] += prior[i];
+        for (; i < n; i++) row[i] += paeth(row[i - bpp], prior[i], prior[i - bpp]);
+        break;
+    default:
+        return -1;
+    }
+    return 0;
+}
+
+typedef struct {
+    int width, height;
+    int depth, colorType, channels;
+    uint32_t table[256];     // palette, or gray levels, as 0xAARRGGBB
+    int hasKey;              // tRNS color key of gray and RGB images
+    uint16_t key[3];
+} PngInfo;
+
+static inline uint32_t sample16(const uint8_t *p) {
+    return p[0] << 8 | p[1];
+}
+
+/*
+Convert one unfiltered row of n pixels, writing every step-th pixel of out
+*/
+static void convertRow(const PngInfo *png, const uint8_t *in, uint32_t *out, int step, int n) {
+    int depth = png->depth;
+    if (png->colorType == 3 || (png->colorType == 0 && depth <= 8)) {
+        int perByte = 8 / depth, mask = (1 << depth) - 1;
+        for (int i = 0; i < n; i++) {
+            int shift = 8 - depth * (i % perByte + 1);
+            out[i * step] = png->table[in[i / perByte] >> shift & mask];
+        }
+        return;
+    }
+
+    // the common 8 bit truecolor layouts, without the per-pixel switch
+    if (depth == 8 && png->colorType == 6) {
+        for (int i = 0; i < n; i++, in += 4) {
+            out[i * step] = (uint32_t)in[3] << 24 | in[0] << 16 | in[1] << 8 | in[2];
+        }
+        return;
+    }
+    if (depth == 8 && png->colorType == 2 && !png->hasKey) {
+        for (int i = 0; i < n; i++, in += 3) {
+            out[i * step] = 0xFF000000u | in[0] << 16 | in[1] << 8 | in[2];
+        }
+        return;
+    }
+
+    int size = depth / 8 * png->channels;
+    int sb = depth / 8;
+    for (int i = 0; i < n; i++, in += size) {
+        uint32_t px;
+        switch (png->colorType) {
+        case 0:
+            px = 0xFF000000u | in[0] * 0x010101u;
+            if (png->hasKey && sample16(in) == png->key[0]) px &= 0x00FFFFFF;
+            break;
+        case 2:
+            px = 0xFF000000u | in[0] << 16 | in[sb] << 8 | in[2 * sb];
+            if (png->hasKey) {
+                int match = sb == 2 ? sample16(in) == png->key[0] && sample16(in + 2) == png->key[1]
+                                          && sample16(in + 4) == png->key[2]
+                                    : in[0] == png->key[0] && in[1] == png->key[1] && in[2] == png->key[2];
+                if (match) px &= 0x00FFFFFF;
+            }
+            break;
+        case 4:
+            px = (uint32_t)in[sb] << 24 | in[0] * 0x010101u;
+            break;
+        default:
+            px = (uint32_t)in[3 * sb] << 24 | in[0] << 16 | in[sb] << 8 | in[2 * sb];
+            break;
+        }
+        out[i * step] = px;
+    }
+}
+
+static inline uint32_t readBE32(const uint8_t *p) {
+    return (uint32_t)p[0] << 24 | p[1] << 16 | p[2] << 8 | p[3];
+}
+
+// Adam7 passes: first column, first row, column step, row step
+static const uint8_t adam7[7][4] = {
+    {0, 0, 8, 8}, {4, 0, 8, 8}, {0, 4, 4, 8}, {2, 0, 4, 4}, {0, 2, 2, 4}, {1, 0, 2, 2}, {0, 1, 1, 2}
+};
+
+Surface* decodePNG(const uint8_t *data, size_t size) {
+    PngInfo png;
+    int interlaced = 0, paletteSize = 0, sawHeader = 0;
+    uint8_t alphas[256];
+    const uint8_t *idat = 0;
+    uint8_t *gathered = 0;
+    size_t idatSize = 0, gatheredSize = 0;
+    int idatChunks = 0;
+
+    memset(alphas, 255, sizeof(alphas));
+    memset(&png, 0, sizeof(png));
+
+    // walk the chunks; the compressed stream may be split over several IDATs
+    size_t pos = 8;
+    for (int pass = 0; pass < 2; pass++) {
+        for (pos = 8; pos + 12 <= size;) {
+            uint32_t len = readBE32(data + pos);
+            const uint8_t *type = data + pos + 4, *body = data + pos + 8;
+            if (len > size - pos - 12) goto fail;
+            pos += 12 + len;
+
+            // chunks after IEND are not part of the image in either pass
+            if (!memcmp(type, "IEND", 4)) {
+                break;
+            }
+            if (pass == 1) {
+                if (!memcmp(type, "IDAT", 4)) {
+                    if (len > gatheredSize - idatSize) goto fail;
+                    memcpy(gathered + idatSize, body, len);
+                    idatSize += len;
+                }
+                continue;
+            }
+            if (!memcmp(type, "IHDR", 4) && len >= 13) {
+                png.width = readBE32(body);
+                png.height = readBE32(body + 4);
+                png.depth = body[8];
+                png.colorType = body[9];
+                interlaced = body[12];
+                sawHeader = 1;
+            } else if (!memcmp(type, "PLTE", 4)) {
+                paletteSize = len / 3 > 256 ? 256 : len / 3;
+                for (int i = 0; i < paletteSize; i++) {
+                    png.table[i] = body[3 * i] << 16 | body[3 * i + 1] << 8 | body[3 * i + 2];
+                }
+            } else if (!memcmp(type, "tRNS", 4)) {
+                if (png.colorType == 3) {
+                    memcpy(alphas, body, len > 256 ? 256 : len);
+                } else if (len >= 2) {
+                    png.hasKey = 1;
+                    for (int i = 0; i < 3 && 2 * i + 1 < (int)len; i++) {
+                        png.key[i] = sample16(body + 2 * i);
+                    }
+                }
+            } else if (!memcmp(type, "IDAT", 4)) {
+                if (!idatChunks++) idat = body;
+                idatSize += len;
+            }
+        }
+        if (pass == 1 || idatChunks < 2) break;
+        // several IDATs: join them so inflate reads one stream
+        gathered = malloc(idatSize);
+        if (!gathered) goto fail;
+        gatheredSize = idatSize;
+        idat = gathered;
+        idatSize = 0;
+    }
+
+    if (!sawHeader || !idat || interlaced > 1) goto fail;
+    if (png.width <= 0 || png.height <= 0 || png.width > IMAGE_MAX_SIZE || png.height > IMAGE_MAX_SIZE) goto fail;
+
+    int depth = png.depth;
+    switch (png.colorType) {
+    case 0: png.channels = 1; if (depth != 1 && depth != 2 && depth != 4 && depth != 8 && depth != 16) goto fail; break;
+    case 2: png.channels = 3; if (depth != 8 && depth != 16) goto fail; break;
+    case 3: png.channels = 1; if (depth != 1 && depth != 2 && depth != 4 && depth != 8) goto fail; break;
+    case 4: png.channels = 2; if (depth != 8 && depth != 16) goto fail; break;
+    case 6: png.channels = 4; if (depth != 8 && depth != 16) goto fail; break;
+    default: goto fail;
+    }
+    if (png.colorType == 3) {
+        if (!paletteSize) goto fail;
+        for (int i = 0; i < 256; i++) {
+            png.table[i] = i < paletteSize ? (uint32_t)alphas[i] << 24 | png.table[i] : 0xFF000000u;
+        }
+    } else if (png.colorType == 0 && depth <= 8) {
+        int levels = (1 << depth) - 1;
+        for (int i = 0; i <= levels; i++) {
+            uint32_t alpha = png.hasKey && png.key[0] == i ? 0 : 0xFF000000u;
+            png.table[i] = alpha | (i * 255 / levels) * 0x010101u;
+        }
+    }
+
+    int bitsPerPixel = depth * png.channels;
+    int bpp = bitsPerPixel < 8 ? 1 : bitsPerPixel / 8;
+    int passes = interlaced ? 7 : 1;
+    size_t rawSize = 0, widest = 0;
+    for (int p = 0; p < passes; p++) {
+        long pw = interlaced ? (png.width - adam7[p][0] + adam7[p][2] - 1) / adam7[p][2] : png.width;
+        long ph = interlaced ? (png.height - adam7[p][1] + adam7[p][3] - 1) / adam7[p][3] : png.height;
+        if (pw <= 0 || ph <= 0) continue;
+        size_t stride = ((size_t)pw * bitsPerPixel + 7) / 8;
+        rawSize += ph * (stride + 1);
+        if (stride > widest) widest = stride;
+    }
+
+    // a zero row past the end stands in for the row above the first
+    uint8_t *raw = malloc(rawSize + widest);
+    if (!raw) goto fail;
+    memset(raw + rawSize, 0, widest);
+    Surface *s = 0;
+    if (inflateZlib(idat, idatSize, raw, rawSize) == 0) {
+        s = allocSurface(png.width, png.height);
+    }
+
+    uint8_t *row = raw;
+    for (int p = 0; s && p < passes; p++) {
+        int x0 = interlaced ? adam7[p][0] : 0, y0 = interlaced ? adam7[p][1] : 0;
+        int dx = interlaced ? adam7[p][2] : 1, dy = interlaced ? adam7[p][3] : 1;
+        long pw = (png.width - x0 + dx - 1) / dx, ph = (png.height - y0 + dy - 1) / dy;
+        if (pw <= 0 || ph <= 0) continue;
+        size_t stride = ((size_t)pw * bitsPerPixel + 7) / 8;
+        const uint8_t *prior = raw + rawSize;
+        for (int j = 0; j < ph; j++, row += stride + 1) {
+            if (unfilterRow(row + 1, prior, stride, bpp, row[0])) {
+                destroySurface(s);
+                s = 0;
+                break;
+            }
+            convertRow(&png, row + 1, surfaceRow(s, y0 + j * dy) + x0, dx, pw);
+            prior = row + 1;
+        }
+    }
+    free(raw);
+    free(gathered);
+    return s;
+
+fail:
+    free(gathered);
+    return 0;
+}
+
+/*
+Encoder, for screenshots: 8 bit RGB, each row filtered with Sub or Up
+(whichever leaves the smaller residuals), then greedy LZ77 over hash
+chains into one fixed-Huffman deflate block. Flat areas, the common case
+on screen, shrink to a few bits per run.
+*/
+
+#define DEFLATE_WINDOW 32768
+#define DEFLATE_HASH_BITS 15
+#define DEFLATE_CHAIN 16        // earlier positions tried per match
+#define DEFLATE_MAX_MATCH 258
+
+typedef struct {
+    uint8_t *out;
+    uint64_t bits;
+    int bitCount;
+    uint16_t code[288];         // fixed literal/length codes, bit-reversed
+    uint8_t length[288];
+} Deflater;
+
+static inline void putBits(Deflater *d, uint32_t v, int n) {
+    d->bits |= (uint64_t)v << d->bitCount;
+    d->bitCount += n;
+    while (d->bitCount >= 8) {
+        *d->out++ = d->bits;
+        d->bits >>= 8;
+        d->bitCount -= 8;
+    }
+}
+
+static inline void putSymbol(Deflater *d, int sym) {
+    putBits(d, d->code[sym], d->length[sym]);
+}
+
+static void putMatch(Deflater *d, int len, int dist) {
+    // length codes 257..284 cover 4 lengths per extra bit count, 285 is 258
+    int l = len - 3;
+    if (len == DEFLATE_MAX_MATCH) {
+        putSymbol(d, 285);
+    } else if (l < 8) {
+        putSymbol(d, 257 + l);
+    } else {
+        int b = 31 - __builtin_clz(l);
+        putSymbol(d, 257 + 4 * (b - 1) + (l >> (b - 2) & 3));
+        putBits(d, l & ((1 << (b - 2)) - 1), b - 2);
+    }
+
+    // distance codes: two per extra bit count, all 5 bits long
+    int v = dist - 1;
+    if (v < 4) {
+        putBits(d, reverseBits(v, 5), 5);
+    } else {
+        int b = 31 - __builtin_clz(v);
+        putBits(d, reverseBits(2 * b + (v >> (b - 1) & 1), 5), 5);
+        putBits(d, v & ((1 << (b - 1)) - 1), b - 1);
+    }
+}
+
+static inline uint32_t hash3(const uint8_t *p) {
+    return (uint32_t)(p[0] | p[1] << 8 | p[2] << 16) * 2654435761u >> (32 - DEFLATE_HASH_BITS);
+}
+
+// Largest zlib stream deflateZlib writes for n bytes: no symbol costs more
+// than 12 bits per byte it covers
+static size_t deflateBound(size_t n) {
+    return n + n / 2 + 64;
+}
+
+/*
+Compress in as a zlib stream into out (deflateBound(n) bytes). Returns
+the stream size, or 0 when out of memory.
+*/
+static size_t deflateZlib(const uint8_t *in, size_t n, uint8_t *out) {
+    int32_t *head = malloc(sizeof(int32_t) << DEFLATE_HASH_BITS);
+    int32_t *prev = malloc(sizeof(int32_t) * DEFLATE_WINDOW);
+    Deflater *d = malloc(sizeof(Deflater));
+    if (!head || !prev || !d) {
+        free(head);
+        free(prev);
+        free(d);
+        return 0;
+    }
+    memset(head, 0xFF, sizeof(int32_t) << DEFLATE_HASH_BITS);
+    for (int i = 0; i < 288; i++) {
+        int code, len;
+        if (i < 144) code = 0x30 + i, len = 8;
+        else if (i < 256) code = 0x190 + i - 144, len = 9;
+        else if (i < 280) code = i - 256, len = 7;
+        else code = 0xC0 + i - 280, len = 8;
+        d->code[i] = reverseBits(code, len);
+        d->length[i] = len;
+    }
+
+    // zlib header: deflate with a 32K window, no dictionary, fastest level
+    out[0] = 0x78;
+    out[1] = 0x01;
+    d->out = out + 2;
+    d->bits = 0;
+    d->bitCount = 0;
+    putBits(d, 3, 3);           // final block, fixed codes
+
+    size_t i = 0;
+    while (i < n) {
+        int best = 0, bestDist = 0;
+        if (n - i >= 3) {
+            uint32_t h = hash3(in + i);
+            int limit = n - i < DEFLATE_MAX_MATCH ? n - i : DEFLATE_MAX_MATCH;
+            int32_t candidate = head[h];
+            for (int chain = DEFLATE_CHAIN; candidate >= 0 && i - candidate <= DEFLATE_WINDOW && chain--;
+                 candidate = prev[candidate & (DEFLATE_WINDOW - 1)]) {
+                const uint8_t *p = in + candidate;
+                if (p[best] != in[i + best]) continue;
+                int len = 0;
+                while (len < limit && p[len] == in[i + len]) len++;
+                if (len > best) {
+                    best = len;
+                    bestDist = i - candidate;
+                    if (len == limit) break;
+                }
+            }
+            prev[i & (DEFLATE_WINDOW - 1)] = head[h];
+            head[h] = i;
+        }
+
+        if (best < 3) {
+            putSymbol(d, in[i++]);
+            continue;
+        }
+        putMatch(d, best, bestDist);
+        for (size_t end = i + best; ++i < end;) {
+            if (n - i >= 3) {
+                uint32_t h = hash3(in + i);
+                prev[i & (DEFLATE_WINDOW - 1)] = head[h];
+                head[h] = i;
+            }
+        }
+    }
+    putSymbol(d, 256);
+    putBits(d, 0, 7);           // flush to a byte boundary
+
+    uint32_t a = 1, b = 0;
+    for (size_t k = 0; k < n;) {
+        // 5552 bytes is as far as the sums go without overflowing
+        size_t end = n - k < 5552 ? n : k + 5552;
+        for (; k < end; k++) {
+            a += in[k];
+            b += a;
+        }
+        a %= 65521;
+        b %= 65521;
+    }
+    uint32_t adler = b << 16 | a;
+    for (int k = 3; k >= 0; k--) {
+        *d->out++ = adler >> (8 * k);
+    }
+
+    size_t size = d->out - out;
+    free(head);
+    free(prev);
+    free(d);
+    return size;
+}
+
+static inline void writeBE32(uint8_t *p, uint32_t v) {
+    p[0] = v >> 24;
+    p[1] = v >> 16;
+    p[2] = v >> 8;
+    p[3] = v;
+}
+
+/*
+Length, type and CRC around a chunk whose data is already at p + 8.
+Returns the end of the chunk.
+*/
+static uint8_t* finishChunk(uint8_t *p, const char *type, size_t length, const uint32_t *crcTable) {
+    writeBE32(p, length);
+    memcpy(p + 4, type, 4);
+    uint32_t crc = 0xFFFFFFFFu;
+    for (size_t i = 4; i < length + 8; i++) {
+        crc = crcTable[(crc ^ p[i]) & 255] ^ crc >> 8;
+    }
+    writeBE32(p + 8 + length, crc ^ 0xFFFFFFFFu);
+    return p + 12 + length;
+}
+
+/*
+Encode s as an opaque RGB PNG. Returns the file contents (free them), or
+0 when out of memory.
+*/
+uint8_t* encodePNG(const Surface *s, size_t *size) {
+    size_t stride = (size_t)s->width * 3;
+    size_t rawSize = (1 + stride) * s->height;
+    uint8_t *raw = malloc(rawSize);
+    uint8_t *rows = malloc(stride * 3);
+    // signature, IHDR, IDAT header and CRC, IEND
+    uint8_t *png = malloc(8 + 25 + 12 + deflateBound(rawSize) + 12);
+    if (!raw || !rows || !png) {
+        free(raw);
+        free(rows);
+        free(png);
+        return 0;
+    }
+
+    uint8_t *prior = rows, *cur = rows + stride, *sub = rows + 2 * stride;
+    memset(prior, 0, stride);
+    uint8_t *line = raw;
+    for (int j = 0; j < s->height; j++, line += 1 + stride) {
+        const uint32_t *px = surfaceRow(s, j);
+        for (int i = 0; i < s->width; i++) {
+            cur[3 * i] = px[i] >> 16;
+            cur[3 * i + 1] = px[i] >> 8;
+            cur[3 * i + 2] = px[i];
+        }
+        // keep Sub or Up, whichever sums to less as signed residuals
+        long sumSub = 0, sumUp = 0;
+        for (size_t i = 0; i < stride; i++) {
+            uint8_t left = i >= 3 ? cur[i - 3] : 0;
+            sub[i] = cur[i] - left;
+            line[1 + i] = cur[i] - prior[i];
+            sumSub += abs((int8_t)sub[i]);
+            sumUp += abs((int8_t)line[1 + i]);
+        }
+        line[0] = 2;
+        if (sumSub < sumUp) {
+            line[0] = 1;
+            memcpy(line + 1, sub, stride);
+        }
+        uint8_t *t = prior;
+        prior = cur;
+        cur = t;
+    }
+    free(rows);
+
+    uint32_t crcTable[256];
+    for (uint32_t n = 0; n < 256; n++) {
+        uint32_t c = n;
+        for (int k = 0; k < 8; k++) {
+            c = c & 1 ? 0xEDB88320u ^ c >> 1 : c >> 1;
+        }
+        crcTable[n] = c;
+    }
+
+    memcpy(png, "\x89PNG\r\n\x1a\n", 8);
+    uint8_t *p = png + 8;
+    writeBE32(p + 8, s->width);
+    writeBE32(p + 12, s->height);
+    memcpy(p + 16, "\x08\x02\x00\x00\x00", 5);     // 8 bit RGB, not interlaced
+    p = finishChunk(p, "IHDR", 13, crcTable);
+    size_t idat = deflateZlib(raw, rawSize, p + 8);
+    free(raw);
+    if (!idat) {
+        free(png);
+        return 0;
+    }
+    p = finishChunk(p, "IDAT", idat, crcTable);
+    p = finishChunk(p, "IEND", 0, crcTable);
+    *size = p - png;
+    return png;
+}
@@ -16,6 +16,8 @@ char queueEmpty(queue* q) {
     return q->first == 0;
 }
 
+// not counted here: fill workers would register a stats block each, so
+// the fills count their queued points and add them to STAT_QUEUE_ALLOCS
 void insertPoint(queue* q, Point d) {
     queueItem* qi = malloc(sizeof(queueItem));
     qi->data = d;
@@ -0,0 +1,181 @@
+#include "snapshot.h"
+#include "image.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <ctype.h>
+
+/*
+Write s as a binary PPM (P6). Alpha is dropped. Returns 0 on success.
+*/
+int writeSurfacePPM(const Surface *s, const char *path) {
+    FILE *f = fopen(path, "wb");
+    if (!f) {
+        perror("Error: cannot write snapshot");
+        return -1;
+    }
+    unsigned char *row = malloc((size_t)s->width * 3);
+    if (!row) {
+        fclose(f);
+        return -1;
+    }
+
+    fprintf(f, "P6\n%d %d\n255\n", s->width, s->height);
+    for (int j = 0; j < s->height; j++) {
+        const uint32_t *px = s->pixels + (long)j * s->pitch;
+        for (int i = 0; i < s->width; i++) {
+            row[i * 3] = (px[i] >> 16) & 0xFF;
+            row[i * 3 + 1] = (px[i] >> 8) & 0xFF;
+            row[i * 3 + 2] = px[i] & 0xFF;
+        }
+        fwrite(row, 3, s->width, f);
+    }
+
+    free(row);
+    return fclose(f) == 0 ? 0 : -1;
+}
+
+/*
+Write s as an RGB PNG. Alpha is dropped. Returns 0 on success.
+*/
+int writeSurfacePNG(const Surface *s, const char *path) {
+    size_t size;
+    uint8_t *png = encodePNG(s, &size);
+    if (!png) {
+        fprintf(stderr, "Error: cannot encode %s\n", path);
+        return -1;
+    }
+    FILE *f = fopen(path, "wb");
+    if (!f) {
+        perror("Error: cannot write snapshot");
+        free(png);
+        return -1;
+    }
+    size_t written = fwrite(png, 1, size, f);
+    free(png);
+    if (fclose(f) != 0 || written != size) {
+        return -1;
+    }
+    return 0;
+}
+
+int readHeaderInt(FILE *f) {
+    int c = fgetc(f);
+    // skip whitespace and comments
+    while (c != EOF && (isspace(c) || c == '#')) {
+        if (c == '#') {
+            while (c != EOF && c != '\n') c = fgetc(f);
+        }
+        c = fgetc(f);
+    }
+    int value = 0;
+    if (!isdigit(c)) {
+        return -1;
+    }
+    while (c != EOF && isdigit(c)) {
+        value = value * 10 + (c - '0');
+        c = fgetc(f);
+    }
+    return value;
+}
+
+/*
+Read a binary PPM (P6, maxval 255) into a new surface
+*/
+Surface* readSurfacePPM(const char *path) {
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        return 0;
+    }
+    if (fgetc(f) != 'P' || fgetc(f) != '6') {
+        fclose(f);
+        return 0;
+    }
+    int width = readHeaderInt(f);
+    int height = readHeaderInt(f);
+    int maxval = readHeaderInt(f);
+    if (width <= 0 || height <= 0 || maxval != 255) {
+        fclose(f);
+        return 0;
+    }
+
+    Surface *s = createSurface(width, height);
+    unsigned char *row = malloc((size_t)width * 3);
+    if (!s || !row) {
+        free(row);
+        destroySurface(s);
+        fclose(f);
+        return 0;
+    }
+    for (int j = 0; j < height; j++) {
+        if (fread(row, 3, width, f) != (size_t)width) {
+            free(row);
+            destroySurface(s);
+            fclose(f);
+            return 0;
+        }
+        uint32_t *px = s->pixels + (long)j * s->pitch;
+        for (int i = 0; i < width; i++) {
+            px[i] = 0xFF000000u | (row[i * 3] << 16) | (row[i * 3 + 1] << 8) | row[i * 3 + 2];
+        }
+    }
+    free(row);
+    fclose(f);
+    return s;
+}
+
+/*
+FNV-1a over the RGB of every visible pixel; alpha and row padding are
+ignored so a surface and its PPM round trip hash the same
+*/
+uint64_t hashSurface(const Surface *s) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (int j = 0; j < s->height; j++) {
+        const uint32_t *px = s->pixels + (long)j * s->pitch;
+        for (int i = 0; i < s->width; i++) {
+            for (int k = 16; k >= 0; k -= 8) {
+                hash ^= (px[i] >> k) & 0xFF;
+                hash *= 1099511628211ULL;
+            }
+        }
+    }
+    return hash;
+}
+
+int channelDiff(uint32_t a, uint32_t b, int shift) {
+    return abs((int)((a >> shift) & 0xFF) - (int)((b >> shift) & 0xFF));
+}
+
+/*
+Count pixels where any channel differs by more than tolerance.
+Returns -1 if the sizes differ.
+
+diff : optional, same size; receives mismatches in red over a dimmed
+       grey copy of expected
+*/
+long compareSurfaces(const Surface *expected, const Surface *actual, int tolerance, Surface *diff) {
+    long mismatches = 0;
+    if (expected->width != actual->width || expected->height != actual->height) {
+        return -1;
+    }
+
+    for (int j = 0; j < expected->height; j++) {
+        const uint32_t *e = expected->pixels + (long)j * expected->pitch;
+        const uint32_t *a = actual->pixels + (long)j * actual->pitch;
+        uint32_t *d = diff ? diff->pixels + (long)j * diff->pitch : 0;
+        for (int i = 0; i < expected->width; i++) {
+            int bad = channelDiff(e[i], a[i], 16) > tolerance ||
+                      channelDiff(e[i], a[i], 8) > tolerance ||
+                      channelDiff(e[i], a[i], 0) > tolerance;
+            mismatches += bad;
+            if (d) {
+                if (bad) {
+                    d[i] = 0xFFFF0000u;
+                } else {
+                    uint32_t grey = (((e[i] >> 16) & 0xFF) + ((e[i] >> 8) & 0xFF) + (e[i] & 0xFF)) / 12;
+                    d[i] = 0xFF000000u | (grey << 16) | (grey << 8) | grey;
+                }
+            }
+        }
+    }
+    return mismatches;
+}
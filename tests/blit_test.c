@@ -0,0 +1,247 @@
+/**
+ * @file blit_test.c
+ * @brief Checks the vectorized blit kernels against scalar references
+ *
+ * blitRow (copy, colorkey, alpha) at every length and alignment around
+ * the 4 pixel lanes, mirrored blits across BLIT_CHUNK, blitScaled nearest
+ * and bilinear (including the per-sample path of steep downscales) and
+ * the RGB565 row conversions. The references are plain per-pixel loops
+ * written from the documented behavior; results must match exactly.
+ * Run from the repository root (make test).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "framebuffer.h"
+#include "blit.h"
+#include "palette.h"
+#include "snapshot.h"
+
+// game globals referenced by the engine objects
+int planeloc = 0;
+int endSign = 0;
+
+int failed = 0;
+
+void check(int ok, const char *what) {
+    printf("%s %s\n", ok ? "ok  " : "FAIL", what);
+    failed += !ok;
+}
+
+uint32_t seed = 12345;
+
+uint32_t randomPixel(void) {
+    seed = seed * 1103515245u + 12345u;
+    uint32_t p = seed >> 8 ^ seed << 16;
+    // a fair share of keyed, transparent and opaque pixels
+    switch (seed >> 28 & 7) {
+    case 0: return SURFACE_COLORKEY;
+    case 1: return p & 0x00FFFFFFu;
+    case 2: case 3: return p | 0xFF000000u;
+    default: return p;
+    }
+}
+
+void fillRandom(uint32_t *p, int n) {
+    for (int i = 0; i < n; i++) p[i] = randomPixel();
+}
+
+/* x / 255 rounded to nearest */
+uint32_t divide255(uint32_t x) {
+    return (2 * x + 255) / 510;
+}
+
+uint32_t referenceBlend(uint32_t s, uint32_t d) {
+    uint32_t a = s >> 24, out = 0;
+    if (a == 255) return s;
+    if (a == 0) return d;
+    for (int shift = 0; shift < 32; shift += 8) {
+        uint32_t sc = shift == 24 ? 255 : s >> shift & 255, dc = d >> shift & 255;
+        out |= divide255(sc * a + dc * (255 - a)) << shift;
+    }
+    return out;
+}
+
+uint32_t referencePixel(uint32_t s, uint32_t d, int flags) {
+    if (flags & BLIT_ALPHA) return referenceBlend(s, d);
+    if ((flags & BLIT_COLORKEY) && s == SURFACE_COLORKEY) return d;
+    return s;
+}
+
+void testBlitRow(void) {
+    static const int modes[4] = {0, BLIT_COLORKEY, BLIT_ALPHA, BLIT_ALPHA | BLIT_COLORKEY};
+    static const char *names[4] = {"blitRow copy", "blitRow colorkey", "blitRow alpha", "blitRow alpha colorkey"};
+    uint32_t src[64], dst[64], expected[64];
+
+    for (int m = 0; m < 4; m++) {
+        int ok = 1;
+        for (int n = 0; n <= 40; n++) {
+            for (int offset = 0; offset < 4; offset++) {
+                fillRandom(src, 64);
+                fillRandom(dst, 64);
+                memcpy(expected, dst, sizeof(dst));
+                for (int i = 0; i < n; i++) {
+                    expected[offset + i] = referencePixel(src[i], dst[offset + i], modes[m]);
+                }
+                blitRow(dst + offset, src, n, modes[m]);
+                ok &= !memcmp(dst, expected, sizeof(dst));
+            }
+        }
+        check(ok, names[m]);
+    }
+}
+
+/*
+Mirrored blitSurfaceRect, clipped on both sides of the source and the
+target, against a per-pixel mirror
+*/
+void testFlip(void) {
+    int ok = 1;
+    Surface *src = createSurface(600, 3);
+    Surface *dst = allocSurface(700, 3);
+    Surface *expected = allocSurface(700, 3);
+    for (int j = 0; j < 3; j++) fillRandom(surfaceRow(src, j), 600);
+    setRenderTarget(dst);
+
+    static const int cases[][4] = {     // sx, w, x, flags
+        {0, 600, 50, 0}, {0, 300, 0, BLIT_COLORKEY}, {-20, 280, -7, BLIT_ALPHA},
+        {450, 200, 600, BLIT_COLORKEY}, {13, 257, 3, 0}
+    };
+    for (unsigned c = 0; c < sizeof(cases) / sizeof(cases[0]); c++) {
+        int sx = cases[c][0], w = cases[c][1], x = cases[c][2], flags = cases[c][3];
+        for (int j = 0; j < 3; j++) {
+            fillRandom(surfaceRow(dst, j), 700);
+            memcpy(surfaceRow(expected, j), surfaceRow(dst, j), 700 * sizeof(uint32_t));
+        }
+        // column k of the rectangle shows source column sx + w - 1 - k
+        for (int j = 0; j < 3; j++) {
+            for (int k = 0; k < w; k++) {
+                int column = sx + w - 1 - k, tx = x + k;
+                if (column < 0 || column >= 600 || tx < 0 || tx >= 700) continue;
+                uint32_t *d = surfaceRow(expected, j) + tx;
+                *d = referencePixel(surfaceRow(src, j)[column], *d, flags);
+            }
+        }
+        blitSurfaceRect(src, sx, 0, w, 3, x, 0, flags | BLIT_FLIP_X);
+        ok &= compareSurfaces(expected, dst, 0, 0) == 0;
+    }
+    check(ok, "blitSurfaceRect flipped");
+
+    setRenderTarget(0);
+    destroySurface(src);
+    destroySurface(dst);
+    destroySurface(expected);
+}
+
+uint32_t referenceLerp(uint32_t a, uint32_t b, int f) {
+    uint32_t out = 0;
+    for (int shift = 0; shift < 32; shift += 8) {
+        uint32_t ca = a >> shift & 255, cb = b >> shift & 255;
+        out |= ((ca * (256 - f) + cb * f + 128) >> 8) << shift;
+    }
+    return out;
+}
+
+/*
+blitScaled one pixel at a time: 16.16 positions of the destination pixel
+centers, rows mixed before columns
+*/
+uint32_t referenceSample(const Surface *src, int sw, int sh, int w, int h, int i, int j, int filter) {
+    int64_t stepX = ((int64_t)sw << 16) / w, stepY = ((int64_t)sh << 16) / h;
+    int64_t u = stepX / 2 + i * stepX, v = stepY / 2 + j * stepY;
+    if (!filter) {
+        return surfaceRow(src, v >> 16)[u >> 16];
+    }
+    u -= 0x8000;
+    v -= 0x8000;
+    if (u < 0) u = 0;
+    if (v < 0) v = 0;
+    int c = u >> 16, fx = u >> 8 & 255, r = v >> 16, fy = v >> 8 & 255;
+    if (c >= sw - 1) { c = sw - 1; fx = 0; }
+    if (r >= sh - 1) { r = sh - 1; fy = 0; }
+    const uint32_t *top = surfaceRow(src, r), *bottom = surfaceRow(src, fy ? r + 1 : r);
+    uint32_t left = fy ? referenceLerp(top[c], bottom[c], fy) : top[c];
+    if (!fx) return left;
+    uint32_t right = fy ? referenceLerp(top[c + 1], bottom[c + 1], fy) : top[c + 1];
+    return referenceLerp(left, right, fx);
+}
+
+void testScaled(int filter) {
+    static const int sizes[][4] = {     // sw, sh, w, h
+        {7, 5, 31, 17}, {64, 48, 64, 48}, {33, 9, 600, 20},
+        {300, 40, 97, 13}, {1500, 6, 100, 4}, {5, 5, 1, 1}
+    };
+    int ok = 1;
+    for (unsigned c = 0; c < sizeof(sizes) / sizeof(sizes[0]); c++) {
+        int sw = sizes[c][0], sh = sizes[c][1], w = sizes[c][2], h = sizes[c][3];
+        Surface *src = allocSurface(sw, sh);
+        Surface *dst = allocSurface(w + 8, h + 8);
+        Surface *expected = allocSurface(w + 8, h + 8);
+        for (int j = 0; j < sh; j++) {
+            for (int i = 0; i < sw; i++) surfaceRow(src, j)[i] = randomPixel() | 0xFF000000u;
+        }
+        for (int j = 0; j < h + 8; j++) {
+            fillRandom(surfaceRow(dst, j), w + 8);
+            memcpy(surfaceRow(expected, j), surfaceRow(dst, j), (w + 8) * sizeof(uint32_t));
+        }
+        for (int j = 0; j < h; j++) {
+            for (int i = 0; i < w; i++) {
+                surfaceRow(expected, j + 4)[i + 4] = referenceSample(src, sw, sh, w, h, i, j, filter);
+            }
+        }
+        setRenderTarget(dst);
+        blitScaled(src, 0, 0, sw, sh, 4, 4, w, h, filter ? BLIT_BILINEAR : 0);
+        setRenderTarget(0);
+        ok &= compareSurfaces(expected, dst, 0, 0) == 0;
+        destroySurface(src);
+        destroySurface(dst);
+        destroySurface(expected);
+    }
+    check(ok, filter ? "blitScaled bilinear" : "blitScaled nearest");
+}
+
+void testRGB565(void) {
+    uint32_t src[48], wide[48];
+    uint16_t packed[48];
+    int ok = 1;
+    for (int n = 0; n <= 40; n++) {
+        fillRandom(src, 48);
+        packRow565(packed, src, n);
+        for (int i = 0; i < n; i++) {
+            ok &= packed[i] == packRGB565(src[i] >> 16 & 255, src[i] >> 8 & 255, src[i] & 255);
+        }
+    }
+    check(ok, "packRow565");
+
+    ok = 1;
+    for (int n = 0; n <= 40; n++) {
+        for (int i = 0; i < n; i++) packed[i] = randomPixel();
+        unpackRow565(wide, packed, n);
+        for (int i = 0; i < n; i++) {
+            ok &= wide[i] == packColor(unpackRGB565(packed[i]));
+        }
+    }
+    check(ok, "unpackRow565");
+
+    // every 16 bit value survives unpacking and packing again
+    uint16_t *all = malloc(65536 * sizeof(uint16_t)), *back = malloc(65536 * sizeof(uint16_t));
+    uint32_t *pixels = malloc(65536 * sizeof(uint32_t));
+    for (int i = 0; i < 65536; i++) all[i] = i;
+    unpackRow565(pixels, all, 65536);
+    packRow565(back, pixels, 65536);
+    check(!memcmp(all, back, 65536 * sizeof(uint16_t)), "RGB565 round trip");
+    free(all);
+    free(back);
+    free(pixels);
+}
+
+int main(void) {
+    testBlitRow();
+    testFlip();
+    testScaled(0);
+    testScaled(1);
+    testRGB565();
+    printf("%d failed\n", failed);
+    return failed ? 1 : 0;
+}
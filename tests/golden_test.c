@@ -0,0 +1,201 @@
+/**
+ * @file golden_test.c
+ * @brief Golden-image regression test for the rasterizers
+ *
+ * Renders the canonical scenes (tank, plane, parachute, flood fills and
+ * every examples/ map at several scales) into off-screen surfaces and
+ * compares each against tests/golden/<scene>.ppm with a per-channel
+ * tolerance. A failing scene writes <scene>.actual.ppm and <scene>.diff.ppm
+ * (mismatches in red over the dimmed golden image) into build/golden/.
+ * Run from the repository root:
+ *
+ *   make test
+ *   build/tests/golden_test --update     (rewrite the golden images after an intended change)
+ *   build/tests/golden_test building     (only scenes whose name contains "building")
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include "framebuffer.h"
+#include "game.h"
+#include "mapfile.h"
+#include "cmdbuffer.h"
+#include "tiles.h"
+#include "snapshot.h"
+
+#define GOLDEN_DIR "tests/golden"
+#define FAILURE_DIR "build/golden"
+// per-channel difference still accepted, so a rounding change in a
+// blend does not fail every scene
+#define GOLDEN_TOLERANCE 2
+
+// game globals referenced by the engine objects
+int planeloc = 0;
+int endSign = 0;
+
+Color black, white;
+PolygonMap *maps[3];
+const char *mapPaths[3] = {"examples/building.txt", "examples/jalan.txt", "examples/pohon.txt"};
+CommandList sceneList;
+
+void drawTankScene(int arg) {
+    drawTank(makePoint(134, 155));
+}
+
+/* grey, so the black propeller and tire show on the hull */
+void drawPlaneScene(int direction) {
+    drawPlane(makePoint(130, 70), direction, setColor(128, 128, 128));
+}
+
+void drawParachuteScene(int arg) {
+    drawParachute(makePoint(135, 8));
+}
+
+/* a concave outline with a hole, both flood filled from inside */
+void drawFillScene(int arg) {
+    Point outline[6] = {{10, 10}, {190, 10}, {190, 150}, {100, 60}, {10, 150}, {10, 10}};
+    drawPolygon(6, outline, black, 1);
+    drawCircle(20, makePoint(150, 40), 2, black);
+    floodFill(20, 20, setColor(200, 30, 30), white);
+    floodFill(150, 40, setColor(30, 30, 200), white);
+}
+
+/* map number arg & 3 at scale (arg >> 2) / 4 */
+void drawMapScene(int arg) {
+    PolygonMap *map = maps[arg & 3];
+    if (map) drawPolygonMap(map, makePoint(0, 0), (arg >> 2) / 4.0, black, 1);
+}
+
+/* the same, recorded and drawn by the tile renderer */
+void drawMapSceneTiled(int arg) {
+    PolygonMap *map = maps[arg & 3];
+    if (map) recordPolygonMap(&sceneList, map, makePoint(0, 0), (arg >> 2) / 4.0, black, 1);
+    executeCommandsTiled(&sceneList);
+}
+
+/* scaled past the canvas, so every edge gets clipped */
+void drawClippedMapScene(int arg) {
+    PolygonMap *map = maps[arg];
+    if (map) drawPolygonMap(map, makePoint(-200, -150), 1.5, black, 2);
+}
+
+typedef struct {
+    const char *name;
+    const char *golden;     // image compared against, shared by equivalent scenes
+    int width, height;
+    void (*draw)(int arg);
+    int arg;
+} Scene;
+
+#define MAP_SCENES(name, index) \
+    {name "_quarter", name "_quarter", 120, 140, drawMapScene, index | 1 << 2}, \
+    {name "_half", name "_half", 240, 280, drawMapScene, index | 2 << 2}, \
+    {name "_full", name "_full", 480, 560, drawMapScene, index | 4 << 2}, \
+    {name "_full_tiled", name "_full", 480, 560, drawMapSceneTiled, index | 4 << 2}, \
+    {name "_clipped", name "_clipped", 320, 240, drawClippedMapScene, index}
+
+Scene scenes[] = {
+    {"tank", "tank", 270, 170, drawTankScene, 0},
+    {"plane_right", "plane_right", 260, 150, drawPlaneScene, 1},
+    {"plane_left", "plane_left", 260, 150, drawPlaneScene, -1},
+    {"parachute", "parachute", 224, 408, drawParachuteScene, 0},
+    {"floodFill", "floodFill", 200, 160, drawFillScene, 0},
+    MAP_SCENES("building", 0),
+    MAP_SCENES("jalan", 1),
+    MAP_SCENES("pohon", 2),
+};
+
+Surface* renderScene(const Scene *scene) {
+    Surface *s = createSurface(scene->width, scene->height);
+    if (!s) {
+        return 0;
+    }
+    setRenderTarget(s);
+    printBackground(white);
+    scene->draw(scene->arg);
+    setRenderTarget(0);
+    return s;
+}
+
+/*
+Compare one scene against its golden image. Returns 1 when it matches.
+*/
+int checkScene(const Scene *scene, Surface *actual) {
+    char path[256];
+    snprintf(path, sizeof(path), GOLDEN_DIR "/%s.ppm", scene->golden);
+    Surface *expected = readSurfacePPM(path);
+    if (!expected) {
+        printf("FAIL %s: no golden image %s (run with --update)\n", scene->name, path);
+        return 0;
+    }
+
+    Surface *diff = createSurface(expected->width, expected->height);
+    long mismatches = compareSurfaces(expected, actual, GOLDEN_TOLERANCE, diff);
+    if (mismatches == 0) {
+        printf("ok   %s\n", scene->name);
+    } else if (mismatches < 0) {
+        printf("FAIL %s: golden image is %dx%d, scene is %dx%d\n", scene->name,
+               expected->width, expected->height, actual->width, actual->height);
+    } else {
+        mkdir("build", 0755);
+        mkdir(FAILURE_DIR, 0755);
+        snprintf(path, sizeof(path), FAILURE_DIR "/%s.actual.ppm", scene->name);
+        writeSurfacePPM(actual, path);
+        snprintf(path, sizeof(path), FAILURE_DIR "/%s.diff.ppm", scene->name);
+        if (diff) writeSurfacePPM(diff, path);
+        printf("FAIL %s: %ld pixels differ, see %s\n", scene->name, mismatches, path);
+    }
+    destroySurface(diff);
+    destroySurface(expected);
+    return mismatches == 0;
+}
+
+int main(int argc, char **argv) {
+    int update = 0;
+    const char *filter = 0;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--update")) update = 1;
+        else filter = argv[i];
+    }
+
+    black = setColor(0, 0, 0);
+    white = setColor(255, 255, 255);
+    for (int i = 0; i < 3; i++) {
+        maps[i] = loadPolygonMap(mapPaths[i]);
+    }
+
+    int failed = 0, run = 0;
+    for (unsigned i = 0; i < sizeof(scenes) / sizeof(scenes[0]); i++) {
+        const Scene *scene = &scenes[i];
+        if (filter && !strstr(scene->name, filter)) continue;
+        Surface *actual = renderScene(scene);
+        if (!actual) {
+            fprintf(stderr, "Error: cannot allocate scene %s\n", scene->name);
+            return 1;
+        }
+        run++;
+        if (update) {
+            // only the scene that owns the golden image writes it
+            if (!strcmp(scene->name, scene->golden)) {
+                char path[256];
+                snprintf(path, sizeof(path), GOLDEN_DIR "/%s.ppm", scene->golden);
+                if (writeSurfacePPM(actual, path) == 0) printf("wrote %s\n", path);
+                else failed++;
+            }
+        } else {
+            failed += !checkScene(scene, actual);
+        }
+        destroySurface(actual);
+    }
+
+    printf("%d scenes, %d failed\n", run, failed);
+    for (int i = 0; i < 3; i++) {
+        freePolygonMap(maps[i]);
+    }
+    freeCommandList(&sceneList);
+    terminateTileThreads();
+    freeGameSprites();
+    return failed ? 1 : 0;
+}